@@ -1,25 +1,21 @@
 #!/bin/bash
 
-# Usage: sudo cpu.sh binary_name
+# Usage: sudo perf.sh binary [binary flags...]
+# Starts the binary under perf record with the events off; the driver turns
+# them on for its PROFILE_PHASES (the measure phase by default) through
+# --PERF_CONTROL, so the flame graph holds run-time stacks only.
 
-binary_name=$1
+binary=$1
+shift
 frequency=400
-time_duration=60
-process_id=-1
 
 flamegraph_path="./FlameGraph"
 flamegraph_remote_url="git@github.com:brendangregg/FlameGraph.git"
-is_running=0
-if [ $process_id -eq -1 ];
+
+if [ -z "$binary" ];
 then
-        process_id=`ps -aux |grep ${binary_name}  |grep -v grep |awk '{print \$2}' | head -n 1`
-        if [ -z "$process_id" ];
-        then
-                echo $binary_name "not running!"
-        else
-                is_running=1
-                echo $binary_name "process id :"$process_id
-        fi
+        echo "Usage: perf.sh binary [binary flags...]"
+        exit 1
 fi
 
 if [ ! -d $flamegraph_path ];
@@ -32,9 +28,14 @@ then
         git clone $flamegraph_remote_url
 fi
 
-if [ $is_running -eq 1 ]
-then
-        perf record -F ${frequency} -p ${process_id}  -g -- sleep ${time_duration}
-        perf script | ${flamegraph_path}/stackcollapse-perf.pl | ${flamegraph_path}/flamegraph.pl > ${binary_name}_`date +%s`.svg
-fi
+ctl_fifo=`mktemp -u /tmp/perf_ctl.XXXXXX`
+ack_fifo=`mktemp -u /tmp/perf_ack.XXXXXX`
+mkfifo $ctl_fifo $ack_fifo
+trap "rm -f $ctl_fifo $ack_fifo" EXIT
 
+name=`basename ${binary}`_`date +%s`
+perf record -F ${frequency} -g --delay=-1 \
+        --control fifo:${ctl_fifo},${ack_fifo} -o ${name}.data -- \
+        ${binary} --PERF_CONTROL=${ctl_fifo},${ack_fifo} "$@"
+perf script -i ${name}.data | ${flamegraph_path}/stackcollapse-perf.pl > ${name}.folded
+${flamegraph_path}/flamegraph.pl ${name}.folded > ${name}.svg
@@ -6,97 +6,1072 @@
 //
 
 #include <gflags/gflags.h>
+#include <algorithm>
+#include <array>
+#include <cmath>
 #include <atomic>
+#include <cstdio>
 #include <ctime>
 #include <iostream>
+#include <memory>
+#include <sstream>
 #include <thread>
+#include <vector>
+#include "tpcc/alloc_counter.h"
 #include "tpcc/config.h"
+#include "tpcc/consistency.h"
+#include "tpcc/histogram.h"
+#include "tpcc/numa.h"
+#include "tpcc/numa_kv.h"
+#include "tpcc/perf_counters.h"
+#include "tpcc/phase.h"
+#include "tpcc/results.h"
+#include "tpcc/terminal.h"
 #include "tpcc/tpcc_tables.h"
 #include "tpcc/tpcc_txn.h"
+#include "tpcc/txn_input.h"
 
 namespace TPCC {
 
-DEFINE_bool(DEBUG, true, "Set if output log message.");
-DEFINE_int32(NUM_WAREHOUSE, 2, "Set the num of warehouse.");
-DEFINE_int32(FREQUENCY_NEW_ORDER, 45, "Default percentage of new-order txn.");
-DEFINE_int32(FREQUENCY_PAYMENT, 43, "Default percentage of payment txn.");
-DEFINE_int32(FREQUENCY_ORDER_STATUS, 4,
-             "Default percentage of order-status txn.");
-DEFINE_int32(FREQUENCY_DELIVERY, 4, "Default percentage of delivery txn.");
-DEFINE_int32(FREQUENCY_STOCK_LEVEL, 4,
-             "Default percentage of stock-level txn.");
-DEFINE_string(DB_PATH, "/mnt/pmem0/tpccdb", "PATH of DB files stored");
+DEFINE_bool(REUSE_DB, false,
+            "Skip loading when DB_PATH already holds a load of the same "
+            "scale and seeds.");
+DEFINE_string(SNAPSHOT_PATH, "",
+              "Golden copy of the loaded db: restored into DB_PATH before "
+              "every run, created after loading when missing.");
+DEFINE_string(RNG, "java-lcg",
+              "Generator of the transaction inputs: java-lcg (reproducible "
+              "with older runs), xoshiro256 or wyrand.");
+DEFINE_string(INPUT_MODE, "inline",
+              "Where workers get transaction inputs: inline (drawn right "
+              "before running), queue (a producer thread per worker fills a "
+              "ring) or file (pre-generated INPUT_FILE, mapped).");
+DEFINE_string(INPUT_FILE, "",
+              "Inputs of INPUT_MODE=file, generated when missing or not "
+              "matching this run.");
+DEFINE_uint32(INPUT_QUEUE_DEPTH, 1024, "Slots of each INPUT_MODE=queue ring.");
+DEFINE_double(TARGET_TPS, 0,
+              "Open loop: transactions per second offered over all workers, "
+              "latency counted from the scheduled start. 0 is the closed "
+              "loop, every worker starts when its previous txn ended.");
+DEFINE_string(ARRIVAL, "poisson",
+              "Open loop schedule of each worker: poisson or fixed.");
+DEFINE_string(TPS_SWEEP, "",
+              "Comma separated TARGET_TPS values, TXN_COUNT transactions "
+              "run at each of them in turn (throughput-latency curve).");
+DEFINE_int32(TERMINALS_PER_WAREHOUSE, 0,
+             "Terminal emulation: terminals bound to every warehouse (the "
+             "spec has 10), each one keying, running and thinking in turn, "
+             "multiplexed over NUM_THREADS threads. 0 runs without "
+             "terminals.");
+DEFINE_double(THINK_TIME_SCALE, 1,
+              "Factor on the spec keying and think times of the terminals, "
+              "0 runs them back to back.");
+DEFINE_uint32(INFLIGHT_TXNS, 1,
+              "Transactions every worker keeps in flight as coroutines, the "
+              "reads they wait on go to the kv as one batch (MultiGet). 1 "
+              "runs them one after the other. Closed loop only.");
+DEFINE_string(PIN_THREADS, "none",
+              "Pin the workers to CPUs: none, compact (fill node 0 first), "
+              "scatter (nodes in turn) or a CPU list such as 0-7,16-23.");
+DEFINE_bool(WAREHOUSE_AFFINITY, false,
+            "Every pinned worker only runs transactions homed at the "
+            "warehouses of its node (see NUMA_DB_PATHS).");
+DEFINE_bool(PERF_COUNTERS, false,
+            "Count cycles, instructions, LLC, dTLB and branch misses of the "
+            "workers while they run transactions (perf_event_open).");
+DEFINE_uint32(PERF_TXN_SAMPLE, 0,
+              "With PERF_COUNTERS, also count every N-th transaction on its "
+              "own to break the counts down by type; 0 turns it off.");
+DEFINE_uint64(WARMUP_TXN_COUNT, 0,
+              "Transactions run before the measured ones, not reported.");
+DEFINE_string(PHASE_FIFO, "",
+              "Write \"<phase> begin|end <ns>\" lines for the load, warmup, "
+              "measure and verify phases to this fifo (created when "
+              "missing) while somebody reads it.");
+DEFINE_string(PERF_CONTROL, "",
+              "ctl[,ack] fifos of perf record --control fifo:ctl,ack "
+              "--delay=-1; perf is enabled during PROFILE_PHASES only.");
+DEFINE_string(SAMPLE_PROFILE, "",
+              "Sample the stacks in process during PROFILE_PHASES and write "
+              "<prefix>.<phase>.folded per phase.");
+DEFINE_uint32(SAMPLE_HZ, 99, "Samples per cpu second of SAMPLE_PROFILE.");
+DEFINE_string(PROFILE_PHASES, "measure",
+              "Comma separated phases profiled by PERF_CONTROL and "
+              "SAMPLE_PROFILE, or all.");
+DEFINE_bool(VERIFY, false,
+            "Check the TPC-C consistency conditions 1-7 after the run, one "
+            "thread per NUM_THREADS over the warehouses.");
+DEFINE_int32(NUM_THREADS, 1, "Number of worker threads running transactions.");
+DEFINE_uint64(TXN_COUNT, 100000, "Total number of transactions to run.");
 
 }  // namespace TPCC
 
-double RunTPCC(uint32_t txn_count,
-               std::vector<TPCC::TPCCTxType>& tpcc_workgen_arr,
-               TPCC::TPCCTable& tpcc_client) {
-  // Guarantee that each coroutine has a different seed
-  thread_local uint64_t seed =
-      0xdeadbeef + std::hash<std::thread::id>()(std::this_thread::get_id());
-  thread_local FastRandom random_generator(seed);
+// seed of the input stream of worker 0, worker t uses kBaseSeed + t
+static const uint64_t kBaseSeed = 0xdeadbeef;
+// the warmup draws from streams of its own, kBaseSeed ^ kWarmupSalt + t
+static const uint64_t kWarmupSalt = 0x5741524d55500000;  // "WARMUP"
+// the arrival gaps of a worker are not drawn from its input stream
+static const uint64_t kPacerSalt = 0x5041434552000000;  // "PACER"
+// nor the keying and think times of its terminals
+static const uint64_t kThinkTimeSalt = 0x5448494e4b000000;  // "THINK"
 
+struct RunStats {
+  double sec = 0;
+  uint64_t committed = 0;
+  uint64_t aborted = 0;
+  TPCC::LatencyHistogram latency;  // from the scheduled start
+  TPCC::LatencyHistogram service;  // from the actual start
+  TPCC::PerfCounts perf;           // PERF_COUNTERS, the whole phase
+  // PERF_TXN_SAMPLE: the sampled transactions by type
+  std::array<TPCC::PerfCounts, TPCC_TX_TYPES> perf_by_type;
+  std::array<uint64_t, TPCC_TX_TYPES> perf_samples{};
+};
+
+// Start times of one worker. With rate (txn/s) 0 the loop is closed and a
+// transaction is due as soon as the previous one ended; otherwise the starts
+// are spaced evenly or by exponential gaps (Poisson arrivals), independent of
+// how long the transactions take.
+class Pacer {
+ public:
+  Pacer(double rate, bool poisson, uint64_t seed)
+      : interval_ns_(rate > 0 ? 1e9 / rate : 0),
+        poisson_(poisson),
+        random_generator_(seed, Utils::RandomKind::kWyrand) {}
+
+  // Whether WaitNext() may wait, false in a closed loop
+  bool Paced() const { return interval_ns_ != 0; }
+
+  // Wait for the next scheduled start and return it. A worker running late
+  // starts at once, the lateness is part of the latency.
+  uint64_t WaitNext() {
+    uint64_t now_ns = Utils::NowNanos();
+    if (interval_ns_ == 0) {
+      return now_ns;
+    }
+    if (next_ns_ == 0) {
+      next_ns_ = now_ns;
+    } else if (poisson_) {
+      next_ns_ += uint64_t(-std::log(1 - random_generator_.NextUniform()) *
+                           interval_ns_);
+    } else {
+      next_ns_ += uint64_t(interval_ns_);
+    }
+    while (now_ns < next_ns_) {
+      if (next_ns_ - now_ns > 100000) {
+        std::this_thread::sleep_for(
+            std::chrono::nanoseconds(next_ns_ - now_ns - 50000));
+      } else {
+        std::this_thread::yield();
+      }
+      now_ns = Utils::NowNanos();
+    }
+    return next_ns_;
+  }
+
+ private:
+  double interval_ns_;
+  bool poisson_;
+  FastRandom random_generator_;
+  uint64_t next_ns_ = 0;
+};
+
+// PERF_COUNTERS of one worker, opened by the worker thread itself. Counts
+// from Start() to Stop() except between Pause() and Resume(), and every
+// sample_every-th transaction between Begin() and End() on its own (a read
+// of the group costs a syscall, so not every one).
+class WorkerPerf {
+ public:
+  WorkerPerf(bool enabled, uint32_t sample_every)
+      : sample_every_(sample_every), countdown_(sample_every) {
+    std::string error;
+    if (enabled && !counters_.Open(&error)) {
+      static std::atomic<bool> reported(false);
+      if (!reported.exchange(true)) {
+        printf("perf counters unavailable, %s\n", error.c_str());
+      }
+    }
+  }
+
+  void Start() { counters_.Enable(); }
+  // not counting while the worker waits: for its start time, its inputs or
+  // its terminals
+  void Pause() { counters_.Disable(); }
+  void Resume() { counters_.Enable(); }
+  void Stop(RunStats& stats) {
+    counters_.Disable();
+    stats.perf = counters_.Read();
+  }
+
+  void Begin() {
+    sampling_ = counters_.Opened() && sample_every_ > 0 && --countdown_ == 0;
+    if (sampling_) {
+      countdown_ = sample_every_;
+      before_ = counters_.Read();
+    }
+  }
+  void End(TPCC::TPCCTxType type, RunStats& stats) {
+    if (sampling_) {
+      size_t i = static_cast<size_t>(type);
+      stats.perf_by_type[i] += counters_.Read() - before_;
+      stats.perf_samples[i]++;
+    }
+  }
+
+ private:
+  TPCC::PerfCounters counters_;
+  uint32_t sample_every_;
+  uint32_t countdown_;
+  bool sampling_ = false;
+  TPCC::PerfCounts before_;
+};
+
+// Input sources of RunTPCC: Next() returns the input to run, pausing perf
+// while it waits for one, Done() releases it once executed.
+struct InlineInputs {
+  TPCC::TxnInputGenerator generator;
+  TPCC::TxnInput input;
+  const TPCC::TxnInput* Next(WorkerPerf& perf) {
+    generator.Next(&input);
+    return &input;
+  }
+  void Done() {}
+};
+
+struct QueueInputs {
+  TPCC::TxnInputQueue* queue;
+  const TPCC::TxnInput* Next(WorkerPerf& perf) {
+    const TPCC::TxnInput* input = queue->Front();
+    if (input == nullptr) {
+      perf.Pause();
+      while ((input = queue->Front()) == nullptr) {
+        std::this_thread::yield();
+      }
+      perf.Resume();
+    }
+    return input;
+  }
+  void Done() { queue->Pop(); }
+};
+
+struct FileInputs {
+  const TPCC::TxnInput* next;
+  const TPCC::TxnInput* Next(WorkerPerf& perf) { return next++; }
+  void Done() {}
+};
+
+template <typename Inputs>
+RunStats RunTPCC(uint64_t txn_count, Inputs& inputs,
+                 TPCC::TPCCTable& tpcc_client, Pacer& pacer,
+                 WorkerPerf& perf) {
   struct timespec bench_start_time, bench_end_time;
   TPCC::TPCCTxn txn;
+  RunStats stats;
 
   clock_gettime(CLOCK_REALTIME, &bench_start_time);
+  perf.Start();
 
-  bool tx_committed = false;
   // Running transactions
-  for (auto i = 0; i < txn_count; i++) {
-    TPCC::TPCCTxType tx_type = tpcc_workgen_arr[Utils::FastRand(&seed) % 100];
+  for (uint64_t i = 0; i < txn_count; i++) {
+    if (pacer.Paced()) {
+      perf.Pause();
+    }
+    uint64_t scheduled_ns = pacer.WaitNext();
+    if (pacer.Paced()) {
+      perf.Resume();
+    }
+    uint64_t start_ns = Utils::NowNanos();
+    const TPCC::TxnInput* input = inputs.Next(perf);
+    perf.Begin();
+    bool tx_committed = txn.Execute(&tpcc_client, *input);
+    perf.End(input->type, stats);
+    inputs.Done();
+    uint64_t end_ns = Utils::NowNanos();
+    stats.latency.Add(end_ns - scheduled_ns);
+    stats.service.Add(end_ns - start_ns);
+    if (tx_committed) {
+      stats.committed++;
+    } else {
+      stats.aborted++;
+    }
+  }
+  perf.Stop(stats);
+  clock_gettime(CLOCK_REALTIME, &bench_end_time);
+  stats.sec =
+      (bench_end_time.tv_sec - bench_start_time.tv_sec) +
+      (double)(bench_end_time.tv_nsec - bench_start_time.tv_nsec) / 1000000000;
+  return stats;
+}
 
-    switch (tx_type) {
-      case TPCC::TPCCTxType::kDelivery: {
-        // printf("type: delivery   ");
-        tx_committed = txn.Delivery(&tpcc_client, random_generator);
-        break;
+// RunTPCC with up to depth transactions in flight: each one runs until it
+// reads, then the reads of all of them are served in one batch and the
+// readers go on. A slot starts its next transaction as soon as the previous
+// one ended. Transactions overlap, perf counts only the whole run.
+template <typename Inputs>
+RunStats RunTPCCInterleaved(uint64_t txn_count, Inputs& inputs,
+                            TPCC::TPCCTable& tpcc_client, uint32_t depth,
+                            WorkerPerf& perf) {
+  // the task refers to the input, so it is copied into the slot
+  struct Slot {
+    TPCC::TxnInput input;
+    TPCC::TxnTask task;
+    void* txn_context = nullptr;
+    uint64_t start_ns = 0;
+  };
+  struct timespec bench_start_time, bench_end_time;
+  TPCC::TPCCTxn txn;
+  RunStats stats;
+  KVInterface* kv = tpcc_client.GetKV();
+  TPCC::TxnScheduler scheduler(kv);
+  std::vector<Slot> slots(depth);
+  for (Slot& slot : slots) {
+    slot.txn_context = kv->NewTxnContext();
+  }
+
+  clock_gettime(CLOCK_REALTIME, &bench_start_time);
+  perf.Start();
+
+  uint64_t started = 0, finished = 0;
+  while (finished < txn_count) {
+    for (Slot& slot : slots) {
+      if (slot.task.Valid() && slot.task.Done()) {
+        uint64_t end_ns = Utils::NowNanos();
+        stats.latency.Add(end_ns - slot.start_ns);
+        stats.service.Add(end_ns - slot.start_ns);
+        if (slot.task.Committed()) {
+          stats.committed++;
+        } else {
+          stats.aborted++;
+        }
+        slot.task = TPCC::TxnTask();
+        finished++;
       }
-      case TPCC::TPCCTxType::kNewOrder: {
-        // printf("type: new order   ");
-        tx_committed = txn.NewOrder(&tpcc_client, random_generator);
-        break;
+      if (!slot.task.Valid() && started < txn_count) {
+        slot.start_ns = Utils::NowNanos();
+        slot.input = *inputs.Next(perf);
+        inputs.Done();
+        slot.task = txn.Start(&tpcc_client, slot.input);
+        started++;
+        scheduler.Start(slot.task, slot.txn_context);
       }
-      case TPCC::TPCCTxType::kOrderStatus: {
-        // printf("type: order status   ");
-        tx_committed = txn.OrderStatus(&tpcc_client, random_generator);
-        break;
+    }
+    if (scheduler.Pending() > 0) {
+      scheduler.Flush();
+    }
+  }
+  perf.Stop(stats);
+  clock_gettime(CLOCK_REALTIME, &bench_end_time);
+  stats.sec =
+      (bench_end_time.tv_sec - bench_start_time.tv_sec) +
+      (double)(bench_end_time.tv_nsec - bench_start_time.tv_nsec) / 1000000000;
+  for (Slot& slot : slots) {
+    kv->DeleteTxnContext(slot.txn_context);
+  }
+  return stats;
+}
+
+// Map INPUT_FILE, writing it first when it is missing or can not serve this
+// run: a slice per worker, each holding what the worker would draw inline.
+bool OpenInputFile(TPCC::TxnInputFile& input_file, TPCC::TPCCTable* tpcc_client,
+                   const std::vector<TPCC::TPCCTxType>& tpcc_workgen_arr,
+                   uint64_t txn_count, uint32_t num_threads, uint64_t seed,
+                   Utils::RandomKind rng) {
+  const std::string& path = TPCC::FLAGS_INPUT_FILE;
+  if (input_file.Open(path)) {
+    const TPCC::TxnInputFileHeader& header = input_file.header();
+    if (header.num_warehouse == TPCC::FLAGS_NUM_WAREHOUSE &&
+        header.rng == static_cast<uint32_t>(rng) && header.seed == seed &&
+        header.mix_hash == TPCC::TxnMixHash(tpcc_workgen_arr) &&
+        header.num_streams == num_threads && header.count == txn_count) {
+      return true;
+    }
+    printf("input file %s does not match this run, regenerate it\n",
+           path.c_str());
+  }
+  if (!TPCC::WriteTxnInputFile(path, tpcc_client, tpcc_workgen_arr, txn_count,
+                               num_threads, seed, rng)) {
+    printf("write input file %s failed\n", path.c_str());
+    return false;
+  }
+  return input_file.Open(path);
+}
+
+// What the workers of every phase share
+struct Workload {
+  TPCC::TPCCTable* tpcc_client;
+  const std::vector<TPCC::TPCCTxType>* workgen_arr;
+  Utils::RandomKind rng;
+  uint64_t base_seed;  // worker t draws from base_seed + t
+  std::string input_mode;
+  const TPCC::TxnInputFile* input_file;
+  uint64_t txn_count;
+  uint32_t num_threads;
+  uint32_t terminals_per_warehouse;
+  double think_time_scale;
+  uint32_t inflight_txns;
+  const TPCC::ThreadPlacement* placement;
+  bool warehouse_affinity;
+  bool perf_counters;
+  uint32_t perf_txn_sample;
+};
+
+// Warehouses homed on node: the ones of the shards placed there, or of the
+// node's share of the warehouses without NUMA_DB_PATHS.
+std::vector<uint32_t> WarehousesOfNode(uint32_t node) {
+  uint32_t num_nodes = TPCC::NumaTopology::Get().NumNodes();
+  uint32_t num_shards = num_nodes;
+  if (!TPCC::FLAGS_NUMA_DB_PATHS.empty()) {
+    num_shards = std::count(TPCC::FLAGS_NUMA_DB_PATHS.begin(),
+                            TPCC::FLAGS_NUMA_DB_PATHS.end(), ',') + 1;
+  }
+  std::vector<uint32_t> warehouses;
+  for (uint32_t w = 1; w <= uint32_t(TPCC::FLAGS_NUM_WAREHOUSE); w++) {
+    if (TPCC::NumaKV::ShardOfWarehouse(w, TPCC::FLAGS_NUM_WAREHOUSE,
+                                       num_shards) % num_nodes == node) {
+      warehouses.push_back(w);
+    }
+  }
+  return warehouses;
+}
+
+template <typename Inputs>
+RunStats RunWorker(const Workload& workload, uint64_t txn_count,
+                   Inputs& inputs, Pacer& pacer) {
+  WorkerPerf perf(workload.perf_counters, workload.perf_txn_sample);
+  if (workload.inflight_txns > 1) {
+    return RunTPCCInterleaved(txn_count, inputs, *workload.tpcc_client,
+                              workload.inflight_txns, perf);
+  }
+  return RunTPCC(txn_count, inputs, *workload.tpcc_client, pacer, perf);
+}
+
+// Emulate the terminals of one thread: terminal i belongs to thread
+// i % num_threads, is bound to warehouse i / terminals_per_warehouse + 1 and
+// reports stock levels of one district. Wakeups come from a timer wheel;
+// the workers stop once issued reached txn_count. The latency counts from
+// the end of the keying time, so a terminal served late is accounted for.
+RunStats RunTerminals(const Workload& workload, uint32_t thread,
+                      std::atomic<uint64_t>& issued) {
+  // a terminal between two wakeups
+  struct Terminal {
+    TPCC::TxnHome home;
+    bool keyed = false;  // inputs keyed in, the transaction runs next
+    uint64_t due_ns = 0;
+    TPCC::TxnInput input;
+  };
+  static const uint64_t kTickNs = 100000;
+  static const uint32_t kWheelSlots = 16384;
+
+  const uint32_t per_warehouse = workload.terminals_per_warehouse;
+  const uint32_t total = per_warehouse * TPCC::FLAGS_NUM_WAREHOUSE;
+  const double scale_ns = workload.think_time_scale * 1e9;
+  RunStats stats;
+  std::vector<Terminal> terminals;
+  for (uint32_t i = thread; i < total; i += workload.num_threads) {
+    terminals.emplace_back();
+    terminals.back().home.warehouse_id = i / per_warehouse + 1;
+    terminals.back().home.district_id =
+        i % per_warehouse % NUM_DISTRICT_PER_WAREHOUSE + 1;
+  }
+  if (terminals.empty()) {
+    return stats;
+  }
+
+  TPCC::TPCCTxn txn;
+  TPCC::TxnInputGenerator generator(workload.tpcc_client,
+                                    *workload.workgen_arr,
+                                    workload.base_seed + thread,
+                                    workload.rng);
+  FastRandom random_generator((workload.base_seed + thread) ^ kThinkTimeSalt,
+                              Utils::RandomKind::kWyrand);
+  uint64_t now_ns = Utils::NowNanos();
+  TPCC::TimerWheel wheel(kTickNs, kWheelSlots, now_ns);
+  for (uint32_t id = 0; id < terminals.size(); id++) {
+    // spread the first transactions over a (scaled) second
+    terminals[id].due_ns = now_ns + uint64_t(random_generator.NextUniform() *
+                                             scale_ns);
+    wheel.Schedule(terminals[id].due_ns, id);
+  }
+
+  WorkerPerf perf(workload.perf_counters, workload.perf_txn_sample);
+  perf.Start();
+  std::vector<uint32_t> expired;
+  while (true) {
+    expired.clear();
+    wheel.Advance(now_ns, &expired);
+    for (uint32_t id : expired) {
+      Terminal& terminal = terminals[id];
+      if (!terminal.keyed) {
+        // think time over, key in the next transaction
+        generator.Next(&terminal.input, terminal.home);
+        terminal.keyed = true;
+        terminal.due_ns =
+            now_ns + uint64_t(TPCC::SpecTerminalTimes(terminal.input.type)
+                                  .keying_sec *
+                              scale_ns);
+        wheel.Schedule(terminal.due_ns, id);
+        continue;
       }
-      case TPCC::TPCCTxType::kPayment: {
-        // printf("type: payment   ");
-        tx_committed = txn.Payment(&tpcc_client, random_generator);
-        break;
+      if (issued.fetch_add(1) >= workload.txn_count) {
+        perf.Stop(stats);
+        return stats;
       }
-      case TPCC::TPCCTxType::kStockLevel: {
-        // printf("type: stock level   ");
-        tx_committed = txn.StockLevel(&tpcc_client, random_generator);
-        break;
+      uint64_t start_ns = Utils::NowNanos();
+      perf.Begin();
+      bool tx_committed = txn.Execute(workload.tpcc_client, terminal.input);
+      perf.End(terminal.input.type, stats);
+      uint64_t end_ns = Utils::NowNanos();
+      stats.latency.Add(end_ns - terminal.due_ns);
+      stats.service.Add(end_ns - start_ns);
+      if (tx_committed) {
+        stats.committed++;
+      } else {
+        stats.aborted++;
       }
-      default:
-        printf("Unexpected transaction type %d\n", static_cast<int>(tx_type));
+      double think_sec = TPCC::ThinkTimeSec(
+          TPCC::SpecTerminalTimes(terminal.input.type).think_mean_sec,
+          random_generator);
+      terminal.keyed = false;
+      terminal.due_ns = end_ns + uint64_t(think_sec * scale_ns);
+      wheel.Schedule(terminal.due_ns, id);
+      now_ns = end_ns;
+    }
+    if (issued.load() >= workload.txn_count) {
+      // the other threads issued the rest while this one was idle
+      perf.Stop(stats);
+      return stats;
+    }
+    now_ns = Utils::NowNanos();
+    uint64_t next_ns = wheel.NextTickNs();
+    if (expired.empty() && next_ns > now_ns) {
+      perf.Pause();
+      std::this_thread::sleep_for(std::chrono::nanoseconds(next_ns - now_ns));
+      perf.Resume();
+      now_ns = Utils::NowNanos();
+    }
+  }
+}
+
+// Run txn_count transactions on num_threads workers offering target_tps in
+// total (0: closed loop). Returns the merged stats and the wall time.
+RunStats RunPhase(const Workload& workload, double target_tps, bool poisson) {
+  const uint32_t num_threads = workload.num_threads;
+  const uint64_t txn_count = workload.txn_count;
+  const std::string& input_mode = workload.input_mode;
+  TPCC::TPCCTable* tpcc_client = workload.tpcc_client;
+  const std::vector<TPCC::TPCCTxType>& tpcc_workgen_arr =
+      *workload.workgen_arr;
+  const Utils::RandomKind rng = workload.rng;
+  const double thread_tps = target_tps / num_threads;
+
+  std::vector<RunStats> thread_stats(num_threads);
+  std::vector<std::unique_ptr<TPCC::TxnInputQueue>> queues(num_threads);
+  std::vector<std::thread> workers;
+  std::vector<std::thread> producers;
+  struct timespec start_time, end_time;
+  clock_gettime(CLOCK_REALTIME, &start_time);
+  uint64_t file_offset = 0;
+  std::atomic<uint64_t> issued(0);
+  for (uint32_t t = 0; t < num_threads; t++) {
+    const int cpu = workload.placement->CpuOf(t);
+    const uint32_t node = TPCC::NumaTopology::Get().NodeOfCpu(cpu);
+    std::vector<uint32_t> warehouses;
+    if (workload.warehouse_affinity) {
+      warehouses = WarehousesOfNode(node);
+    }
+    if (workload.terminals_per_warehouse > 0) {
+      workers.emplace_back([&, t, cpu]() {
+        if (cpu >= 0) {
+          TPCC::PinThread(cpu);
+        }
+        thread_stats[t] = RunTerminals(workload, t, issued);
+      });
+      continue;
+    }
+    uint64_t thread_txn_count =
+        TPCC::StreamInputCount(txn_count, num_threads, t);
+    // every worker has its own stream, the same from run to run
+    uint64_t seed = workload.base_seed + t;
+    if (input_mode == "inline") {
+      workers.emplace_back([&, t, cpu, warehouses, thread_txn_count, seed]() {
+        if (cpu >= 0) {
+          TPCC::PinThread(cpu);
+        }
+        InlineInputs inputs{TPCC::TxnInputGenerator(
+            tpcc_client, tpcc_workgen_arr, seed, rng)};
+        inputs.generator.RestrictWarehouses(warehouses);
+        Pacer pacer(thread_tps, poisson, seed ^ kPacerSalt);
+        thread_stats[t] = RunWorker(workload, thread_txn_count, inputs, pacer);
+      });
+    } else if (input_mode == "queue") {
+      queues[t].reset(new TPCC::TxnInputQueue(TPCC::FLAGS_INPUT_QUEUE_DEPTH));
+      TPCC::TxnInputQueue* queue = queues[t].get();
+      producers.emplace_back(
+          [&, queue, cpu, node, warehouses, thread_txn_count, seed]() {
+        // next to its worker, the ring stays in the node's caches
+        if (cpu >= 0) {
+          TPCC::PinThreadToNode(node);
+        }
+        TPCC::TxnInputGenerator generator(tpcc_client, tpcc_workgen_arr,
+                                          seed, rng);
+        generator.RestrictWarehouses(warehouses);
+        for (uint64_t i = 0; i < thread_txn_count; i++) {
+          TPCC::TxnInput* slot;
+          while ((slot = queue->Back()) == nullptr) {
+            std::this_thread::yield();
+          }
+          generator.Next(slot);
+          queue->Push();
+        }
+      });
+      workers.emplace_back([&, t, cpu, queue, thread_txn_count, seed]() {
+        if (cpu >= 0) {
+          TPCC::PinThread(cpu);
+        }
+        QueueInputs inputs{queue};
+        Pacer pacer(thread_tps, poisson, seed ^ kPacerSalt);
+        thread_stats[t] = RunWorker(workload, thread_txn_count, inputs, pacer);
+      });
+    } else {
+      // a contiguous slice of the file per worker
+      const TPCC::TxnInput* first =
+          workload.input_file->records() + file_offset;
+      file_offset += thread_txn_count;
+      workers.emplace_back([&, t, cpu, first, thread_txn_count, seed]() {
+        if (cpu >= 0) {
+          TPCC::PinThread(cpu);
+        }
+        FileInputs inputs{first};
+        Pacer pacer(thread_tps, poisson, seed ^ kPacerSalt);
+        thread_stats[t] = RunWorker(workload, thread_txn_count, inputs, pacer);
+      });
+    }
+  }
+  for (auto& producer : producers) {
+    producer.join();
+  }
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  clock_gettime(CLOCK_REALTIME, &end_time);
+
+  RunStats total;
+  total.sec = (end_time.tv_sec - start_time.tv_sec) +
+              (double)(end_time.tv_nsec - start_time.tv_nsec) / 1000000000;
+  for (auto& stats : thread_stats) {
+    total.committed += stats.committed;
+    total.aborted += stats.aborted;
+    total.latency.Merge(stats.latency);
+    total.service.Merge(stats.service);
+    total.perf += stats.perf;
+    for (size_t i = 0; i < TPCC_TX_TYPES; i++) {
+      total.perf_by_type[i] += stats.perf_by_type[i];
+      total.perf_samples[i] += stats.perf_samples[i];
+    }
+  }
+  return total;
+}
+
+// Directories holding the store: the shards of NUMA_DB_PATHS or DB_PATH.
+// Each one gets a load manifest of its own.
+std::vector<std::string> StorePaths() {
+  if (TPCC::FLAGS_NUMA_DB_PATHS.empty()) {
+    return {TPCC::FLAGS_DB_PATH};
+  }
+  std::vector<std::string> store_paths;
+  std::stringstream paths(TPCC::FLAGS_NUMA_DB_PATHS);
+  std::string path;
+  while (std::getline(paths, path, ',')) {
+    store_paths.push_back(path);
+  }
+  return store_paths;
+}
+
+// Bring DB_PATH to the freshly loaded state: restore the golden snapshot,
+// reuse the store already there, or load it (and save the snapshot).
+// Returns how the data was obtained.
+std::string PrepareDB(TPCC::DBType db_type,
+                      std::unique_ptr<TPCC::TPCCTable>& tpcc_client) {
+  const std::string& db_path = TPCC::FLAGS_DB_PATH;
+  const std::vector<std::string> store_paths = StorePaths();
+  const std::string& snapshot_path = TPCC::FLAGS_SNAPSHOT_PATH;
+  TPCC::LoadManifest expected = TPCC::TPCCTable::ExpectedLoad();
+  TPCC::LoadManifest found;
+  std::string reason;
+
+  if (!snapshot_path.empty()) {
+    if (found.Read(TPCC::LoadManifest::PathOf(snapshot_path)) &&
+        expected.SameLoad(found, &reason)) {
+      if (!TPCC::CloneDirectory(snapshot_path, db_path)) {
+        printf("restore snapshot %s failed\n", snapshot_path.c_str());
         abort();
+      }
+      tpcc_client.reset(new TPCC::TPCCTable(db_type));
+      return "restored";
     }
-    // printf("\t transaction count: %d", i);
-    // printf(", tpcc get record count: %lu, put record count: %lu \n", tpcc_client.GetReadRecordCount(), tpcc_client.GetLoadRecordCount());
+    if (!reason.empty()) {
+      printf("snapshot %s not usable: %s\n", snapshot_path.c_str(),
+             reason.c_str());
+    }
+  }
 
+  tpcc_client.reset(new TPCC::TPCCTable(db_type));
+  if (!tpcc_client->PersistentKV()) {
+    tpcc_client->LoadTables();
+    return "loaded";
   }
-  clock_gettime(CLOCK_REALTIME, &bench_end_time);
-  double bench_sec =
-      (bench_end_time.tv_sec - bench_start_time.tv_sec) +
-      (double)(bench_end_time.tv_nsec - bench_start_time.tv_nsec) / 1000000000;
-  return bench_sec;
+  if (TPCC::FLAGS_REUSE_DB) {
+    // every shard must hold the same load
+    bool reusable = true;
+    for (const std::string& path : store_paths) {
+      if (!found.Read(TPCC::LoadManifest::PathOf(path)) ||
+          !expected.SameLoad(found, &reason)) {
+        printf("can not reuse %s: %s\n", path.c_str(),
+               reason.empty() ? "no load manifest" : reason.c_str());
+        reusable = false;
+        break;
+      }
+    }
+    if (reusable) {
+      return "reused";
+    }
+  }
+
+  // a load interrupted halfway must not look reusable
+  for (const std::string& path : store_paths) {
+    std::remove(TPCC::LoadManifest::PathOf(path).c_str());
+  }
+  tpcc_client->LoadTables();
+  if (tpcc_client->FlushKV() != 1) {
+    printf("flush %s failed\n", db_path.c_str());
+    return "loaded";
+  }
+  TPCC::LoadManifest manifest = tpcc_client->GetLoadManifest();
+  for (const std::string& path : store_paths) {
+    if (!manifest.Write(TPCC::LoadManifest::PathOf(path))) {
+      printf("write load manifest to %s failed\n", path.c_str());
+      return "loaded";
+    }
+  }
+  if (!snapshot_path.empty()) {
+    // the store must be closed to copy a consistent image
+    tpcc_client.reset();
+    if (!TPCC::CloneDirectory(db_path, snapshot_path)) {
+      printf("save snapshot %s failed\n", snapshot_path.c_str());
+    }
+    tpcc_client.reset(new TPCC::TPCCTable(db_type));
+  }
+  return "loaded";
 }
+
 int main(int argc, char** argv) {
   google::SetUsageMessage("Usage message of pmem operation test:");
   google::ParseCommandLineFlags(&argc, &argv, true);
   TPCC::TestConfig();
 
-  TPCC::TPCCTable tpcc_client(TPCC::DBType::rocksdb);
+  Utils::RandomKind rng;
+  if (!Utils::ParseRandomKind(TPCC::FLAGS_RNG, &rng)) {
+    printf("unknown RNG: %s\n", TPCC::FLAGS_RNG.c_str());
+    return 1;
+  }
+
+  TPCC::DBType db_type;
+  if (!TPCC::ParseDBType(TPCC::FLAGS_DB_TYPE, &db_type)) {
+    printf("unknown DB_TYPE: %s\n", TPCC::FLAGS_DB_TYPE.c_str());
+    return 1;
+  }
+
+  if (!TPCC::FLAGS_NUMA_DB_PATHS.empty() &&
+      !TPCC::FLAGS_SNAPSHOT_PATH.empty()) {
+    // a snapshot is a copy of DB_PATH alone; REUSE_DB works, every shard
+    // has its load manifest
+    printf("SNAPSHOT_PATH does not support NUMA_DB_PATHS\n");
+    return 1;
+  }
+
+  if (!TPCC::FLAGS_NUMA_DB_PATHS.empty() && db_type == TPCC::DBType::rocksdb &&
+      TPCC::FLAGS_ROCKSDB_TXN_MODE != "none") {
+    // the shards commit one by one: a transaction failing on one shard
+    // after committing on another would stay half applied
+    printf("ROCKSDB_TXN_MODE=%s does not support NUMA_DB_PATHS\n",
+           TPCC::FLAGS_ROCKSDB_TXN_MODE.c_str());
+    return 1;
+  }
+
+  if (TPCC::FLAGS_WARMUP_TXN_COUNT > 0 && TPCC::FLAGS_INPUT_MODE == "file") {
+    // the file holds the inputs of one pass over fresh tables
+    printf("WARMUP_TXN_COUNT does not support INPUT_MODE=file\n");
+    return 1;
+  }
+
+  TPCC::PhaseControl phase_control;
+  std::string phase_error;
+  if (!phase_control.Init(TPCC::FLAGS_PHASE_FIFO, TPCC::FLAGS_PERF_CONTROL,
+                          TPCC::FLAGS_SAMPLE_PROFILE, TPCC::FLAGS_SAMPLE_HZ,
+                          TPCC::FLAGS_PROFILE_PHASES, &phase_error)) {
+    printf("phase control: %s\n", phase_error.c_str());
+    return 1;
+  }
+
+  std::unique_ptr<TPCC::TPCCTable> tpcc_client;
+  phase_control.Enter(TPCC::BenchPhase::kLoad);
+  std::string load_mode = PrepareDB(db_type, tpcc_client);
+  tpcc_client->FillStockQuantityColumn();
+  tpcc_client->FindNextDeliveries();
   std::vector<TPCC::TPCCTxType> tpcc_workgen_arr =
-      tpcc_client.CreateWorkgenArray();
-  tpcc_client.LoadTables();
-  uint64_t txn_count = 100000;
-  double benchsec = RunTPCC(100000, tpcc_workgen_arr, tpcc_client);
-  printf("transaction count = %ld, sec = %.2lf, tmpC = %.2lf\n", txn_count, benchsec, txn_count*60/benchsec);
+      tpcc_client->CreateWorkgenArray();
+  uint64_t txn_count = TPCC::FLAGS_TXN_COUNT;
+  uint32_t num_threads = std::max(TPCC::FLAGS_NUM_THREADS, 1);
+
+  const std::string& input_mode = TPCC::FLAGS_INPUT_MODE;
+  TPCC::TxnInputFile input_file;
+  if (input_mode == "file") {
+    if (TPCC::FLAGS_INPUT_FILE.empty()) {
+      printf("INPUT_MODE=file needs INPUT_FILE\n");
+      return 1;
+    }
+    if (!OpenInputFile(input_file, tpcc_client.get(), tpcc_workgen_arr,
+                       txn_count, num_threads, kBaseSeed, rng)) {
+      return 1;
+    }
+  } else if (input_mode != "inline" && input_mode != "queue") {
+    printf("unknown INPUT_MODE: %s\n", input_mode.c_str());
+    return 1;
+  }
+
+  if (TPCC::FLAGS_ARRIVAL != "poisson" && TPCC::FLAGS_ARRIVAL != "fixed") {
+    printf("unknown ARRIVAL: %s\n", TPCC::FLAGS_ARRIVAL.c_str());
+    return 1;
+  }
+  bool poisson = TPCC::FLAGS_ARRIVAL == "poisson";
+  std::vector<double> target_tps_list;
+  if (TPCC::FLAGS_TPS_SWEEP.empty()) {
+    target_tps_list.push_back(TPCC::FLAGS_TARGET_TPS);
+  } else {
+    std::stringstream sweep(TPCC::FLAGS_TPS_SWEEP);
+    std::string rate;
+    while (std::getline(sweep, rate, ',')) {
+      target_tps_list.push_back(std::stod(rate));
+    }
+  }
+
+  uint32_t terminals_per_warehouse =
+      std::max(TPCC::FLAGS_TERMINALS_PER_WAREHOUSE, 0);
+  if (terminals_per_warehouse > 0 &&
+      (input_mode != "inline" || TPCC::FLAGS_TARGET_TPS > 0 ||
+       !TPCC::FLAGS_TPS_SWEEP.empty())) {
+    // the terminals generate their own inputs at their own pace
+    printf("TERMINALS_PER_WAREHOUSE needs INPUT_MODE=inline and no "
+           "TARGET_TPS or TPS_SWEEP\n");
+    return 1;
+  }
+
+  uint32_t inflight_txns = std::max(TPCC::FLAGS_INFLIGHT_TXNS, 1u);
+  if (inflight_txns > 1 &&
+      (terminals_per_warehouse > 0 || TPCC::FLAGS_TARGET_TPS > 0 ||
+       !TPCC::FLAGS_TPS_SWEEP.empty() || !TPCC::FLAGS_KV_TRACE_FILE.empty())) {
+    // a trace has no transaction contexts to tell interleaved ones apart
+    printf("INFLIGHT_TXNS needs the closed loop without terminals and no "
+           "KV_TRACE_FILE\n");
+    return 1;
+  }
+
+  TPCC::ThreadPlacement placement;
+  if (!placement.Init(TPCC::FLAGS_PIN_THREADS)) {
+    printf("unknown PIN_THREADS: %s\n", TPCC::FLAGS_PIN_THREADS.c_str());
+    return 1;
+  }
+  if (TPCC::FLAGS_WAREHOUSE_AFFINITY &&
+      (!placement.Enabled() || input_mode == "file" ||
+       terminals_per_warehouse > 0)) {
+    // file inputs are drawn up front and terminals have their warehouse
+    printf("WAREHOUSE_AFFINITY needs PIN_THREADS, no INPUT_MODE=file and no "
+           "terminals\n");
+    return 1;
+  }
+
+  Workload workload{tpcc_client.get(), &tpcc_workgen_arr, rng, kBaseSeed,
+                    input_mode, &input_file, txn_count, num_threads,
+                    terminals_per_warehouse, TPCC::FLAGS_THINK_TIME_SCALE,
+                    inflight_txns, &placement,
+                    TPCC::FLAGS_WAREHOUSE_AFFINITY, TPCC::FLAGS_PERF_COUNTERS,
+                    TPCC::FLAGS_PERF_TXN_SAMPLE};
+  uint64_t warmup_committed = 0;
+  if (TPCC::FLAGS_WARMUP_TXN_COUNT > 0) {
+    phase_control.Enter(TPCC::BenchPhase::kWarmup);
+    Workload warmup = workload;
+    warmup.txn_count = TPCC::FLAGS_WARMUP_TXN_COUNT;
+    // not the inputs the measurement is going to run
+    warmup.base_seed = kBaseSeed ^ kWarmupSalt;
+    if (warmup.input_mode == "file") {
+      warmup.input_mode = "inline";
+    }
+    warmup_committed =
+        RunPhase(warmup, target_tps_list[0], poisson).committed;
+  }
+  // the load and warmup counted too, only the measured transactions are
+  // reported
+  TPCC::TableRecordCounts load_counts = tpcc_client->CollectRecordStats();
+  phase_control.Enter(TPCC::BenchPhase::kMeasure);
+  std::vector<RunStats> phases;
+  for (double target_tps : target_tps_list) {
+    phases.push_back(RunPhase(workload, target_tps, poisson));
+    const RunStats& phase = phases.back();
+    printf("transaction count = %ld, committed = %ld, aborted = %ld, "
+           "threads = %u, sec = %.2lf, tmpC = %.2lf, target tps = %.0lf, "
+           "tps = %.2lf, p50 = %.1lfus, p99 = %.1lfus, p99.9 = %.1lfus\n",
+           txn_count, phase.committed, phase.aborted, num_threads, phase.sec,
+           phase.committed * 60 / phase.sec, target_tps,
+           (phase.committed + phase.aborted) / phase.sec,
+           phase.latency.Percentile(50) / 1000.0,
+           phase.latency.Percentile(99) / 1000.0,
+           phase.latency.Percentile(99.9) / 1000.0);
+  }
+  TPCC::TableRecordCounts run_counts = tpcc_client->CollectRecordStats();
+  uint64_t run_committed = 0;
+  for (const RunStats& phase : phases) {
+    run_committed += phase.committed;
+  }
+  for (size_t i = 0; i < run_counts.size(); i++) {
+    run_counts[i] -= load_counts[i];
+  }
+  TPCC::ConsistencyResult consistency;
+  if (TPCC::FLAGS_VERIFY) {
+    phase_control.Enter(TPCC::BenchPhase::kVerify);
+    consistency = TPCC::ConsistencyChecker(tpcc_client.get()).Run(num_threads);
+    printf("consistency: %lu violations, sec = %.2lf\n",
+           consistency.TotalViolations(), consistency.sec);
+    for (const std::string& example : consistency.examples) {
+      printf("  %s\n", example.c_str());
+    }
+  }
+  phase_control.Finish();
+  const RunStats& last = phases.back();
+  uint64_t committed = last.committed, aborted = last.aborted;
+  double benchsec = last.sec;
+
+  TPCC::RunResults results;
+  results.Add("num_warehouse", TPCC::FLAGS_NUM_WAREHOUSE);
+  results.Add("db_type", TPCC::FLAGS_DB_TYPE);
+  results.Add("db_path", TPCC::FLAGS_DB_PATH);
+  results.Add("load", load_mode);
+  results.Add("durability", TPCC::FLAGS_DURABILITY);
+  results.Add("kv_options", tpcc_client->DumpKVOptions());
+  results.Add("stock_quantity_column", TPCC::FLAGS_STOCK_QUANTITY_COLUMN);
+  results.Add("hot_cold_split", TPCC::FLAGS_HOT_COLD_SPLIT);
+  results.Add("partial_updates", TPCC::FLAGS_PARTIAL_UPDATES);
+  results.Add("num_threads", num_threads);
+  results.Add("rng", TPCC::FLAGS_RNG);
+  results.Add("input_mode", input_mode);
+  results.Add("inflight_txns", inflight_txns);
+  results.Add("pin_threads", TPCC::FLAGS_PIN_THREADS);
+  results.Add("warehouse_affinity", TPCC::FLAGS_WAREHOUSE_AFFINITY);
+  results.Add("warmup_txn_count", TPCC::FLAGS_WARMUP_TXN_COUNT);
+  results.Add("transaction_count", txn_count);
+  results.Add("committed", committed);
+  results.Add("aborted", aborted);
+  results.Add("sec", benchsec);
+  results.Add("tpmC", committed * 60 / benchsec);
+  // heap allocations of the whole process while measuring, the engine's
+  // included
+  const TPCC::PhaseMemory& measure_memory =
+      phase_control.Memory(TPCC::BenchPhase::kMeasure);
+  results.Add("allocs_per_txn", double(measure_memory.allocs.allocations) /
+                                    std::max<uint64_t>(run_committed, 1));
+  if (terminals_per_warehouse > 0) {
+    results.Add("arrival", "terminals");
+    results.Add("terminals_per_warehouse", terminals_per_warehouse);
+    results.Add("think_time_scale", TPCC::FLAGS_THINK_TIME_SCALE);
+  } else {
+    results.Add("arrival", TPCC::FLAGS_TARGET_TPS > 0 || phases.size() > 1
+                               ? TPCC::FLAGS_ARRIVAL
+                               : "closed-loop");
+  }
+  for (size_t i = 0; i < phases.size(); i++) {
+    // one line per offered rate, the last one is also the summary above
+    std::string prefix = phases.size() > 1
+                             ? "sweep_" + std::to_string(i) + "_"
+                             : "";
+    const RunStats& phase = phases[i];
+    results.Add(prefix + "target_tps", target_tps_list[i]);
+    if (phases.size() > 1) {
+      results.Add(prefix + "committed", phase.committed);
+      results.Add(prefix + "sec", phase.sec);
+    }
+    results.Add(prefix + "tps", (phase.committed + phase.aborted) / phase.sec);
+    results.Add(prefix + "latency", phase.latency.Summary());
+    results.Add(prefix + "service_time", phase.service.Summary());
+  }
+  results.Add("record_stats", TPCC::RecordStats::Summary(run_counts));
+  if (TPCC::FLAGS_PERF_COUNTERS) {
+    // per committed transaction of the last phase, the aborted ones count
+    // too
+    if (last.perf.available == 0) {
+      results.Add("perf_per_txn", "unavailable");
+    } else {
+      results.Add("perf_per_txn", last.perf.Summary(committed));
+      printf("perf per committed txn: %s\n",
+             last.perf.Summary(committed).c_str());
+    }
+    for (size_t i = 0; i < TPCC_TX_TYPES; i++) {
+      if (last.perf_samples[i] == 0) {
+        continue;
+      }
+      std::string type = TPCC::TxTypeName(static_cast<TPCC::TPCCTxType>(i));
+      results.Add("perf_" + type, "samples=" +
+                                      std::to_string(last.perf_samples[i]) +
+                                      "; " +
+                                      last.perf_by_type[i].Summary(
+                                          last.perf_samples[i]));
+    }
+  }
+  if (TPCC::FLAGS_RECORD_LATENCY_SAMPLE > 0) {
+    results.Add("op_latency", tpcc_client->DumpOpLatency());
+  }
+  if (TPCC::FLAGS_VERIFY) {
+    results.Add("consistency", consistency.Summary());
+    results.Add("consistency_sec", consistency.sec);
+  }
+  results.Add("kv_stats", tpcc_client->DumpKVStats());
+
+  // Memory: what every phase allocated and the resident set after it, what
+  // the engine holds, and what the harness itself leaves on the heap
+  for (uint32_t i = 0; i < static_cast<uint32_t>(TPCC::BenchPhase::kNone);
+       i++) {
+    TPCC::BenchPhase phase = static_cast<TPCC::BenchPhase>(i);
+    const TPCC::PhaseMemory& memory = phase_control.Memory(phase);
+    if (!memory.entered) {
+      continue;
+    }
+    uint64_t txns = phase == TPCC::BenchPhase::kMeasure  ? run_committed
+                    : phase == TPCC::BenchPhase::kWarmup ? warmup_committed
+                                                         : 0;
+    results.Add(std::string("memory_") + TPCC::BenchPhaseName(phase),
+                memory.Summary(txns));
+  }
+  uint64_t rss = 0, peak_rss = 0;
+  TPCC::ReadResidentSet(&rss, &peak_rss);
+  results.Add("peak_rss", peak_rss);
+  KVMemoryUsage engine_memory = tpcc_client->GetKV()->MemoryUsage();
+  uint64_t engine_per_warehouse =
+      engine_memory.Total() / std::max(TPCC::FLAGS_NUM_WAREHOUSE, 1);
+  results.Add("engine_memory",
+              "table=" + std::to_string(engine_memory.table_bytes) +
+                  "; cache=" + std::to_string(engine_memory.cache_bytes) +
+                  "; index=" + std::to_string(engine_memory.index_bytes) +
+                  "; per_warehouse=" + std::to_string(engine_per_warehouse));
+  uint64_t index_key_arrays = TPCC::TPCCTable::CustomerIndexKeyArrays();
+  uint64_t index_key_bytes =
+      index_key_arrays * TPCC::TPCCTable::CustomerIndexKeyArrayBytes();
+  results.Add("customer_index_key_arrays",
+              "count=" + std::to_string(index_key_arrays) +
+                  "; bytes=" + std::to_string(index_key_bytes));
+  printf("peak rss = %.1lfMB, engine = %.1lfMB (%.1lfMB per warehouse)\n",
+         peak_rss / 1048576.0, engine_memory.Total() / 1048576.0,
+         engine_per_warehouse / 1048576.0);
+
+  if (!TPCC::FLAGS_RESULT_FILE.empty() &&
+      !results.AppendToFile(TPCC::FLAGS_RESULT_FILE)) {
+    printf("write results failed: %s\n", TPCC::FLAGS_RESULT_FILE.c_str());
+  }
 }
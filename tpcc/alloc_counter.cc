@@ -0,0 +1,162 @@
+//
+// alloc_counter.cc
+//
+// Created by Zacharyliu-CS on 06/29/2024.
+// Copyright (c) 2024 liuzhenm@mail.ustc.edu.cn.
+//
+#include "alloc_counter.h"
+#include <malloc.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+namespace TPCC {
+
+namespace {
+
+// Threads count into one of a few shards so that workers do not share a
+// cache line. Utils::ThreadIndex() is not used: every thread allocates,
+// the engine's background threads too, and there are only kMaxThreads
+// indexes.
+const uint32_t kShards = 64;
+
+struct alignas(64) Shard {
+  std::atomic<uint64_t> allocations{0};
+  std::atomic<uint64_t> frees{0};
+  std::atomic<uint64_t> bytes_allocated{0};
+  std::atomic<uint64_t> bytes_freed{0};
+};
+
+Shard g_shards[kShards];
+
+Shard& ThreadShard() {
+  static std::atomic<uint32_t> next_shard(0);
+  static thread_local uint32_t shard = next_shard.fetch_add(1) % kShards;
+  return g_shards[shard];
+}
+
+void* CountedAlloc(size_t size, size_t align, bool nothrow) {
+  if (size == 0) {
+    size = 1;
+  }
+  void* p;
+  if (align <= alignof(std::max_align_t)) {
+    p = malloc(size);
+  } else if (posix_memalign(&p, align, size) != 0) {
+    p = nullptr;
+  }
+  if (p == nullptr) {
+    if (nothrow) {
+      return nullptr;
+    }
+    throw std::bad_alloc();
+  }
+  Shard& shard = ThreadShard();
+  shard.allocations.fetch_add(1, std::memory_order_relaxed);
+  shard.bytes_allocated.fetch_add(malloc_usable_size(p),
+                                  std::memory_order_relaxed);
+  return p;
+}
+
+void CountedFree(void* p) {
+  if (p == nullptr) {
+    return;
+  }
+  Shard& shard = ThreadShard();
+  shard.frees.fetch_add(1, std::memory_order_relaxed);
+  shard.bytes_freed.fetch_add(malloc_usable_size(p),
+                              std::memory_order_relaxed);
+  free(p);
+}
+
+}  // namespace
+
+AllocCounts ReadAllocCounts() {
+  AllocCounts counts;
+  for (const Shard& shard : g_shards) {
+    counts.allocations += shard.allocations.load(std::memory_order_relaxed);
+    counts.frees += shard.frees.load(std::memory_order_relaxed);
+    counts.bytes_allocated +=
+        shard.bytes_allocated.load(std::memory_order_relaxed);
+    counts.bytes_freed += shard.bytes_freed.load(std::memory_order_relaxed);
+  }
+  return counts;
+}
+
+bool ReadResidentSet(uint64_t* rss_bytes, uint64_t* peak_rss_bytes) {
+  FILE* status = fopen("/proc/self/status", "r");
+  if (status == nullptr) {
+    return false;
+  }
+  int found = 0;
+  char line[256];
+  unsigned long long kb;
+  while (fgets(line, sizeof(line), status) != nullptr) {
+    if (sscanf(line, "VmRSS: %llu kB", &kb) == 1) {
+      *rss_bytes = kb << 10;
+      found++;
+    } else if (sscanf(line, "VmHWM: %llu kB", &kb) == 1) {
+      *peak_rss_bytes = kb << 10;
+      found++;
+    }
+  }
+  fclose(status);
+  return found == 2;
+}
+
+}  // end of namespace TPCC
+
+using TPCC::CountedAlloc;
+using TPCC::CountedFree;
+
+void* operator new(size_t size) { return CountedAlloc(size, 0, false); }
+void* operator new[](size_t size) { return CountedAlloc(size, 0, false); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+  return CountedAlloc(size, 0, true);
+}
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+  return CountedAlloc(size, 0, true);
+}
+void* operator new(size_t size, std::align_val_t align) {
+  return CountedAlloc(size, size_t(align), false);
+}
+void* operator new[](size_t size, std::align_val_t align) {
+  return CountedAlloc(size, size_t(align), false);
+}
+void* operator new(size_t size, std::align_val_t align,
+                   const std::nothrow_t&) noexcept {
+  return CountedAlloc(size, size_t(align), true);
+}
+void* operator new[](size_t size, std::align_val_t align,
+                     const std::nothrow_t&) noexcept {
+  return CountedAlloc(size, size_t(align), true);
+}
+
+void operator delete(void* p) noexcept { CountedFree(p); }
+void operator delete[](void* p) noexcept { CountedFree(p); }
+void operator delete(void* p, size_t) noexcept { CountedFree(p); }
+void operator delete[](void* p, size_t) noexcept { CountedFree(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept {
+  CountedFree(p);
+}
+void operator delete[](void* p, const std::nothrow_t&) noexcept {
+  CountedFree(p);
+}
+void operator delete(void* p, std::align_val_t) noexcept { CountedFree(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { CountedFree(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept {
+  CountedFree(p);
+}
+void operator delete[](void* p, size_t, std::align_val_t) noexcept {
+  CountedFree(p);
+}
+void operator delete(void* p, std::align_val_t,
+                     const std::nothrow_t&) noexcept {
+  CountedFree(p);
+}
+void operator delete[](void* p, std::align_val_t,
+                       const std::nothrow_t&) noexcept {
+  CountedFree(p);
+}
@@ -0,0 +1,47 @@
+//
+// alloc_counter.h
+//
+// Created by Zacharyliu-CS on 06/29/2024.
+// Copyright (c) 2024 liuzhenm@mail.ustc.edu.cn.
+//
+#pragma once
+#include <cstdint>
+
+namespace TPCC {
+
+// Heap allocations of the whole process so far, counted by the global
+// operator new and delete that alloc_counter.cc replaces. Memory taken
+// with malloc directly (by C libraries, or an engine's own allocator) is
+// not seen. Bytes are those malloc reserved for the blocks.
+struct AllocCounts {
+  uint64_t allocations = 0;
+  uint64_t frees = 0;
+  uint64_t bytes_allocated = 0;
+  uint64_t bytes_freed = 0;
+
+  // what the allocations kept
+  int64_t HeapGrowth() const { return int64_t(bytes_allocated - bytes_freed); }
+
+  AllocCounts& operator+=(const AllocCounts& other) {
+    allocations += other.allocations;
+    frees += other.frees;
+    bytes_allocated += other.bytes_allocated;
+    bytes_freed += other.bytes_freed;
+    return *this;
+  }
+  AllocCounts& operator-=(const AllocCounts& other) {
+    allocations -= other.allocations;
+    frees -= other.frees;
+    bytes_allocated -= other.bytes_allocated;
+    bytes_freed -= other.bytes_freed;
+    return *this;
+  }
+};
+
+AllocCounts ReadAllocCounts();
+
+// Resident set of the process now and at its peak (VmRSS and VmHWM of
+// /proc/self/status), false when they can not be read.
+bool ReadResidentSet(uint64_t* rss_bytes, uint64_t* peak_rss_bytes);
+
+}  // end of namespace TPCC
@@ -0,0 +1,73 @@
+//
+// config.cc
+//
+// Created by Zacharyliu-CS on 07/12/2023.
+// Copyright (c) 2023 liuzhenm@mail.ustc.edu.cn.
+//
+// The flags of config.h, shared by tpcc, tpcc_replay, the tests and the
+// microbenchmarks. A binary with other defaults sets them before parsing.
+//
+#include "config.h"
+
+namespace TPCC {
+
+DEFINE_bool(DEBUG, true, "Set if output log message.");
+DEFINE_string(RESULT_FILE, "", "Append the results of this run to the file.");
+
+// backends, used by the kv library
+DEFINE_string(DB_TYPE, "rocksdb", "Backend: memorydb, rocksdb or listdb.");
+DEFINE_string(DB_PATH, "/mnt/pmem0/tpccdb", "PATH of DB files stored");
+DEFINE_string(ROCKSDB_PROFILE, "pmem-kvsep",
+              "Named rocksdb configuration: dram-baseline, pmem-kvsep, "
+              "pmem-no-kvsep, write-optimized, read-optimized.");
+DEFINE_string(ROCKSDB_OPTIONS_FILE, "",
+              "RocksDB OPTIONS file applied on top of ROCKSDB_PROFILE.");
+DEFINE_string(ROCKSDB_TXN_MODE, "none",
+              "Engine concurrency control of rocksdb: none, pessimistic "
+              "(TransactionDB) or optimistic (OptimisticTransactionDB).");
+DEFINE_string(DURABILITY, "wal-async",
+              "Durability of a committed transaction: none (no WAL), "
+              "wal-async, wal-sync-per-txn or group-commit.");
+DEFINE_uint32(GROUP_COMMIT_WINDOW_US, 0,
+              "Time the group committer waits for more transactions.");
+
+// tables and transactions
+DEFINE_int32(NUM_WAREHOUSE, 2, "Set the num of warehouse.");
+DEFINE_int32(FREQUENCY_NEW_ORDER, 45, "Default percentage of new-order txn.");
+DEFINE_int32(FREQUENCY_PAYMENT, 43, "Default percentage of payment txn.");
+DEFINE_int32(FREQUENCY_ORDER_STATUS, 4,
+             "Default percentage of order-status txn.");
+DEFINE_int32(FREQUENCY_DELIVERY, 4, "Default percentage of delivery txn.");
+DEFINE_int32(FREQUENCY_STOCK_LEVEL, 4,
+             "Default percentage of stock-level txn.");
+DEFINE_int32(LOAD_THREADS, 1,
+             "Threads populating the tables, each one loads whole warehouses.");
+DEFINE_bool(BULK_LOAD, false,
+            "Load through sorted files ingested by the kv (rocksdb: "
+            "SstFileWriter + IngestExternalFile) instead of puts.");
+DEFINE_string(KV_TRACE_FILE, "",
+              "Record every kv call into this file for tpcc_replay. The load "
+              "is in it unless the db is reused, restored or reopened after "
+              "saving SNAPSHOT_PATH.");
+DEFINE_string(NUMA_DB_PATHS, "",
+              "Comma separated db paths, the i-th one on NUMA node i (modulo "
+              "the nodes). The warehouses are split into one range per path "
+              "and the items copied to all; empty keeps everything in "
+              "DB_PATH.");
+DEFINE_uint32(RECORD_LATENCY_SAMPLE, 0,
+              "Time one in this many kv gets and puts of the record "
+              "operations, reported per table and op; 0 turns it off.");
+DEFINE_bool(HOT_COLD_SPLIT, false,
+            "Store every CUSTOMER and STOCK row as a small record of the "
+            "fields the transactions update and one of the rest, so that "
+            "they write only the small one.");
+DEFINE_bool(PARTIAL_UPDATES, false,
+            "Write the counters Payment, Delivery and NewOrder change as "
+            "field deltas through the kv's Merge() instead of rewriting "
+            "the whole record.");
+DEFINE_bool(STOCK_QUANTITY_COLUMN, false,
+            "Keep S_QUANTITY of every stock row in a dense in-memory "
+            "column that NewOrder updates and StockLevel scans instead of "
+            "reading the stock rows.");
+
+}  // end of namespace TPCC
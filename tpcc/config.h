@@ -11,7 +11,10 @@
 
 namespace TPCC {
 //**************** TPCC table definitions (Schemas of key and value) end **************** //
+// defined in config.cc
 DECLARE_bool(DEBUG);
+DECLARE_string(RESULT_FILE);
+DECLARE_string(DB_TYPE);
 
 DECLARE_int32(NUM_WAREHOUSE);
 DECLARE_int32(FREQUENCY_NEW_ORDER);
@@ -20,6 +23,19 @@ DECLARE_int32(FREQUENCY_ORDER_STATUS);
 DECLARE_int32(FREQUENCY_DELIVERY);
 DECLARE_int32(FREQUENCY_STOCK_LEVEL);
 DECLARE_string(DB_PATH);
+DECLARE_string(ROCKSDB_PROFILE);
+DECLARE_string(ROCKSDB_OPTIONS_FILE);
+DECLARE_string(ROCKSDB_TXN_MODE);
+DECLARE_string(DURABILITY);
+DECLARE_uint32(GROUP_COMMIT_WINDOW_US);
+DECLARE_int32(LOAD_THREADS);
+DECLARE_bool(BULK_LOAD);
+DECLARE_string(KV_TRACE_FILE);
+DECLARE_string(NUMA_DB_PATHS);
+DECLARE_uint32(RECORD_LATENCY_SAMPLE);
+DECLARE_bool(HOT_COLD_SPLIT);
+DECLARE_bool(PARTIAL_UPDATES);
+DECLARE_bool(STOCK_QUANTITY_COLUMN);
 
 #define NUM_DISTRICT_PER_WAREHOUSE 10
 #define NUM_CUSTOMER_PER_DISTRICT 3000
@@ -29,7 +45,7 @@ DECLARE_string(DB_PATH);
 using itemkey_t = uint64_t;
 using DataItem = void;
 
-#define TPCC_TABLE_TYPES 12
+#define TPCC_TABLE_TYPES 16
 #define TPCC_TX_TYPES 5
 
 enum class TPCCTxType {
@@ -54,6 +70,11 @@ enum class TPCCTableType : uint8_t {
   kStockTable,
   kCustomerIndexTable,
   kOrderIndexTable,
+  // HOT_COLD_SPLIT layout of kCustomerTable and kStockTable
+  kCustomerHotTable,
+  kCustomerColdTable,
+  kStockHotTable,
+  kStockColdTable,
   kBottom = TPCC_TABLE_TYPES
 };
 
@@ -73,6 +94,19 @@ inline void TestConfig() {
   LOG("FREQUENCY_DELIVERY: ", FLAGS_FREQUENCY_DELIVERY);
   LOG("FREQUENCY_STOCK_LEVEL: ", FLAGS_FREQUENCY_STOCK_LEVEL);
   LOG("DB_PATH: ", FLAGS_DB_PATH);
+  LOG("ROCKSDB_PROFILE: ", FLAGS_ROCKSDB_PROFILE);
+  LOG("ROCKSDB_OPTIONS_FILE: ", FLAGS_ROCKSDB_OPTIONS_FILE);
+  LOG("ROCKSDB_TXN_MODE: ", FLAGS_ROCKSDB_TXN_MODE);
+  LOG("DURABILITY: ", FLAGS_DURABILITY);
+  LOG("GROUP_COMMIT_WINDOW_US: ", FLAGS_GROUP_COMMIT_WINDOW_US);
+  LOG("LOAD_THREADS: ", FLAGS_LOAD_THREADS);
+  LOG("BULK_LOAD: ", FLAGS_BULK_LOAD);
+  LOG("KV_TRACE_FILE: ", FLAGS_KV_TRACE_FILE);
+  LOG("NUMA_DB_PATHS: ", FLAGS_NUMA_DB_PATHS);
+  LOG("RECORD_LATENCY_SAMPLE: ", FLAGS_RECORD_LATENCY_SAMPLE);
+  LOG("HOT_COLD_SPLIT: ", FLAGS_HOT_COLD_SPLIT);
+  LOG("PARTIAL_UPDATES: ", FLAGS_PARTIAL_UPDATES);
+  LOG("STOCK_QUANTITY_COLUMN: ", FLAGS_STOCK_QUANTITY_COLUMN);
 }
 
 }  // end of namespace TPCC
\ No newline at end of file
@@ -0,0 +1,234 @@
+//
+// consistency.cc
+//
+// Created by Zacharyliu-CS on 06/01/2024.
+// Copyright (c) 2024 liuzhenm@mail.ustc.edu.cn.
+//
+#include "consistency.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <sstream>
+#include <thread>
+#include "utils.h"
+
+namespace TPCC {
+
+namespace {
+
+// W_YTD and D_YTD are floats summed in different orders
+bool SameAmount(double a, double b) {
+  return std::fabs(a - b) <= std::max(1.0, 1e-5 * std::fabs(a));
+}
+
+}  // namespace
+
+uint64_t ConsistencyResult::TotalViolations() const {
+  uint64_t total = 0;
+  for (uint64_t v : violations) {
+    total += v;
+  }
+  return total;
+}
+
+std::string ConsistencyResult::Summary() const {
+  std::ostringstream out;
+  for (size_t i = 0; i < kNumConsistencyConditions; i++) {
+    if (i > 0) {
+      out << " | ";
+    }
+    out << "c" << i + 1 << ": checked=" << checked[i]
+        << "; violations=" << violations[i];
+  }
+  return out.str();
+}
+
+ConsistencyResult ConsistencyChecker::Run(uint32_t num_threads) {
+  uint64_t start_ns = Utils::NowNanos();
+  const uint32_t num_warehouse = tpcc_client_->GetNumWarehouse();
+  num_threads = std::max(1u, std::min(num_threads, num_warehouse));
+  std::vector<ConsistencyResult> results(num_threads);
+  std::vector<std::thread> threads;
+  std::atomic<uint32_t> next_warehouse(1);
+  for (uint32_t t = 0; t < num_threads; t++) {
+    threads.emplace_back([&, t]() {
+      uint32_t w_id;
+      while ((w_id = next_warehouse.fetch_add(1)) <= num_warehouse) {
+        CheckWarehouse(w_id, &results[t]);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  ConsistencyResult total;
+  for (const ConsistencyResult& result : results) {
+    for (size_t i = 0; i < kNumConsistencyConditions; i++) {
+      total.checked[i] += result.checked[i];
+      total.violations[i] += result.violations[i];
+    }
+  }
+  total.examples = examples_;
+  total.sec = (Utils::NowNanos() - start_ns) / 1e9;
+  return total;
+}
+
+void ConsistencyChecker::CheckWarehouse(uint32_t w_id,
+                                        ConsistencyResult* result) {
+  tpcc_warehouse_key_t ware_key;
+  ware_key.w_id = w_id;
+  tpcc_warehouse_val_t ware_val;
+  bool have_warehouse =
+      tpcc_client_->GetRecord(ware_key.item_key, &ware_val) == 1;
+
+  double sum_d_ytd = 0;
+  bool have_districts = true;
+  for (uint32_t d_id = 1; d_id <= tpcc_client_->GetNumDistrictPerWareHouse();
+       d_id++) {
+    tpcc_district_key_t dist_key;
+    dist_key.d_id = tpcc_client_->MakeDistrictKey(w_id, d_id);
+    tpcc_district_val_t dist_val;
+    if (tpcc_client_->GetRecord(dist_key.item_key, &dist_val) != 1) {
+      have_districts = false;
+      Check(ConsistencyCondition::kNextOrderId, result);
+      Violation(ConsistencyCondition::kNextOrderId,
+                "w=" + std::to_string(w_id) + " d=" + std::to_string(d_id) +
+                    ": district missing",
+                result);
+      continue;
+    }
+    sum_d_ytd += dist_val.d_ytd;
+    CheckDistrict(w_id, d_id, dist_val, result);
+  }
+
+  Check(ConsistencyCondition::kWarehouseYtd, result);
+  if (!have_warehouse || !have_districts ||
+      !SameAmount(ware_val.w_ytd, sum_d_ytd)) {
+    std::ostringstream what;
+    what << "w=" << w_id << ": W_YTD=";
+    if (have_warehouse) {
+      what << ware_val.w_ytd;
+    } else {
+      what << "missing";
+    }
+    what << ", sum(D_YTD)=" << sum_d_ytd;
+    Violation(ConsistencyCondition::kWarehouseYtd, what.str(), result);
+  }
+}
+
+void ConsistencyChecker::CheckDistrict(uint32_t w_id, uint32_t d_id,
+                                       const tpcc_district_val_t& district,
+                                       ConsistencyResult* result) {
+  const int32_t next_o_id = district.d_next_o_id;
+  const std::string where =
+      "w=" + std::to_string(w_id) + " d=" + std::to_string(d_id);
+  int32_t max_o_id = 0;
+  int32_t min_no_id = 0, max_no_id = 0;
+  uint64_t new_orders = 0, sum_ol_cnt = 0, order_lines = 0;
+
+  for (int32_t o_id = 1; o_id <= next_o_id; o_id++) {
+    tpcc_new_order_key_t norder_key;
+    norder_key.no_id = tpcc_client_->MakeNewOrderKey(w_id, d_id, o_id);
+    tpcc_new_order_val_t norder_val;
+    bool have_new_order =
+        tpcc_client_->GetRecord(norder_key.item_key, &norder_val) == 1;
+    if (have_new_order) {
+      min_no_id = new_orders == 0 ? o_id : min_no_id;
+      max_no_id = o_id;
+      new_orders++;
+    }
+
+    tpcc_order_key_t order_key;
+    order_key.o_id = tpcc_client_->MakeOrderKey(w_id, d_id, o_id);
+    tpcc_order_val_t order_val;
+    if (tpcc_client_->GetRecord(order_key.item_key, &order_val) != 1) {
+      continue;
+    }
+    max_o_id = o_id;
+    const bool delivered = order_val.o_carrier_id != 0;
+
+    Check(ConsistencyCondition::kCarrierNewOrder, result);
+    if (delivered == have_new_order) {
+      Violation(ConsistencyCondition::kCarrierNewOrder,
+                where + " o=" + std::to_string(o_id) + ": O_CARRIER_ID=" +
+                    std::to_string(order_val.o_carrier_id) +
+                    (have_new_order ? " with" : " without") +
+                    " NEW-ORDER row",
+                result);
+    }
+
+    uint64_t lines = 0;
+    for (int32_t number = 1; number <= tpcc_order_line_val_t::MAX_OL_CNT;
+         number++) {
+      tpcc_order_line_key_t order_line_key;
+      order_line_key.ol_id =
+          tpcc_client_->MakeOrderLineKey(w_id, d_id, o_id, number);
+      tpcc_order_line_val_t order_line_val;
+      if (tpcc_client_->GetRecord(order_line_key.item_key, &order_line_val) !=
+          1) {
+        continue;
+      }
+      lines++;
+      Check(ConsistencyCondition::kDeliveryDate, result);
+      if ((order_line_val.ol_delivery_d != 0) != delivered) {
+        Violation(ConsistencyCondition::kDeliveryDate,
+                  where + " o=" + std::to_string(o_id) + " ol=" +
+                      std::to_string(number) + ": OL_DELIVERY_D=" +
+                      std::to_string(order_line_val.ol_delivery_d) +
+                      ", O_CARRIER_ID=" +
+                      std::to_string(order_val.o_carrier_id),
+                  result);
+      }
+    }
+    sum_ol_cnt += order_val.o_ol_cnt;
+    order_lines += lines;
+    Check(ConsistencyCondition::kOrderLines, result);
+    if (lines != uint64_t(order_val.o_ol_cnt)) {
+      Violation(ConsistencyCondition::kOrderLines,
+                where + " o=" + std::to_string(o_id) + ": O_OL_CNT=" +
+                    std::to_string(order_val.o_ol_cnt) + ", order lines=" +
+                    std::to_string(lines),
+                result);
+    }
+  }
+
+  Check(ConsistencyCondition::kNextOrderId, result);
+  if (max_o_id != next_o_id - 1 ||
+      (new_orders > 0 && max_no_id != next_o_id - 1)) {
+    Violation(ConsistencyCondition::kNextOrderId,
+              where + ": D_NEXT_O_ID=" + std::to_string(next_o_id) +
+                  ", max(O_ID)=" + std::to_string(max_o_id) +
+                  ", max(NO_O_ID)=" + std::to_string(max_no_id),
+              result);
+  }
+  Check(ConsistencyCondition::kNewOrderRange, result);
+  if (new_orders > 0 && uint64_t(max_no_id - min_no_id + 1) != new_orders) {
+    Violation(ConsistencyCondition::kNewOrderRange,
+              where + ": NO_O_ID in [" + std::to_string(min_no_id) + ", " +
+                  std::to_string(max_no_id) + "], " +
+                  std::to_string(new_orders) + " rows",
+              result);
+  }
+  Check(ConsistencyCondition::kOrderLineCount, result);
+  if (sum_ol_cnt != order_lines) {
+    Violation(ConsistencyCondition::kOrderLineCount,
+              where + ": sum(O_OL_CNT)=" + std::to_string(sum_ol_cnt) +
+                  ", order lines=" + std::to_string(order_lines),
+              result);
+  }
+}
+
+void ConsistencyChecker::Violation(ConsistencyCondition condition,
+                                   const std::string& what,
+                                   ConsistencyResult* result) {
+  result->violations[static_cast<size_t>(condition)]++;
+  std::lock_guard<std::mutex> lock(examples_mutex_);
+  if (examples_.size() < kMaxExamples) {
+    examples_.push_back("c" +
+                        std::to_string(static_cast<size_t>(condition) + 1) +
+                        " " + what);
+  }
+}
+
+}  // end of namespace TPCC
@@ -0,0 +1,71 @@
+//
+// consistency.h
+//
+// Created by Zacharyliu-CS on 06/01/2024.
+// Copyright (c) 2024 liuzhenm@mail.ustc.edu.cn.
+//
+#pragma once
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "tpcc_tables.h"
+
+namespace TPCC {
+
+// Consistency conditions of TPC-C clause 3.3.2, numbered as there.
+enum class ConsistencyCondition : uint8_t {
+  kWarehouseYtd = 0,  // 1: W_YTD = sum(D_YTD)
+  kNextOrderId,       // 2: D_NEXT_O_ID - 1 = max(O_ID) = max(NO_O_ID)
+  kNewOrderRange,     // 3: max(NO_O_ID) - min(NO_O_ID) + 1 = #NEW-ORDER
+  kOrderLineCount,    // 4: sum(O_OL_CNT) = #ORDER-LINE per district
+  kCarrierNewOrder,   // 5: O_CARRIER_ID unset iff a NEW-ORDER row exists
+  kOrderLines,        // 6: O_OL_CNT = #ORDER-LINE of the order
+  kDeliveryDate,      // 7: OL_DELIVERY_D unset iff O_CARRIER_ID unset
+  kNumConditions
+};
+static const size_t kNumConsistencyConditions =
+    static_cast<size_t>(ConsistencyCondition::kNumConditions);
+
+struct ConsistencyResult {
+  std::array<uint64_t, kNumConsistencyConditions> checked{};
+  std::array<uint64_t, kNumConsistencyConditions> violations{};
+  std::vector<std::string> examples;  // the first violations found
+  double sec = 0;
+
+  uint64_t TotalViolations() const;
+  // "c1: checked=..; violations=.. | c2: ..."
+  std::string Summary() const;
+};
+
+// Checks the conditions after a run, the warehouses in parallel. The kv
+// has no scans, so rows are probed by key: orders and new orders with ids
+// up to one past D_NEXT_O_ID - 1, order lines up to MAX_OL_CNT per order.
+// Nothing may run transactions meanwhile.
+class ConsistencyChecker {
+ public:
+  explicit ConsistencyChecker(TPCCTable* tpcc_client)
+      : tpcc_client_(tpcc_client) {}
+
+  ConsistencyResult Run(uint32_t num_threads);
+
+ private:
+  static const size_t kMaxExamples = 16;
+
+  void CheckWarehouse(uint32_t w_id, ConsistencyResult* result);
+  void CheckDistrict(uint32_t w_id, uint32_t d_id,
+                     const tpcc_district_val_t& district,
+                     ConsistencyResult* result);
+  void Violation(ConsistencyCondition condition, const std::string& what,
+                 ConsistencyResult* result);
+  static void Check(ConsistencyCondition condition, ConsistencyResult* result) {
+    result->checked[static_cast<size_t>(condition)]++;
+  }
+
+  TPCCTable* tpcc_client_;
+  std::mutex examples_mutex_;
+  std::vector<std::string> examples_;
+};
+
+}  // end of namespace TPCC
@@ -0,0 +1,152 @@
+//
+// coroutine.h
+//
+// Created by Zacharyliu-CS on 04/13/2024.
+// Copyright (c) 2024 liuzhenm@mail.ustc.edu.cn.
+//
+#pragma once
+#include <coroutine>
+#include <exception>
+#include <utility>
+#include <vector>
+#include "kv_interface.h"
+#include "txn_arena.h"
+
+namespace TPCC {
+
+// One transaction run as a coroutine, resolving to whether it committed. It
+// is created suspended; Run() drives it to the end on the calling thread, a
+// TxnScheduler interleaves several of them.
+class TxnTask {
+ public:
+  struct promise_type {
+    bool committed = false;
+    TxnTask get_return_object() {
+      return TxnTask(std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    std::suspend_always final_suspend() noexcept { return {}; }
+    void return_value(bool c) { committed = c; }
+    void unhandled_exception() { std::terminate(); }
+    // frames come from the TxnArena of the thread, which also frees them
+    static void* operator new(size_t size) {
+      return TxnArena::ThreadArena().AllocateFrame(size);
+    }
+    static void operator delete(void* frame, size_t size) {
+      TxnArena::ThreadArena().FreeFrame(frame, size);
+    }
+  };
+
+  TxnTask() = default;
+  TxnTask(const TxnTask&) = delete;
+  TxnTask& operator=(const TxnTask&) = delete;
+  TxnTask(TxnTask&& other) noexcept
+      : handle_(std::exchange(other.handle_, nullptr)) {}
+  TxnTask& operator=(TxnTask&& other) noexcept {
+    if (this != &other) {
+      if (handle_) {
+        handle_.destroy();
+      }
+      handle_ = std::exchange(other.handle_, nullptr);
+    }
+    return *this;
+  }
+  ~TxnTask() {
+    if (handle_) {
+      handle_.destroy();
+    }
+  }
+
+  bool Valid() const { return bool(handle_); }
+  bool Done() const { return handle_.done(); }
+  bool Committed() const { return handle_.promise().committed; }
+  void Resume() { handle_.resume(); }
+
+  // Without a scheduler on the thread every read completes in place, so one
+  // resume runs the transaction through.
+  bool Run() {
+    while (!handle_.done()) {
+      handle_.resume();
+    }
+    return handle_.promise().committed;
+  }
+
+ private:
+  explicit TxnTask(std::coroutine_handle<promise_type> handle)
+      : handle_(handle) {}
+
+  std::coroutine_handle<promise_type> handle_;
+};
+
+// Interleaves the transactions of one thread. A transaction suspends on
+// every read; once all of them wait, their reads go to the kv together
+// (KVInterface::MultiGet) and the readers resume. Installed as the thread's
+// scheduler for its lifetime.
+class TxnScheduler {
+ public:
+  explicit TxnScheduler(KVInterface* kv) : kv_(kv), previous_(Current()) {
+    Current() = this;
+  }
+  TxnScheduler(const TxnScheduler&) = delete;
+  TxnScheduler& operator=(const TxnScheduler&) = delete;
+  ~TxnScheduler() { Current() = previous_; }
+
+  // Scheduler of the calling thread, nullptr when reads complete in place
+  static TxnScheduler*& Current() {
+    static thread_local TxnScheduler* current = nullptr;
+    return current;
+  }
+
+  // Run task under its kv transaction until it reads or ends
+  void Start(TxnTask& task, void* txn_context) {
+    Enter(txn_context);
+    task.Resume();
+    Leave();
+  }
+
+  // Park a read of the running transaction, see TPCCTable::RecordRead
+  void Defer(std::coroutine_handle<> handle, KVRead* read) {
+    read->txn_context = running_context_;
+    pending_.push_back({handle, read});
+  }
+
+  size_t Pending() const { return pending_.size(); }
+
+  // Serve every parked read in one batch and resume the readers, which
+  // may park the next ones.
+  void Flush() {
+    ready_.swap(pending_);
+    pending_.clear();
+    reads_.clear();
+    for (const Waiter& waiter : ready_) {
+      reads_.push_back(waiter.read);
+    }
+    kv_->MultiGet(reads_.data(), reads_.size());
+    for (const Waiter& waiter : ready_) {
+      Enter(waiter.read->txn_context);
+      waiter.handle.resume();
+      Leave();
+    }
+  }
+
+ private:
+  struct Waiter {
+    std::coroutine_handle<> handle;
+    KVRead* read;
+  };
+
+  void Enter(void* txn_context) {
+    running_context_ = txn_context;
+    kv_->SwitchTxnContext(txn_context);
+  }
+  void Leave() { kv_->SwitchTxnContext(nullptr); }
+
+  KVInterface* kv_;
+  TxnScheduler* previous_;
+  void* running_context_ = nullptr;
+  std::vector<Waiter> pending_;
+  std::vector<Waiter> ready_;
+  std::vector<KVRead*> reads_;
+};
+
+}  // end of namespace TPCC
@@ -0,0 +1,52 @@
+//
+// distinct_items.h
+//
+// Created by Zacharyliu-CS on 06/22/2024.
+// Copyright (c) 2024 liuzhenm@mail.ustc.edu.cn.
+//
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace TPCC {
+
+// Set of item ids in [0, num_item] as one bit per item, the distinct count
+// of StockLevel. A count sets the bits of the ids it sees and clears only
+// the words it touched, so it neither sorts nor allocates, and the whole
+// set of 100000 items is 12.5KB.
+class DistinctItemSet {
+ public:
+  explicit DistinctItemSet(uint32_t num_item) : words_(num_item / 64 + 1) {}
+
+  // 1 when id was not in the set yet
+  uint32_t Insert(int32_t id) {
+    uint64_t& word = words_[uint32_t(id) >> 6];
+    uint64_t bit = uint64_t(1) << (uint32_t(id) & 63);
+    uint32_t fresh = (word & bit) == 0;
+    word |= bit;
+    return fresh;
+  }
+
+  // Empty the set again, ids holding every id inserted since it was empty
+  void Clear(const int32_t* ids, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+      words_[uint32_t(ids[i]) >> 6] = 0;
+    }
+  }
+
+  // Distinct values among ids, the set is empty before and after
+  uint32_t CountDistinct(const int32_t* ids, size_t n) {
+    uint32_t distinct = 0;
+    for (size_t i = 0; i < n; i++) {
+      distinct += Insert(ids[i]);
+    }
+    Clear(ids, n);
+    return distinct;
+  }
+
+ private:
+  std::vector<uint64_t> words_;
+};
+
+}  // end of namespace TPCC
@@ -0,0 +1,95 @@
+//
+// histogram.h
+//
+// Created by Zacharyliu-CS on 03/30/2024.
+// Copyright (c) 2024 liuzhenm@mail.ustc.edu.cn.
+//
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <sstream>
+#include <string>
+
+namespace TPCC {
+
+// Log-linear histogram of nanosecond latencies: 32 linear sub-buckets per
+// power of two, so a recorded value is off by at most ~3%. Fixed size and
+// no allocation, one per worker and merged at the end.
+class LatencyHistogram {
+ public:
+  void Add(uint64_t ns) {
+    counts_[IndexOf(ns)]++;
+    count_++;
+    sum_ += ns;
+    max_ = std::max(max_, ns);
+  }
+
+  void Merge(const LatencyHistogram& other) {
+    for (size_t i = 0; i < kBuckets; i++) {
+      counts_[i] += other.counts_[i];
+    }
+    count_ += other.count_;
+    sum_ += other.sum_;
+    max_ = std::max(max_, other.max_);
+  }
+
+  uint64_t Count() const { return count_; }
+  uint64_t Max() const { return max_; }
+  double Mean() const { return count_ == 0 ? 0 : double(sum_) / count_; }
+
+  // Upper bound of the bucket holding the p-th percentile, p in [0, 100].
+  uint64_t Percentile(double p) const {
+    if (count_ == 0) {
+      return 0;
+    }
+    uint64_t rank = std::max<uint64_t>(1, uint64_t(p / 100 * count_ + 0.5));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kBuckets; i++) {
+      seen += counts_[i];
+      if (seen >= rank) {
+        return std::min(UpperBoundOf(i), max_);
+      }
+    }
+    return max_;
+  }
+
+  // "count=..; mean_us=..; p50_us=..; ..."
+  std::string Summary() const {
+    std::ostringstream out;
+    out << "count=" << count_ << "; mean_us=" << Mean() / 1000
+        << "; p50_us=" << Percentile(50) / 1000.0
+        << "; p90_us=" << Percentile(90) / 1000.0
+        << "; p99_us=" << Percentile(99) / 1000.0
+        << "; p999_us=" << Percentile(99.9) / 1000.0
+        << "; max_us=" << max_ / 1000.0;
+    return out.str();
+  }
+
+ private:
+  static const int kSubBits = 5;
+  static const uint64_t kSubBuckets = 1 << kSubBits;
+  // values below 2 * kSubBuckets are exact, then kSubBuckets per power of two
+  static const size_t kBuckets = (64 - kSubBits + 1) * kSubBuckets;
+
+  static size_t IndexOf(uint64_t v) {
+    int msb = 63 - __builtin_clzll(v | 1);
+    int shift = std::max(0, msb - kSubBits);
+    return size_t(shift) * kSubBuckets + (v >> shift);
+  }
+  static uint64_t UpperBoundOf(size_t index) {
+    if (index < 2 * kSubBuckets) {
+      return index;
+    }
+    int shift = int(index / kSubBuckets) - 1;
+    uint64_t sub = index % kSubBuckets + kSubBuckets;
+    return ((sub + 1) << shift) - 1;
+  }
+
+  std::array<uint64_t, kBuckets> counts_{};
+  uint64_t count_ = 0;
+  uint64_t sum_ = 0;
+  uint64_t max_ = 0;
+};
+
+}  // end of namespace TPCC
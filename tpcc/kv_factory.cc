@@ -0,0 +1,46 @@
+//
+// kv_factory.cc
+//
+// Created by Zacharyliu-CS on 03/23/2024.
+// Copyright (c) 2024 liuzhenm@mail.ustc.edu.cn.
+//
+#include "kv_factory.h"
+#include "config.h"
+#include "listdb_impl.h"
+#include "memorydb_impl.h"
+#include "rocksdb_impl.h"
+
+namespace TPCC {
+
+bool ParseDBType(const std::string& name, DBType* db_type) {
+  if (name == "memorydb") {
+    *db_type = DBType::memorydb;
+  } else if (name == "rocksdb") {
+    *db_type = DBType::rocksdb;
+  } else if (name == "listdb") {
+    *db_type = DBType::listdb;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+KVInterface* NewKV(DBType db_type) { return NewKV(db_type, FLAGS_DB_PATH); }
+
+KVInterface* NewKV(DBType db_type, const std::string& db_path) {
+  switch (db_type) {
+    case DBType::memorydb:
+      return new MemoryDBImpl();
+    case DBType::rocksdb:
+      return new RocksDBImpl(db_path, FLAGS_ROCKSDB_PROFILE,
+                             FLAGS_ROCKSDB_OPTIONS_FILE,
+                             FLAGS_ROCKSDB_TXN_MODE, FLAGS_DURABILITY,
+                             FLAGS_GROUP_COMMIT_WINDOW_US);
+    case DBType::listdb:
+      return new ListDBImpl(db_path);
+    default:
+      return new MemoryDBImpl();
+  }
+}
+
+}  // end of namespace TPCC
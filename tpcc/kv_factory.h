@@ -0,0 +1,29 @@
+//
+// kv_factory.h
+//
+// Created by Zacharyliu-CS on 03/23/2024.
+// Copyright (c) 2024 liuzhenm@mail.ustc.edu.cn.
+//
+#pragma once
+#include <cstdint>
+#include <string>
+#include "kv_interface.h"
+
+namespace TPCC {
+
+enum class DBType: uint8_t{
+  memorydb = 0,
+  rocksdb,
+  listdb,
+  neopmkv,
+};
+
+// false for an unknown name
+bool ParseDBType(const std::string& name, DBType* db_type);
+
+// Open the backend configured by the DB_PATH / ROCKSDB_* / DURABILITY flags.
+KVInterface* NewKV(DBType db_type);
+// Same at another path than DB_PATH
+KVInterface* NewKV(DBType db_type, const std::string& db_path);
+
+}  // end of namespace TPCC
@@ -5,14 +5,125 @@
 // Copyright (c) 2023 liuzhenm@mail.ustc.edu.cn.
 //
 #pragma once
+#include <cstddef>
 #include <cstdint>
 #include <string>
+#include "record_delta.h"
+
+// Memory an engine holds as far as it can tell, 0 for what it does not
+// report. See KVInterface::MemoryUsage().
+struct KVMemoryUsage {
+  uint64_t table_bytes = 0;  // rows kept in memory: a map, the memtables
+  uint64_t cache_bytes = 0;  // block cache
+  uint64_t index_bytes = 0;  // table readers: index and filter blocks
+
+  uint64_t Total() const { return table_bytes + cache_bytes + index_bytes; }
+  KVMemoryUsage& operator+=(const KVMemoryUsage& other) {
+    table_bytes += other.table_bytes;
+    cache_bytes += other.cache_bytes;
+    index_bytes += other.index_bytes;
+    return *this;
+  }
+};
+
+// One read of a batch, see KVInterface::MultiGet()
+struct KVRead {
+  uint64_t key = 0;
+  bool for_update = false;
+  void* txn_context = nullptr;  // transaction it belongs to, or none
+  std::string value;
+  int status = -1;  // what Get()/GetForUpdate() returned
+};
+
+// Receives one run of records for bulk loading. Depending on the engine the
+// records are written through or collected into files that only become
+// visible after Finish().
+class KVBulkWriter {
+ public:
+  virtual int Add(uint64_t key, const std::string& value) = 0;
+  virtual int Finish() = 0;
+  virtual ~KVBulkWriter() {}
+};
 
 class KVInterface {
 
  public:
   virtual int Put(uint64_t key, const std::string& value) = 0;
   virtual int Get(uint64_t key, std::string& value) = 0;
+  // Engine-side transaction of the calling thread. Backends without native
+  // transactions ignore the bracket and apply every operation immediately.
+  virtual int Begin() { return 1; }
+  virtual int Commit() { return 1; }
+  virtual int Rollback() { return 1; }
+  // Read a row that the current transaction is going to modify.
+  virtual int GetForUpdate(uint64_t key, std::string& value) {
+    return Get(key, value);
+  }
+  // Apply a RecordDelta to the stored value, -1 when the key is missing or
+  // the delta does not fit it. The default reads, applies and puts back the
+  // whole value; engines that can write the fields alone override it.
+  virtual int Merge(uint64_t key, const std::string& delta);
+  // Remove a row. The default overwrites it with an empty value, a
+  // tombstone that reads as a missing record for TPCCTable.
+  virtual int Delete(uint64_t key) { return Put(key, std::string()); }
+  // Several transactions interleaved on one thread each get a context of
+  // their own; SwitchTxnContext() makes one the transaction of the calling
+  // thread that Begin()..Commit() act on, nullptr goes back to the thread's
+  // own. Backends without native transactions have nothing to switch.
+  virtual void* NewTxnContext() { return nullptr; }
+  virtual void DeleteTxnContext(void* txn_context) {}
+  virtual void SwitchTxnContext(void* txn_context) {}
+  // Serve n reads at once, each within its own transaction context; the
+  // calling thread is back on its own context afterwards. The default reads
+  // them one by one, engines with a batched read path override it.
+  virtual void MultiGet(KVRead* const* reads, size_t n);
+  // Effective engine configuration, recorded in the results of a run.
+  virtual std::string DumpOptions() { return ""; }
+  // Engine-side counters worth reporting next to the run results.
+  virtual std::string DumpStats() { return ""; }
+  // Memory the engine holds now, nothing reported by default.
+  virtual KVMemoryUsage MemoryUsage() { return KVMemoryUsage(); }
+  // Make everything written so far survive a restart.
+  virtual int Flush() { return 1; }
+  // Whether the data is still there after reopening the same path.
+  virtual bool Persistent() { return false; }
+  // Writer for loading one table; sorted tells that the keys will be added
+  // in increasing order. The default writes every record with Put().
+  virtual KVBulkWriter* NewBulkWriter(bool sorted);
   virtual ~KVInterface(){}
  private:
 };
+
+class KVPutWriter : public KVBulkWriter {
+ public:
+  explicit KVPutWriter(KVInterface* kv) : kv_(kv) {}
+  int Add(uint64_t key, const std::string& value) override {
+    return kv_->Put(key, value);
+  }
+  int Finish() override { return 1; }
+
+ private:
+  KVInterface* kv_;
+};
+
+inline KVBulkWriter* KVInterface::NewBulkWriter(bool sorted) {
+  return new KVPutWriter(this);
+}
+
+inline int KVInterface::Merge(uint64_t key, const std::string& delta) {
+  std::string value;
+  if (GetForUpdate(key, value) != 1 || !RecordDelta::Apply(delta, &value)) {
+    return -1;
+  }
+  return Put(key, value);
+}
+
+inline void KVInterface::MultiGet(KVRead* const* reads, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    KVRead* read = reads[i];
+    SwitchTxnContext(read->txn_context);
+    read->status = read->for_update ? GetForUpdate(read->key, read->value)
+                                    : Get(read->key, read->value);
+  }
+  SwitchTxnContext(nullptr);
+}
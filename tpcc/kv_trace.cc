@@ -0,0 +1,207 @@
+//
+// kv_trace.cc
+//
+// Created by Zacharyliu-CS on 03/23/2024.
+// Copyright (c) 2024 liuzhenm@mail.ustc.edu.cn.
+//
+#include "kv_trace.h"
+#include <map>
+#include <sstream>
+#include "logging.h"
+#include "utils.h"
+
+namespace TPCC {
+
+namespace {
+
+// Records what the load writes and passes it on to the writer of the kv
+class TracingBulkWriter : public KVBulkWriter {
+ public:
+  TracingBulkWriter(TracingKV* tracer, KVBulkWriter* writer)
+      : tracer_(tracer), writer_(writer) {}
+  int Add(uint64_t key, const std::string& value) override {
+    tracer_->Record(TraceOp::kLoad, key, &value);
+    return writer_->Add(key, value);
+  }
+  int Finish() override { return writer_->Finish(); }
+
+ private:
+  TracingKV* tracer_;
+  std::unique_ptr<KVBulkWriter> writer_;
+};
+
+// Time origin of every trace file this process created
+std::mutex g_trace_files_mutex;
+std::map<std::string, uint64_t> g_trace_files;
+
+}  // namespace
+
+TracingKV::TracingKV(KVInterface* kv, const std::string& trace_path)
+    : kv_(kv),
+      trace_path_(trace_path),
+      buffers_(new ThreadBuffer[Utils::kMaxThreads]) {
+  std::lock_guard<std::mutex> lock(g_trace_files_mutex);
+  auto file = g_trace_files.find(trace_path);
+  if (file == g_trace_files.end()) {
+    FILE* out = fopen(trace_path.c_str(), "wb");
+    TraceHeader header;
+    if (out == nullptr || fwrite(&header, sizeof(header), 1, out) != 1 ||
+        fclose(out) != 0) {
+      LOG("create kv trace ", trace_path, " failed");
+      abort();
+    }
+    file = g_trace_files.emplace(trace_path, Utils::NowNanos()).first;
+  }
+  start_ns_ = file->second;
+  // unbuffered: a chunk is one append, even while another tracer of the
+  // path still has its file open
+  file_ = fopen(trace_path.c_str(), "ab");
+  if (file_ == nullptr || setvbuf(file_, nullptr, _IONBF, 0) != 0) {
+    LOG("open kv trace ", trace_path, " failed");
+    abort();
+  }
+}
+
+TracingKV::~TracingKV() {
+  for (uint32_t i = 0; i < Utils::kMaxThreads; i++) {
+    FlushBuffer(&buffers_[i]);
+  }
+  if (fclose(file_) != 0) {
+    LOG("write kv trace ", trace_path_, " failed");
+  }
+  delete kv_;
+}
+
+void TracingKV::Record(TraceOp op, uint64_t key, const std::string* value) {
+  uint32_t thread = Utils::ThreadIndex();
+  ThreadBuffer* buffer = &buffers_[thread];
+  if (buffer->bytes.capacity() == 0) {
+    buffer->bytes.reserve(kBufferBytes);
+  }
+  TraceRecord record{Utils::NowNanos() - start_ns_,
+                     key,
+                     value != nullptr ? TraceValueHash(*value) : 0,
+                     value != nullptr ? uint32_t(value->size()) : 0,
+                     op,
+                     uint8_t(key >> 56),
+                     uint16_t(thread)};
+  buffer->bytes.append(reinterpret_cast<const char*>(&record), sizeof(record));
+  if (TraceOpWrites(op)) {
+    buffer->bytes.append(*value);
+  }
+  buffer->records++;
+  if (buffer->bytes.size() >= kBufferBytes) {
+    FlushBuffer(buffer);
+  }
+}
+
+void TracingKV::FlushBuffer(ThreadBuffer* buffer) {
+  if (buffer->bytes.empty()) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(file_mutex_);
+  if (fwrite(buffer->bytes.data(), 1, buffer->bytes.size(), file_) !=
+      buffer->bytes.size()) {
+    LOG("write kv trace ", trace_path_, " failed");
+    abort();
+  }
+  record_count_ += buffer->records;
+  buffer->bytes.clear();
+  buffer->records = 0;
+}
+
+int TracingKV::Put(uint64_t key, const std::string& value) {
+  Record(TraceOp::kPut, key, &value);
+  return kv_->Put(key, value);
+}
+
+int TracingKV::Get(uint64_t key, std::string& value) {
+  int ret = kv_->Get(key, value);
+  Record(TraceOp::kGet, key, ret == -1 ? nullptr : &value);
+  return ret;
+}
+
+int TracingKV::GetForUpdate(uint64_t key, std::string& value) {
+  int ret = kv_->GetForUpdate(key, value);
+  Record(TraceOp::kGetForUpdate, key, ret == -1 ? nullptr : &value);
+  return ret;
+}
+
+int TracingKV::Merge(uint64_t key, const std::string& delta) {
+  Record(TraceOp::kMerge, key, &delta);
+  return kv_->Merge(key, delta);
+}
+
+int TracingKV::Delete(uint64_t key) {
+  Record(TraceOp::kDelete, key, nullptr);
+  return kv_->Delete(key);
+}
+
+void TracingKV::MultiGet(KVRead* const* reads, size_t n) {
+  kv_->MultiGet(reads, n);
+  for (size_t i = 0; i < n; i++) {
+    Record(reads[i]->for_update ? TraceOp::kGetForUpdate : TraceOp::kGet,
+           reads[i]->key,
+           reads[i]->status == -1 ? nullptr : &reads[i]->value);
+  }
+}
+
+int TracingKV::Begin() {
+  Record(TraceOp::kBegin, 0, nullptr);
+  return kv_->Begin();
+}
+
+int TracingKV::Commit() {
+  Record(TraceOp::kCommit, 0, nullptr);
+  return kv_->Commit();
+}
+
+int TracingKV::Rollback() {
+  Record(TraceOp::kRollback, 0, nullptr);
+  return kv_->Rollback();
+}
+
+std::string TracingKV::DumpStats() {
+  std::ostringstream out;
+  out << kv_->DumpStats();
+  if (out.tellp() > 0) {
+    out << "; ";
+  }
+  out << "trace_records_written=" << record_count_.load();
+  return out.str();
+}
+
+KVBulkWriter* TracingKV::NewBulkWriter(bool sorted) {
+  return new TracingBulkWriter(this, kv_->NewBulkWriter(sorted));
+}
+
+bool ReadTrace(const std::string& path, Trace* trace) {
+  FILE* in = fopen(path.c_str(), "rb");
+  if (in == nullptr) {
+    return false;
+  }
+  TraceHeader header;
+  bool ok = fread(&header, sizeof(header), 1, in) == 1 &&
+            header.magic == TraceHeader::kMagic &&
+            header.format_version == TraceHeader::kFormatVersion &&
+            header.record_size == sizeof(TraceRecord);
+  trace->records.clear();
+  trace->value_offsets.clear();
+  trace->values.clear();
+  TraceRecord record;
+  while (ok && fread(&record, sizeof(record), 1, in) == 1) {
+    trace->records.push_back(record);
+    trace->value_offsets.push_back(trace->values.size());
+    if (TraceOpWrites(record.op)) {
+      size_t offset = trace->values.size();
+      trace->values.resize(offset + record.value_size);
+      ok = fread(&trace->values[offset], 1, record.value_size, in) ==
+           record.value_size;
+    }
+  }
+  ok = ok && !ferror(in);
+  fclose(in);
+  return ok;
+}
+
+}  // end of namespace TPCC
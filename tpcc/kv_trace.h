@@ -0,0 +1,134 @@
+//
+// kv_trace.h
+//
+// Created by Zacharyliu-CS on 03/23/2024.
+// Copyright (c) 2024 liuzhenm@mail.ustc.edu.cn.
+//
+#pragma once
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "kv_interface.h"
+
+namespace TPCC {
+
+enum class TraceOp : uint8_t {
+  kPut = 0,
+  kGet,
+  kGetForUpdate,
+  kBegin,
+  kCommit,
+  kRollback,
+  kLoad,  // record added through a bulk writer
+  kMerge,  // the value is the delta
+  kDelete,
+};
+
+// Whether the bytes a call wrote follow its record in the trace
+inline bool TraceOpWrites(TraceOp op) {
+  return op == TraceOp::kPut || op == TraceOp::kLoad || op == TraceOp::kMerge;
+}
+
+// FNV-1a of a value
+inline uint64_t TraceValueHash(const std::string& value) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (char c : value) {
+    hash = (hash ^ uint8_t(c)) * 1099511628211ULL;
+  }
+  return hash;
+}
+
+// One KVInterface call. In the file a call that writes (TraceOpWrites()) is
+// followed by the value_size bytes it wrote.
+struct TraceRecord {
+  uint64_t time_ns;     // since the first tracer of the file was created
+  uint64_t key;         // 0 for transaction boundaries
+  uint64_t value_hash;  // TraceValueHash() of the bytes written or read
+  uint32_t value_size;  // bytes written, or read (0 when the key is missing)
+  TraceOp op;
+  uint8_t table;    // TPCCTableType, the top byte of the key
+  uint16_t thread;  // Utils::ThreadIndex() of the caller
+};
+static_assert(sizeof(TraceRecord) == 32, "trace records are packed");
+
+struct TraceHeader {
+  static const uint64_t kMagic = 0x3143525443435054;  // "TPCCTRC1"
+  static const uint32_t kFormatVersion = 2;
+
+  uint64_t magic = kMagic;
+  uint32_t format_version = kFormatVersion;
+  uint32_t record_size = sizeof(TraceRecord);
+};
+
+// Decorator recording every call made to kv into a trace file. Records are
+// buffered per thread and appended in chunks, so the records of one thread
+// are in order but the threads interleave by chunk. The first tracer of a
+// path in the process creates the file, the later ones (PrepareDB()
+// reopening the store) append to it.
+class TracingKV : public KVInterface {
+ public:
+  // Takes ownership of kv; aborts when the trace can not be created.
+  TracingKV(KVInterface* kv, const std::string& trace_path);
+  int Put(uint64_t key, const std::string& value) override;
+  int Get(uint64_t key, std::string& value) override;
+  int Begin() override;
+  int Commit() override;
+  int Rollback() override;
+  int GetForUpdate(uint64_t key, std::string& value) override;
+  int Merge(uint64_t key, const std::string& delta) override;
+  int Delete(uint64_t key) override;
+  // A trace has no transaction contexts, tpcc does not record runs that
+  // interleave transactions (INFLIGHT_TXNS).
+  void* NewTxnContext() override { return kv_->NewTxnContext(); }
+  void DeleteTxnContext(void* txn_context) override {
+    kv_->DeleteTxnContext(txn_context);
+  }
+  void SwitchTxnContext(void* txn_context) override {
+    kv_->SwitchTxnContext(txn_context);
+  }
+  void MultiGet(KVRead* const* reads, size_t n) override;
+  std::string DumpOptions() override { return kv_->DumpOptions(); }
+  std::string DumpStats() override;
+  KVMemoryUsage MemoryUsage() override { return kv_->MemoryUsage(); }
+  int Flush() override { return kv_->Flush(); }
+  bool Persistent() override { return kv_->Persistent(); }
+  KVBulkWriter* NewBulkWriter(bool sorted) override;
+  virtual ~TracingKV();
+
+  // value is what the call wrote or read, nullptr for none
+  void Record(TraceOp op, uint64_t key, const std::string* value);
+
+ private:
+  static const size_t kBufferBytes = 256 << 10;
+
+  struct alignas(64) ThreadBuffer {
+    std::string bytes;  // records and the values written
+    uint64_t records = 0;
+  };
+
+  void FlushBuffer(ThreadBuffer* buffer);
+
+  KVInterface* kv_;
+  std::string trace_path_;
+  FILE* file_ = nullptr;
+  std::mutex file_mutex_;
+  std::unique_ptr<ThreadBuffer[]> buffers_;
+  uint64_t start_ns_;
+  std::atomic<uint64_t> record_count_{0};
+};
+
+// A trace read back into memory
+struct Trace {
+  std::vector<TraceRecord> records;
+  // the bytes records[i] wrote start at value_offsets[i] in values
+  std::vector<uint64_t> value_offsets;
+  std::string values;
+};
+
+// Read a whole trace, false when it is missing or malformed.
+bool ReadTrace(const std::string& path, Trace* trace);
+
+}  // end of namespace TPCC
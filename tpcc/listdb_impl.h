@@ -12,6 +12,10 @@
 #include "listdb/db_client.h"
 #include "listdb/listdb.h"
 
+// Merge() is the read-modify-put of KVInterface: ListDB only stores whole
+// values, appended to its log, and has no merge operand to hold a delta.
+// Patching the value in the log would change it under lock-free readers
+// and past what its recovery expects.
 class ListDBImpl : public KVInterface {
  public:
   ListDBImpl(std::string dbpath);
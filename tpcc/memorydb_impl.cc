@@ -8,13 +8,46 @@
 #include <string>
 
 int MemoryDBImpl::Put(uint64_t key, const std::string& value) {
+  std::unique_lock<std::shared_mutex> lock(mutex_);
   memory_db.insert_or_assign(key, value);
   return 1;
 }
 int MemoryDBImpl::Get(uint64_t key, std::string& value) {
+  std::shared_lock<std::shared_mutex> lock(mutex_);
   auto res = memory_db.find(key);
   if (res == memory_db.end())
     return -1;
-  value = res->second.data();
+  value = res->second;
   return 1;
 }
+int MemoryDBImpl::Merge(uint64_t key, const std::string& delta) {
+  std::unique_lock<std::shared_mutex> lock(mutex_);
+  auto res = memory_db.find(key);
+  if (res == memory_db.end() || !RecordDelta::Apply(delta, &res->second))
+    return -1;
+  return 1;
+}
+int MemoryDBImpl::Delete(uint64_t key) {
+  std::unique_lock<std::shared_mutex> lock(mutex_);
+  memory_db.erase(key);
+  return 1;
+}
+
+KVMemoryUsage MemoryDBImpl::MemoryUsage() {
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  // a node holds the next pointer and the pair, a value longer than the
+  // inline buffer of std::string has its own block
+  const size_t kNodeBytes =
+      sizeof(void*) + sizeof(decltype(memory_db)::value_type);
+  const size_t kInlineChars = std::string().capacity();
+  uint64_t bytes = memory_db.bucket_count() * sizeof(void*) +
+                   memory_db.size() * kNodeBytes;
+  for (const auto& entry : memory_db) {
+    if (entry.second.capacity() > kInlineChars) {
+      bytes += entry.second.capacity() + 1;
+    }
+  }
+  KVMemoryUsage usage;
+  usage.table_bytes = bytes;
+  return usage;
+}
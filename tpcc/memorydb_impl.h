@@ -7,6 +7,8 @@
 #pragma once
 #include <map>
 #include <memory>
+#include <mutex>
+#include <shared_mutex>
 #include <string>
 #include <unordered_map>
 #include "kv_interface.h"
@@ -16,7 +18,13 @@ class MemoryDBImpl : public KVInterface {
  public:
   int Put(uint64_t key, const std::string& value) override;
   int Get(uint64_t key, std::string& value) override;
+  // in place, under the map lock
+  int Merge(uint64_t key, const std::string& delta) override;
+  int Delete(uint64_t key) override;
+  // walks the whole map, for the end of a run
+  KVMemoryUsage MemoryUsage() override;
   virtual ~MemoryDBImpl(){}
  private:
+  std::shared_mutex mutex_;  // worker threads share the map
   std::unordered_map<uint64_t, std::string> memory_db;
 };
@@ -0,0 +1,134 @@
+//
+// numa.cc
+//
+// Created by Zacharyliu-CS on 04/20/2024.
+// Copyright (c) 2024 liuzhenm@mail.ustc.edu.cn.
+//
+#include "numa.h"
+#include <pthread.h>
+#include <sched.h>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+namespace TPCC {
+
+namespace {
+
+bool ReadCpuList(const std::string& path, std::vector<int>* cpus) {
+  std::ifstream in(path);
+  std::string text;
+  return std::getline(in, text) && ParseCpuList(text, cpus);
+}
+
+bool PinThreadToCpus(const std::vector<int>& cpus) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (int cpu : cpus) {
+    if (cpu >= 0 && cpu < CPU_SETSIZE) {
+      CPU_SET(cpu, &set);
+    }
+  }
+  return CPU_COUNT(&set) > 0 &&
+         pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+}  // namespace
+
+bool ParseCpuList(const std::string& text, std::vector<int>* cpus) {
+  cpus->clear();
+  std::stringstream in(text);
+  std::string range;
+  while (std::getline(in, range, ',')) {
+    if (range.empty()) {
+      continue;
+    }
+    int first, last;
+    char dash;
+    std::stringstream r(range);
+    if (!(r >> first) || first < 0) {
+      return false;
+    }
+    last = first;
+    if (r >> dash && (dash != '-' || !(r >> last) || last < first)) {
+      return false;
+    }
+    for (int cpu = first; cpu <= last; cpu++) {
+      cpus->push_back(cpu);
+    }
+  }
+  return !cpus->empty();
+}
+
+NumaTopology::NumaTopology() {
+  std::vector<int> cpus;
+  for (uint32_t node = 0;; node++) {
+    std::string dir = "/sys/devices/system/node/node" + std::to_string(node);
+    if (!ReadCpuList(dir + "/cpulist", &cpus)) {
+      // nodes are numbered densely on the hosts we run on
+      break;
+    }
+    node_cpus_.push_back(cpus);
+  }
+  if (node_cpus_.empty()) {
+    if (!ReadCpuList("/sys/devices/system/cpu/online", &cpus)) {
+      cpus.assign(1, 0);
+    }
+    node_cpus_.push_back(cpus);
+  }
+  for (uint32_t node = 0; node < node_cpus_.size(); node++) {
+    for (int cpu : node_cpus_[node]) {
+      if (size_t(cpu) >= cpu_node_.size()) {
+        cpu_node_.resize(cpu + 1, 0);
+      }
+      cpu_node_[cpu] = node;
+    }
+  }
+}
+
+const NumaTopology& NumaTopology::Get() {
+  static const NumaTopology topology;
+  return topology;
+}
+
+uint32_t NumaTopology::CurrentNode() const {
+  return node_cpus_.size() == 1 ? 0 : NodeOfCpu(sched_getcpu());
+}
+
+bool ThreadPlacement::Init(const std::string& mode) {
+  const NumaTopology& topology = NumaTopology::Get();
+  cpus_.clear();
+  if (mode == "none") {
+    return true;
+  }
+  if (mode == "compact") {
+    for (uint32_t node = 0; node < topology.NumNodes(); node++) {
+      const std::vector<int>& cpus = topology.CpusOf(node);
+      cpus_.insert(cpus_.end(), cpus.begin(), cpus.end());
+    }
+    return true;
+  }
+  if (mode == "scatter") {
+    size_t widest = 0;
+    for (uint32_t node = 0; node < topology.NumNodes(); node++) {
+      widest = std::max(widest, topology.CpusOf(node).size());
+    }
+    for (size_t i = 0; i < widest; i++) {
+      for (uint32_t node = 0; node < topology.NumNodes(); node++) {
+        if (i < topology.CpusOf(node).size()) {
+          cpus_.push_back(topology.CpusOf(node)[i]);
+        }
+      }
+    }
+    return true;
+  }
+  return ParseCpuList(mode, &cpus_);
+}
+
+bool PinThread(int cpu) { return PinThreadToCpus({cpu}); }
+
+bool PinThreadToNode(uint32_t node) {
+  return PinThreadToCpus(NumaTopology::Get().CpusOf(node));
+}
+
+}  // end of namespace TPCC
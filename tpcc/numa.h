@@ -0,0 +1,64 @@
+//
+// numa.h
+//
+// Created by Zacharyliu-CS on 04/20/2024.
+// Copyright (c) 2024 liuzhenm@mail.ustc.edu.cn.
+//
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace TPCC {
+
+// CPUs of every NUMA node, read from sysfs once. A host without NUMA
+// information is a single node holding all online CPUs.
+class NumaTopology {
+ public:
+  static const NumaTopology& Get();
+
+  uint32_t NumNodes() const { return node_cpus_.size(); }
+  const std::vector<int>& CpusOf(uint32_t node) const {
+    return node_cpus_[node % node_cpus_.size()];
+  }
+  uint32_t NodeOfCpu(int cpu) const {
+    return cpu >= 0 && size_t(cpu) < cpu_node_.size() ? cpu_node_[cpu] : 0;
+  }
+  // node of the CPU the calling thread runs on at the moment
+  uint32_t CurrentNode() const;
+
+ private:
+  NumaTopology();
+
+  std::vector<std::vector<int>> node_cpus_;
+  std::vector<uint32_t> cpu_node_;
+};
+
+// "0-3,8,10-11" as in sysfs and taskset; false when malformed
+bool ParseCpuList(const std::string& text, std::vector<int>* cpus);
+
+// CPU every worker is pinned to, after PIN_THREADS:
+//   none     no pinning
+//   compact  the CPUs of node 0 first, then those of node 1, ...
+//   scatter  the nodes in turn, worker i on node i % nodes
+//   a list   worker i on the i-th CPU of the list, e.g. "0-7,16-23"
+// Workers beyond the CPUs wrap around.
+class ThreadPlacement {
+ public:
+  // false for a malformed mode or list
+  bool Init(const std::string& mode);
+  bool Enabled() const { return !cpus_.empty(); }
+  // -1 when not pinned
+  int CpuOf(uint32_t worker) const {
+    return cpus_.empty() ? -1 : cpus_[worker % cpus_.size()];
+  }
+
+ private:
+  std::vector<int> cpus_;
+};
+
+// Restrict the calling thread to one CPU, or to the CPUs of one node.
+bool PinThread(int cpu);
+bool PinThreadToNode(uint32_t node);
+
+}  // end of namespace TPCC
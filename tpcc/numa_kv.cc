@@ -0,0 +1,342 @@
+//
+// numa_kv.cc
+//
+// Created by Zacharyliu-CS on 04/20/2024.
+// Copyright (c) 2024 liuzhenm@mail.ustc.edu.cn.
+//
+#include "numa_kv.h"
+#include <cassert>
+#include <sstream>
+#include <thread>
+#include "config.h"
+#include "logging.h"
+#include "numa.h"
+
+namespace TPCC {
+
+// Passes every record to the writer of its shard, items to all of them
+class NumaBulkWriter : public KVBulkWriter {
+ public:
+  NumaBulkWriter(NumaKV* kv, bool sorted)
+      : kv_(kv), sorted_(sorted), writers_(kv->shards_.size()) {}
+
+  int Add(uint64_t key, const std::string& value) override {
+    if (!kv_->Replicated(key)) {
+      return Writer(kv_->ShardOf(key))->Add(key, value);
+    }
+    int ret = 1;
+    for (uint32_t i = 0; i < writers_.size(); i++) {
+      if (Writer(i)->Add(key, value) != 1) {
+        ret = -1;
+      }
+    }
+    return ret;
+  }
+
+  int Finish() override {
+    int ret = 1;
+    for (auto& writer : writers_) {
+      if (writer && writer->Finish() != 1) {
+        ret = -1;
+      }
+    }
+    return ret;
+  }
+
+ private:
+  KVBulkWriter* Writer(uint32_t shard) {
+    if (!writers_[shard]) {
+      writers_[shard].reset(kv_->shards_[shard].kv->NewBulkWriter(sorted_));
+    }
+    return writers_[shard].get();
+  }
+
+  NumaKV* kv_;
+  bool sorted_;
+  std::vector<std::unique_ptr<KVBulkWriter>> writers_;
+};
+
+NumaKV::NumaKV(DBType db_type, const std::vector<std::string>& db_paths,
+               uint32_t num_warehouse, WarehouseOf warehouse_of)
+    : shards_(db_paths.size()),
+      num_warehouse_(num_warehouse),
+      warehouse_of_(std::move(warehouse_of)),
+      access_counts_(new AccessCount[Utils::kMaxThreads]),
+      thread_txns_(new Txn[Utils::kMaxThreads]),
+      current_txn_(new TxnContext*[Utils::kMaxThreads]()) {
+  if (db_paths.empty()) {
+    LOG("NumaKV needs at least one db path");
+    abort();
+  }
+  const NumaTopology& topology = NumaTopology::Get();
+  node_shard_.assign(topology.NumNodes(), 0);
+  for (uint32_t i = db_paths.size(); i-- > 0;) {
+    Shard& shard = shards_[i];
+    shard.db_path = db_paths[i];
+    shard.node = i % topology.NumNodes();
+    node_shard_[shard.node] = i;  // the first shard of the node
+    // first touch: open the shard from its node
+    std::thread opener([&]() {
+      PinThreadToNode(shard.node);
+      shard.kv.reset(NewKV(db_type, shard.db_path));
+    });
+    opener.join();
+  }
+}
+
+NumaKV::~NumaKV() {}
+
+bool NumaKV::Replicated(uint64_t key) const {
+  return static_cast<TPCCTableType>(key >> 56) == TPCCTableType::kItemTable;
+}
+
+uint32_t NumaKV::ShardOf(uint64_t key) {
+  uint32_t w_id = warehouse_of_(key);
+  if (w_id == 0 || w_id > num_warehouse_) {
+    return 0;
+  }
+  return ShardOfWarehouse(w_id, num_warehouse_, shards_.size());
+}
+
+uint32_t NumaKV::Route(uint64_t key) {
+  uint32_t node = NumaTopology::Get().CurrentNode();
+  uint32_t shard =
+      Replicated(key) ? node_shard_[node % node_shard_.size()] : ShardOf(key);
+  AccessCount& count = access_counts_[Utils::ThreadIndex()];
+  if (shards_[shard].node == node) {
+    count.local++;
+  } else {
+    count.remote++;
+  }
+  return shard;
+}
+
+NumaKV::Txn& NumaKV::CurrentTxn() {
+  uint32_t thread = Utils::ThreadIndex();
+  TxnContext* context = current_txn_[thread];
+  return context != nullptr ? context->txn : thread_txns_[thread];
+}
+
+int NumaKV::BeginShard(Txn& txn, uint32_t shard) {
+  if (!txn.open || txn.begun[shard]) {
+    return 1;
+  }
+  txn.begun[shard] = 1;
+  return shards_[shard].kv->Begin();
+}
+
+int NumaKV::EndTxn(Txn& txn, bool commit) {
+  int ret = 1;
+  for (size_t i = 0; i < shards_.size() && txn.open; i++) {
+    if (txn.begun[i]) {
+      KVInterface* kv = shards_[i].kv.get();
+      if ((commit ? kv->Commit() : kv->Rollback()) != 1) {
+        ret = -1;
+      }
+      txn.begun[i] = 0;
+    }
+  }
+  txn.open = false;
+  return ret;
+}
+
+int NumaKV::Put(uint64_t key, const std::string& value) {
+  Txn& txn = CurrentTxn();
+  if (!Replicated(key)) {
+    uint32_t shard = Route(key);
+    if (BeginShard(txn, shard) != 1) {
+      return -1;
+    }
+    return shards_[shard].kv->Put(key, value);
+  }
+  int ret = 1;
+  for (uint32_t i = 0; i < shards_.size(); i++) {
+    if (BeginShard(txn, i) != 1 || shards_[i].kv->Put(key, value) != 1) {
+      ret = -1;
+    }
+  }
+  return ret;
+}
+
+int NumaKV::Get(uint64_t key, std::string& value) {
+  uint32_t shard = Route(key);
+  if (BeginShard(CurrentTxn(), shard) != 1) {
+    return -1;
+  }
+  return shards_[shard].kv->Get(key, value);
+}
+
+int NumaKV::GetForUpdate(uint64_t key, std::string& value) {
+  uint32_t shard = Route(key);
+  if (BeginShard(CurrentTxn(), shard) != 1) {
+    return -1;
+  }
+  return shards_[shard].kv->GetForUpdate(key, value);
+}
+
+int NumaKV::Merge(uint64_t key, const std::string& delta) {
+  Txn& txn = CurrentTxn();
+  if (!Replicated(key)) {
+    uint32_t shard = Route(key);
+    if (BeginShard(txn, shard) != 1) {
+      return -1;
+    }
+    return shards_[shard].kv->Merge(key, delta);
+  }
+  int ret = 1;
+  for (uint32_t i = 0; i < shards_.size(); i++) {
+    if (BeginShard(txn, i) != 1 || shards_[i].kv->Merge(key, delta) != 1) {
+      ret = -1;
+    }
+  }
+  return ret;
+}
+
+int NumaKV::Delete(uint64_t key) {
+  Txn& txn = CurrentTxn();
+  if (!Replicated(key)) {
+    uint32_t shard = Route(key);
+    if (BeginShard(txn, shard) != 1) {
+      return -1;
+    }
+    return shards_[shard].kv->Delete(key);
+  }
+  int ret = 1;
+  for (uint32_t i = 0; i < shards_.size(); i++) {
+    if (BeginShard(txn, i) != 1 || shards_[i].kv->Delete(key) != 1) {
+      ret = -1;
+    }
+  }
+  return ret;
+}
+
+int NumaKV::Begin() {
+  Txn& txn = CurrentTxn();
+  assert(!txn.open);
+  txn.open = true;
+  txn.begun.assign(shards_.size(), 0);
+  return 1;
+}
+
+int NumaKV::Commit() { return EndTxn(CurrentTxn(), true); }
+
+int NumaKV::Rollback() { return EndTxn(CurrentTxn(), false); }
+
+// a context holds one context per shard
+void* NumaKV::NewTxnContext() {
+  auto* context = new TxnContext();
+  context->shard_contexts.resize(shards_.size());
+  for (size_t i = 0; i < shards_.size(); i++) {
+    context->shard_contexts[i] = shards_[i].kv->NewTxnContext();
+  }
+  return context;
+}
+
+void NumaKV::DeleteTxnContext(void* txn_context) {
+  auto* context = static_cast<TxnContext*>(txn_context);
+  for (size_t i = 0; i < shards_.size(); i++) {
+    shards_[i].kv->DeleteTxnContext(context->shard_contexts[i]);
+  }
+  delete context;
+}
+
+void NumaKV::SwitchTxnContext(void* txn_context) {
+  auto* context = static_cast<TxnContext*>(txn_context);
+  current_txn_[Utils::ThreadIndex()] = context;
+  for (size_t i = 0; i < shards_.size(); i++) {
+    shards_[i].kv->SwitchTxnContext(context ? context->shard_contexts[i]
+                                            : nullptr);
+  }
+}
+
+void NumaKV::MultiGet(KVRead* const* reads, size_t n) {
+  // one batch per shard, each read under the context of that shard
+  std::vector<std::vector<KVRead*>> batches(shards_.size());
+  std::vector<void*> contexts(n);
+  bool switched = false;
+  for (size_t i = 0; i < n; i++) {
+    uint32_t shard = Route(reads[i]->key);
+    auto* context = static_cast<TxnContext*>(reads[i]->txn_context);
+    Txn& txn = context != nullptr ? context->txn
+                                  : thread_txns_[Utils::ThreadIndex()];
+    if (txn.open && !txn.begun[shard]) {
+      // the transaction reaches the shard with this read
+      SwitchTxnContext(context);
+      BeginShard(txn, shard);
+      switched = true;
+    }
+    contexts[i] = context;
+    if (context != nullptr) {
+      reads[i]->txn_context = context->shard_contexts[shard];
+    }
+    batches[shard].push_back(reads[i]);
+  }
+  if (switched) {
+    SwitchTxnContext(nullptr);
+  }
+  for (size_t shard = 0; shard < shards_.size(); shard++) {
+    if (!batches[shard].empty()) {
+      shards_[shard].kv->MultiGet(batches[shard].data(),
+                                  batches[shard].size());
+    }
+  }
+  for (size_t i = 0; i < n; i++) {
+    reads[i]->txn_context = contexts[i];
+  }
+}
+
+std::string NumaKV::DumpOptions() {
+  std::ostringstream out;
+  out << "numa_nodes=" << NumaTopology::Get().NumNodes();
+  for (size_t i = 0; i < shards_.size(); i++) {
+    out << "; shard" << i << "=" << shards_[i].db_path << "@node"
+        << shards_[i].node;
+  }
+  std::string options = shards_[0].kv->DumpOptions();
+  if (!options.empty()) {
+    out << "; " << options;
+  }
+  return out.str();
+}
+
+std::string NumaKV::DumpStats() {
+  uint64_t local = 0, remote = 0;
+  for (uint32_t i = 0; i < Utils::kMaxThreads; i++) {
+    local += access_counts_[i].local;
+    remote += access_counts_[i].remote;
+  }
+  std::ostringstream out;
+  out << "numa_local_accesses=" << local
+      << "; numa_remote_accesses=" << remote;
+  for (size_t i = 0; i < shards_.size(); i++) {
+    std::string stats = shards_[i].kv->DumpStats();
+    if (!stats.empty()) {
+      out << "; shard" << i << ": " << stats;
+    }
+  }
+  return out.str();
+}
+
+KVMemoryUsage NumaKV::MemoryUsage() {
+  KVMemoryUsage usage;
+  for (Shard& shard : shards_) {
+    usage += shard.kv->MemoryUsage();
+  }
+  return usage;
+}
+
+int NumaKV::Flush() {
+  int ret = 1;
+  for (Shard& shard : shards_) {
+    if (shard.kv->Flush() != 1) {
+      ret = -1;
+    }
+  }
+  return ret;
+}
+
+KVBulkWriter* NumaKV::NewBulkWriter(bool sorted) {
+  return new NumaBulkWriter(this, sorted);
+}
+
+}  // end of namespace TPCC
@@ -0,0 +1,113 @@
+//
+// numa_kv.h
+//
+// Created by Zacharyliu-CS on 04/20/2024.
+// Copyright (c) 2024 liuzhenm@mail.ustc.edu.cn.
+//
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "kv_factory.h"
+#include "kv_interface.h"
+#include "utils.h"
+
+namespace TPCC {
+
+// Splits the rows over one backend (shard) per NUMA_DB_PATHS entry. The
+// warehouses are cut into contiguous ranges, one per shard, and every row
+// goes to the shard of its warehouse; the item table, read by all
+// warehouses, is copied to every shard and read from the local one. Shard
+// i belongs to node i % nodes and is opened from a thread of that node, so
+// the memory it allocates up front and the threads it starts stay there.
+//
+// Begin() only opens the transaction; it begins on a shard right before
+// its first access there, and commits on the shards it began on. A
+// transaction touching several shards commits on each independently, so
+// the shards must not fail a commit (tpcc rejects a transactional
+// ROCKSDB_TXN_MODE with NUMA_DB_PATHS).
+class NumaKV : public KVInterface {
+ public:
+  // warehouse of a key, 0 when it belongs to none
+  using WarehouseOf = std::function<uint32_t(uint64_t key)>;
+
+  NumaKV(DBType db_type, const std::vector<std::string>& db_paths,
+         uint32_t num_warehouse, WarehouseOf warehouse_of);
+  ~NumaKV() override;
+
+  // Shard holding warehouse w_id out of num_warehouse
+  static uint32_t ShardOfWarehouse(uint32_t w_id, uint32_t num_warehouse,
+                                   uint32_t num_shards) {
+    return uint32_t(uint64_t(w_id - 1) * num_shards / num_warehouse);
+  }
+
+  int Put(uint64_t key, const std::string& value) override;
+  int Get(uint64_t key, std::string& value) override;
+  int GetForUpdate(uint64_t key, std::string& value) override;
+  int Merge(uint64_t key, const std::string& delta) override;
+  int Delete(uint64_t key) override;
+  int Begin() override;
+  int Commit() override;
+  int Rollback() override;
+  void* NewTxnContext() override;
+  void DeleteTxnContext(void* txn_context) override;
+  void SwitchTxnContext(void* txn_context) override;
+  void MultiGet(KVRead* const* reads, size_t n) override;
+  std::string DumpOptions() override;
+  std::string DumpStats() override;
+  KVMemoryUsage MemoryUsage() override;
+  int Flush() override;
+  bool Persistent() override { return shards_[0].kv->Persistent(); }
+  KVBulkWriter* NewBulkWriter(bool sorted) override;
+
+ private:
+  friend class NumaBulkWriter;
+
+  struct Shard {
+    std::string db_path;
+    uint32_t node;
+    std::unique_ptr<KVInterface> kv;
+  };
+
+  // accesses of one thread by where the shard lives
+  struct alignas(64) AccessCount {
+    uint64_t local = 0;
+    uint64_t remote = 0;
+  };
+
+  // a transaction between Begin() and Commit()/Rollback()
+  struct Txn {
+    bool open = false;
+    std::vector<uint8_t> begun;  // per shard
+  };
+  // what NewTxnContext() hands out
+  struct TxnContext {
+    std::vector<void*> shard_contexts;
+    Txn txn;
+  };
+
+  // Shard of a key, counting the access; replicated rows are served by the
+  // shard of the calling thread's node
+  uint32_t Route(uint64_t key);
+  bool Replicated(uint64_t key) const;
+  uint32_t ShardOf(uint64_t key);
+  // transaction the calling thread acts on, its own or a switched-to one
+  Txn& CurrentTxn();
+  // begin txn on the shard unless it is not open or already began there;
+  // txn must be the shard's current transaction
+  int BeginShard(Txn& txn, uint32_t shard);
+  // end txn on the shards it began on
+  int EndTxn(Txn& txn, bool commit);
+
+  std::vector<Shard> shards_;
+  uint32_t num_warehouse_;
+  WarehouseOf warehouse_of_;
+  std::vector<uint32_t> node_shard_;  // shard read for replicated rows
+  std::unique_ptr<AccessCount[]> access_counts_;
+  std::unique_ptr<Txn[]> thread_txns_;          // by thread index
+  std::unique_ptr<TxnContext*[]> current_txn_;  // nullptr: the thread's own
+};
+
+}  // end of namespace TPCC
@@ -0,0 +1,151 @@
+//
+// op_latency.h
+//
+// Created by Zacharyliu-CS on 05/04/2024.
+// Copyright (c) 2024 liuzhenm@mail.ustc.edu.cn.
+//
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <sstream>
+#include <string>
+#include "config.h"
+#include "histogram.h"
+#include "record_stats.h"
+#include "utils.h"
+
+namespace TPCC {
+
+enum class RecordOp : uint8_t {
+  kGet = 0,
+  kGetForUpdate,
+  kPut,
+  kMerge,
+  kDelete,
+  kNumOps
+};
+
+inline const char* RecordOpName(RecordOp op) {
+  switch (op) {
+    case RecordOp::kGet:
+      return "get";
+    case RecordOp::kGetForUpdate:
+      return "get_for_update";
+    case RecordOp::kPut:
+      return "put";
+    case RecordOp::kMerge:
+      return "merge";
+    case RecordOp::kDelete:
+      return "delete";
+    default:
+      return "unknown";
+  }
+}
+
+// Latency of the kv calls behind the record operations, per table and op.
+// Only one call in sample_every is timed, with ReadTicks(), so that the
+// timer costs next to nothing; every thread fills histograms of its own,
+// allocated when it takes its first sample.
+class OpLatencySampler {
+ public:
+  // 0 times nothing. The tick rate is calibrated here, before any call
+  // is timed.
+  explicit OpLatencySampler(uint32_t sample_every)
+      : sample_every_(sample_every),
+        nanos_per_tick_(sample_every != 0 ? Utils::NanosPerTick() : 1),
+        countdowns_(new Countdown[Utils::kMaxThreads]),
+        threads_(new std::atomic<ThreadHistograms*>[Utils::kMaxThreads]) {
+    for (uint32_t i = 0; i < Utils::kMaxThreads; i++) {
+      threads_[i].store(nullptr, std::memory_order_relaxed);
+    }
+  }
+  ~OpLatencySampler() {
+    for (uint32_t i = 0; i < Utils::kMaxThreads; i++) {
+      delete threads_[i].load();
+    }
+  }
+
+  bool Enabled() const { return sample_every_ != 0; }
+
+  // Whether the calling thread times its next call
+  bool Sample() {
+    if (sample_every_ == 0) {
+      return false;
+    }
+    uint32_t& countdown = countdowns_[Utils::ThreadIndex()].left;
+    if (--countdown != 0) {
+      return false;
+    }
+    countdown = sample_every_;
+    return true;
+  }
+
+  // fn(), timed when the calling thread is due for a sample
+  template <typename Fn>
+  int Time(TPCCTableType table, RecordOp op, Fn&& fn) {
+    if (!Sample()) {
+      return fn();
+    }
+    uint64_t start = Utils::ReadTicks();
+    int ret = fn();
+    Record(table, op, Utils::ReadTicks() - start);
+    return ret;
+  }
+
+  void Record(TPCCTableType table, RecordOp op, uint64_t ticks) {
+    std::atomic<ThreadHistograms*>& slot = threads_[Utils::ThreadIndex()];
+    ThreadHistograms* mine = slot.load(std::memory_order_relaxed);
+    if (mine == nullptr) {
+      mine = new ThreadHistograms();
+      slot.store(mine, std::memory_order_release);
+    }
+    mine->ops[static_cast<size_t>(table)][static_cast<size_t>(op)].Add(
+        uint64_t(ticks * nanos_per_tick_));
+  }
+
+  // "stock.get: count=..; mean_us=..; ... | order_line.put: ..." over the
+  // samples taken; call it once the workers stopped
+  std::string Summary() const {
+    std::ostringstream out;
+    for (size_t table = 0; table < TPCC_TABLE_TYPES; table++) {
+      for (size_t op = 0; op < kOps; op++) {
+        LatencyHistogram merged;
+        for (uint32_t i = 0; i < Utils::kMaxThreads; i++) {
+          const ThreadHistograms* h = threads_[i].load(std::memory_order_acquire);
+          if (h != nullptr) {
+            merged.Merge(h->ops[table][op]);
+          }
+        }
+        if (merged.Count() == 0) {
+          continue;
+        }
+        if (out.tellp() > 0) {
+          out << " | ";
+        }
+        out << TableName(static_cast<TPCCTableType>(table)) << "."
+            << RecordOpName(static_cast<RecordOp>(op)) << ": "
+            << merged.Summary();
+      }
+    }
+    return out.str();
+  }
+
+ private:
+  static const size_t kOps = static_cast<size_t>(RecordOp::kNumOps);
+  struct ThreadHistograms {
+    std::array<std::array<LatencyHistogram, kOps>, TPCC_TABLE_TYPES> ops;
+  };
+  // calls of a thread left until its next sample, of this sampler only
+  struct alignas(64) Countdown {
+    uint32_t left = 1;
+  };
+
+  uint32_t sample_every_;
+  double nanos_per_tick_;
+  std::unique_ptr<Countdown[]> countdowns_;  // by thread index
+  std::unique_ptr<std::atomic<ThreadHistograms*>[]> threads_;
+};
+
+}  // end of namespace TPCC
@@ -0,0 +1,196 @@
+//
+// perf_counters.cc
+//
+// Created by Zacharyliu-CS on 05/11/2024.
+// Copyright (c) 2024 liuzhenm@mail.ustc.edu.cn.
+//
+#include "perf_counters.h"
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+
+namespace TPCC {
+
+namespace {
+
+struct EventConfig {
+  uint32_t type;
+  uint64_t config;
+};
+
+EventConfig ConfigOf(PerfEvent event) {
+  switch (event) {
+    case PerfEvent::kCycles:
+      return {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES};
+    case PerfEvent::kInstructions:
+      return {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS};
+    case PerfEvent::kLLCMisses:
+      return {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES};
+    case PerfEvent::kDTLBMisses:
+      return {PERF_TYPE_HW_CACHE,
+              PERF_COUNT_HW_CACHE_DTLB |
+                  (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                  (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)};
+    case PerfEvent::kBranchMisses:
+    default:
+      return {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES};
+  }
+}
+
+int OpenEvent(PerfEvent event, int group_fd) {
+  EventConfig config = ConfigOf(event);
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = config.type;
+  attr.config = config.config;
+  attr.disabled = group_fd < 0 ? 1 : 0;  // the leader switches the group
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                     PERF_FORMAT_TOTAL_TIME_RUNNING;
+  // this thread on whatever cpu it runs
+  return syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+
+}  // namespace
+
+const char* PerfEventName(PerfEvent event) {
+  switch (event) {
+    case PerfEvent::kCycles:
+      return "cycles";
+    case PerfEvent::kInstructions:
+      return "instructions";
+    case PerfEvent::kLLCMisses:
+      return "llc_misses";
+    case PerfEvent::kDTLBMisses:
+      return "dtlb_misses";
+    case PerfEvent::kBranchMisses:
+      return "branch_misses";
+    default:
+      return "unknown";
+  }
+}
+
+PerfCounts& PerfCounts::operator+=(const PerfCounts& other) {
+  if (available == 0) {
+    available = other.available;
+  }
+  for (size_t i = 0; i < kNumPerfEvents; i++) {
+    value[i] += other.value[i];
+  }
+  return *this;
+}
+
+PerfCounts PerfCounts::operator-(const PerfCounts& other) const {
+  PerfCounts diff = *this;
+  for (size_t i = 0; i < kNumPerfEvents; i++) {
+    // scaled counts may step back a little
+    diff.value[i] = value[i] > other.value[i] ? value[i] - other.value[i] : 0;
+  }
+  return diff;
+}
+
+std::string PerfCounts::Summary(uint64_t per) const {
+  std::ostringstream out;
+  double n = per > 0 ? per : 1;
+  for (size_t i = 0; i < kNumPerfEvents; i++) {
+    PerfEvent event = static_cast<PerfEvent>(i);
+    if (i > 0) {
+      out << "; ";
+    }
+    out << PerfEventName(event) << "=";
+    if (Has(event)) {
+      out << value[i] / n;
+    } else {
+      out << "n/a";
+    }
+    if (event == PerfEvent::kInstructions) {
+      out << "; ipc=";
+      if (Has(PerfEvent::kCycles) && Has(PerfEvent::kInstructions) &&
+          (*this)[PerfEvent::kCycles] > 0) {
+        out << double((*this)[PerfEvent::kInstructions]) /
+                   (*this)[PerfEvent::kCycles];
+      } else {
+        out << "n/a";
+      }
+    }
+  }
+  return out.str();
+}
+
+PerfCounters::~PerfCounters() {
+  for (int fd : fds_) {
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+}
+
+bool PerfCounters::Open(std::string* error) {
+  int first_errno = 0;
+  for (size_t i = 0; i < kNumPerfEvents; i++) {
+    int fd = OpenEvent(static_cast<PerfEvent>(i), leader_);
+    if (fd < 0) {
+      if (first_errno == 0) {
+        first_errno = errno;
+      }
+      continue;
+    }
+    if (leader_ < 0) {
+      leader_ = fd;
+    }
+    fds_[i] = fd;
+    available_ |= 1u << i;
+  }
+  if (leader_ < 0) {
+    *error = std::string("perf_event_open: ") + strerror(first_errno);
+    return false;
+  }
+  ioctl(leader_, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+  return true;
+}
+
+void PerfCounters::Enable() {
+  if (leader_ >= 0) {
+    ioctl(leader_, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+  }
+}
+
+void PerfCounters::Disable() {
+  if (leader_ >= 0) {
+    ioctl(leader_, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+  }
+}
+
+PerfCounts PerfCounters::Read() const {
+  PerfCounts counts;
+  if (leader_ < 0) {
+    return counts;
+  }
+  // nr, time_enabled, time_running, then one value per member in the
+  // order they joined the group
+  uint64_t buf[3 + kNumPerfEvents];
+  if (read(leader_, buf, sizeof(buf)) < ssize_t(3 * sizeof(uint64_t))) {
+    return counts;
+  }
+  double scale = 1;
+  if (buf[2] > 0 && buf[2] < buf[1]) {
+    scale = double(buf[1]) / buf[2];
+  }
+  uint64_t member = 0;
+  for (size_t i = 0; i < kNumPerfEvents && member < buf[0]; i++) {
+    if (fds_[i] >= 0) {
+      counts.value[i] = uint64_t(buf[3 + member] * scale);
+      member++;
+    }
+  }
+  counts.available = available_;
+  return counts;
+}
+
+}  // end of namespace TPCC
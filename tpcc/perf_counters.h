@@ -0,0 +1,73 @@
+//
+// perf_counters.h
+//
+// Created by Zacharyliu-CS on 05/11/2024.
+// Copyright (c) 2024 liuzhenm@mail.ustc.edu.cn.
+//
+#pragma once
+#include <array>
+#include <cstdint>
+#include <string>
+#include "config.h"
+
+namespace TPCC {
+
+// Hardware events counted per worker thread
+enum class PerfEvent : uint8_t {
+  kCycles = 0,
+  kInstructions,
+  kLLCMisses,
+  kDTLBMisses,
+  kBranchMisses,
+  kNumEvents
+};
+static const size_t kNumPerfEvents = static_cast<size_t>(PerfEvent::kNumEvents);
+
+const char* PerfEventName(PerfEvent event);
+
+// Event counts, with the events that could be counted
+struct PerfCounts {
+  std::array<uint64_t, kNumPerfEvents> value{};
+  uint32_t available = 0;  // bit i: event i was counted
+
+  bool Has(PerfEvent event) const {
+    return available & (1u << static_cast<size_t>(event));
+  }
+  uint64_t operator[](PerfEvent event) const {
+    return value[static_cast<size_t>(event)];
+  }
+  PerfCounts& operator+=(const PerfCounts& other);
+  PerfCounts operator-(const PerfCounts& other) const;
+
+  // "cycles=..; instructions=..; ipc=..; llc_misses=..; ..." divided by
+  // per, n/a for the events not counted
+  std::string Summary(uint64_t per) const;
+};
+
+// One perf_event_open group of the calling thread (user space only), read
+// as a whole. Counting starts disabled. When the kernel refuses the events
+// (no PMU in the VM, perf_event_paranoid, seccomp) the group stays closed
+// and every call is a no-op; events missing on this CPU are left out.
+class PerfCounters {
+ public:
+  PerfCounters() {}
+  ~PerfCounters();
+  PerfCounters(const PerfCounters&) = delete;
+  PerfCounters& operator=(const PerfCounters&) = delete;
+
+  // false when not a single event could be opened, error tells why
+  bool Open(std::string* error);
+  bool Opened() const { return leader_ >= 0; }
+
+  void Enable();
+  void Disable();
+  // Counts since Open(), scaled up when the PMU was multiplexed
+  PerfCounts Read() const;
+
+ private:
+  int leader_ = -1;
+  std::array<int, kNumPerfEvents> fds_{{-1, -1, -1, -1, -1}};
+  uint32_t available_ = 0;
+};
+
+}  // end of namespace TPCC
@@ -0,0 +1,206 @@
+//
+// phase.cc
+//
+// Created by Zacharyliu-CS on 05/18/2024.
+// Copyright (c) 2024 liuzhenm@mail.ustc.edu.cn.
+//
+#include "phase.h"
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include "stack_sampler.h"
+#include "utils.h"
+
+namespace TPCC {
+
+namespace {
+
+const int kPerfAckTimeoutMs = 2000;
+
+bool ParsePhase(const std::string& name, BenchPhase* phase) {
+  for (uint32_t i = 0; i < static_cast<uint32_t>(BenchPhase::kNone); i++) {
+    if (name == BenchPhaseName(static_cast<BenchPhase>(i))) {
+      *phase = static_cast<BenchPhase>(i);
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace
+
+std::string PhaseMemory::Summary(uint64_t txns) const {
+  std::ostringstream out;
+  out << "allocs=" << allocs.allocations
+      << "; bytes=" << allocs.bytes_allocated
+      << "; heap_growth=" << allocs.HeapGrowth();
+  if (txns > 0) {
+    out << "; allocs_per_txn=" << double(allocs.allocations) / txns
+        << "; bytes_per_txn=" << double(allocs.bytes_allocated) / txns;
+  }
+  out << "; rss=" << rss_bytes << "; peak_rss=" << peak_rss_bytes;
+  return out.str();
+}
+
+const char* BenchPhaseName(BenchPhase phase) {
+  switch (phase) {
+    case BenchPhase::kLoad:
+      return "load";
+    case BenchPhase::kWarmup:
+      return "warmup";
+    case BenchPhase::kMeasure:
+      return "measure";
+    case BenchPhase::kVerify:
+      return "verify";
+    default:
+      return "none";
+  }
+}
+
+PhaseControl::~PhaseControl() {
+  Finish();
+  if (perf_ctl_fd_ >= 0) {
+    close(perf_ctl_fd_);
+  }
+  if (perf_ack_fd_ >= 0) {
+    close(perf_ack_fd_);
+  }
+}
+
+bool PhaseControl::Init(const std::string& marker_fifo,
+                        const std::string& perf_control,
+                        const std::string& sample_prefix, uint32_t sample_hz,
+                        const std::string& profile_phases,
+                        std::string* error) {
+  std::stringstream phases(profile_phases);
+  std::string name;
+  while (std::getline(phases, name, ',')) {
+    BenchPhase phase;
+    if (name == "all") {
+      profiled_ = ~0u;
+    } else if (ParsePhase(name, &phase)) {
+      profiled_ |= 1u << static_cast<uint32_t>(phase);
+    } else if (!name.empty()) {
+      *error = "unknown phase " + name;
+      return false;
+    }
+  }
+
+  marker_fifo_ = marker_fifo;
+  struct stat st;
+  if (!marker_fifo_.empty() && stat(marker_fifo_.c_str(), &st) != 0 &&
+      mkfifo(marker_fifo_.c_str(), 0644) != 0) {
+    *error = "mkfifo " + marker_fifo_ + ": " + strerror(errno);
+    return false;
+  }
+
+  if (!perf_control.empty()) {
+    size_t comma = perf_control.find(',');
+    std::string ctl = perf_control.substr(0, comma);
+    // perf holds the control fifo open, without it the open fails
+    perf_ctl_fd_ = open(ctl.c_str(), O_WRONLY | O_NONBLOCK);
+    if (perf_ctl_fd_ < 0) {
+      *error = "open perf control " + ctl + ": " + strerror(errno);
+      return false;
+    }
+    if (comma != std::string::npos) {
+      std::string ack = perf_control.substr(comma + 1);
+      perf_ack_fd_ = open(ack.c_str(), O_RDONLY | O_NONBLOCK);
+      if (perf_ack_fd_ < 0) {
+        *error = "open perf ack " + ack + ": " + strerror(errno);
+        return false;
+      }
+    }
+  }
+
+  sample_prefix_ = sample_prefix;
+  if (!sample_prefix_.empty() &&
+      !StackSampler::Get().Init(sample_hz, error)) {
+    return false;
+  }
+  return true;
+}
+
+void PhaseControl::Enter(BenchPhase phase) {
+  if (phase == current_) {
+    return;
+  }
+  if (current_ != BenchPhase::kNone) {
+    if (Profiled(current_)) {
+      if (!sample_prefix_.empty()) {
+        StackSampler::Get().Stop();
+        std::string path =
+            sample_prefix_ + "." + BenchPhaseName(current_) + ".folded";
+        if (!StackSampler::Get().WriteFolded(path)) {
+          printf("write folded stacks %s failed\n", path.c_str());
+        }
+      }
+      PerfCommand("disable");
+    }
+    Mark(current_, "end");
+    PhaseMemory& memory = memory_[static_cast<uint32_t>(current_)];
+    AllocCounts allocs = ReadAllocCounts();
+    allocs -= phase_start_allocs_;
+    memory.entered = true;
+    memory.allocs += allocs;
+    ReadResidentSet(&memory.rss_bytes, &memory.peak_rss_bytes);
+  }
+  current_ = phase;
+  if (current_ != BenchPhase::kNone) {
+    phase_start_allocs_ = ReadAllocCounts();
+    Mark(current_, "begin");
+    if (Profiled(current_)) {
+      PerfCommand("enable");
+      if (!sample_prefix_.empty()) {
+        StackSampler::Get().Start();
+      }
+    }
+  }
+}
+
+void PhaseControl::Mark(BenchPhase phase, const char* what) {
+  if (marker_fifo_.empty()) {
+    return;
+  }
+  // a fifo nobody reads fails with ENXIO, the marker is dropped then
+  int fd = open(marker_fifo_.c_str(), O_WRONLY | O_NONBLOCK | O_APPEND);
+  if (fd < 0) {
+    return;
+  }
+  std::ostringstream line;
+  line << BenchPhaseName(phase) << " " << what << " " << Utils::NowNanos()
+       << "\n";
+  std::string text = line.str();
+  if (write(fd, text.data(), text.size()) < 0) {
+    // the reader went away
+  }
+  close(fd);
+}
+
+void PhaseControl::PerfCommand(const char* command) {
+  if (perf_ctl_fd_ < 0) {
+    return;
+  }
+  std::string text = std::string(command) + "\n";
+  if (write(perf_ctl_fd_, text.data(), text.size()) < 0) {
+    printf("perf control %s failed: %s\n", command, strerror(errno));
+    return;
+  }
+  if (perf_ack_fd_ < 0) {
+    return;
+  }
+  // perf answers "ack\n" once the events are switched
+  struct pollfd pfd = {perf_ack_fd_, POLLIN, 0};
+  char ack[16];
+  if (poll(&pfd, 1, kPerfAckTimeoutMs) <= 0 ||
+      read(perf_ack_fd_, ack, sizeof(ack)) <= 0) {
+    printf("perf control %s: no ack\n", command);
+  }
+}
+
+}  // end of namespace TPCC
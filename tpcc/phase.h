@@ -0,0 +1,87 @@
+//
+// phase.h
+//
+// Created by Zacharyliu-CS on 05/18/2024.
+// Copyright (c) 2024 liuzhenm@mail.ustc.edu.cn.
+//
+#pragma once
+#include <cstdint>
+#include <string>
+#include "alloc_counter.h"
+
+namespace TPCC {
+
+enum class BenchPhase : uint8_t {
+  kLoad = 0,
+  kWarmup,
+  kMeasure,
+  kVerify,
+  kNone,
+};
+
+const char* BenchPhaseName(BenchPhase phase);
+
+// Memory of one phase: the heap allocations made during it and the
+// resident set when it ended.
+struct PhaseMemory {
+  bool entered = false;
+  AllocCounts allocs;
+  uint64_t rss_bytes = 0;
+  uint64_t peak_rss_bytes = 0;  // of the process so far
+
+  // "allocs=..; bytes=..; heap_growth=..; rss=..; peak_rss=..", per
+  // transaction too when txns > 0
+  std::string Summary(uint64_t txns) const;
+};
+
+// Tells the outside which phase of the run the driver is in and profiles
+// the phases asked for:
+//   - marker fifo: "<phase> begin|end <monotonic ns>" lines, for a script
+//     waiting on the phases; nothing is written while nobody reads it
+//   - perf control: "enable" / "disable" to the control fifo of
+//     perf record --control fifo:ctl,ack --delay=-1, waiting for the ack
+//   - in-process sampler: folded stacks of each profiled phase in
+//     <prefix>.<phase>.folded
+// and counts the memory every phase took, profiled or not.
+class PhaseControl {
+ public:
+  PhaseControl() {}
+  ~PhaseControl();
+  PhaseControl(const PhaseControl&) = delete;
+  PhaseControl& operator=(const PhaseControl&) = delete;
+
+  // Empty arguments turn a part off. perf_control is "ctl[,ack]",
+  // profile_phases a comma separated list of phase names or "all".
+  bool Init(const std::string& marker_fifo, const std::string& perf_control,
+            const std::string& sample_prefix, uint32_t sample_hz,
+            const std::string& profile_phases, std::string* error);
+
+  // Ends the current phase and begins phase
+  void Enter(BenchPhase phase);
+  // Ends the current phase
+  void Finish() { Enter(BenchPhase::kNone); }
+  BenchPhase Current() const { return current_; }
+  // Of a phase that ended
+  const PhaseMemory& Memory(BenchPhase phase) const {
+    return memory_[static_cast<uint32_t>(phase)];
+  }
+
+ private:
+  bool Profiled(BenchPhase phase) const {
+    return phase != BenchPhase::kNone &&
+           (profiled_ & (1u << static_cast<uint32_t>(phase)));
+  }
+  void Mark(BenchPhase phase, const char* what);
+  void PerfCommand(const char* command);
+
+  std::string marker_fifo_;
+  int perf_ctl_fd_ = -1;
+  int perf_ack_fd_ = -1;
+  std::string sample_prefix_;
+  uint32_t profiled_ = 0;  // bit per BenchPhase
+  BenchPhase current_ = BenchPhase::kNone;
+  AllocCounts phase_start_allocs_;
+  PhaseMemory memory_[static_cast<uint32_t>(BenchPhase::kNone)];
+};
+
+}  // end of namespace TPCC
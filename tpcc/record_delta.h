@@ -0,0 +1,126 @@
+//
+// record_delta.h
+//
+// Created by Zacharyliu-CS on 06/08/2024.
+// Copyright (c) 2024 liuzhenm@mail.ustc.edu.cn.
+//
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include "txn_arena.h"
+
+// Field-level change of a fixed-layout record, the operand of
+// KVInterface::Merge(). A delta is a list of ops applied in order, each to
+// the bytes at an offset of the stored value:
+//   kind (1 byte) | offset (2) | size (2) | size bytes of argument
+// Two deltas of the same record concatenated are a delta doing both.
+// The encoding is built in a buffer of the thread's TxnArena.
+class RecordDelta {
+ public:
+  enum Kind : uint8_t { kSet = 0, kAddInt32, kAddFloat };
+  static const size_t kOpHeaderSize = 5;
+
+  RecordDelta() : encoded_(TPCC::TxnArena::ThreadArena().TakeBuffer()) {}
+  RecordDelta(RecordDelta&&) = default;
+  ~RecordDelta() {
+    TPCC::TxnArena::ThreadArena().ReturnBuffer(std::move(encoded_));
+  }
+
+  // Overwrite size bytes at offset
+  RecordDelta& Set(size_t offset, const void* data, size_t size) {
+    Append(kSet, offset, data, size);
+    return *this;
+  }
+  RecordDelta& AddInt32(size_t offset, int32_t v) {
+    Append(kAddInt32, offset, &v, sizeof(v));
+    return *this;
+  }
+  RecordDelta& AddFloat(size_t offset, float v) {
+    Append(kAddFloat, offset, &v, sizeof(v));
+    return *this;
+  }
+
+  const std::string& Encoded() const { return encoded_; }
+  bool Empty() const { return encoded_.empty(); }
+
+  // Apply an encoded delta to value. Nothing is changed and false returned
+  // when an op is malformed or reaches past the end of value.
+  static bool Apply(const char* delta, size_t n, std::string* value) {
+    if (!Valid(delta, n, value->size())) {
+      return false;
+    }
+    char* record = value->data();
+    for (size_t pos = 0; pos < n;) {
+      uint8_t kind;
+      uint16_t offset, size;
+      Header(delta + pos, &kind, &offset, &size);
+      const char* arg = delta + pos + kOpHeaderSize;
+      switch (kind) {
+        case kAddInt32: {
+          int32_t field, v;
+          memcpy(&field, record + offset, sizeof(field));
+          memcpy(&v, arg, sizeof(v));
+          field += v;
+          memcpy(record + offset, &field, sizeof(field));
+          break;
+        }
+        case kAddFloat: {
+          float field, v;
+          memcpy(&field, record + offset, sizeof(field));
+          memcpy(&v, arg, sizeof(v));
+          field += v;
+          memcpy(record + offset, &field, sizeof(field));
+          break;
+        }
+        default:
+          memcpy(record + offset, arg, size);
+      }
+      pos += kOpHeaderSize + size;
+    }
+    return true;
+  }
+
+  static bool Apply(const std::string& delta, std::string* value) {
+    return Apply(delta.data(), delta.size(), value);
+  }
+
+ private:
+  void Append(Kind kind, size_t offset, const void* data, size_t size) {
+    char header[kOpHeaderSize];
+    uint16_t offset16 = uint16_t(offset), size16 = uint16_t(size);
+    header[0] = char(kind);
+    memcpy(header + 1, &offset16, sizeof(offset16));
+    memcpy(header + 3, &size16, sizeof(size16));
+    encoded_.append(header, kOpHeaderSize);
+    encoded_.append(static_cast<const char*>(data), size);
+  }
+
+  static void Header(const char* op, uint8_t* kind, uint16_t* offset,
+                     uint16_t* size) {
+    *kind = uint8_t(op[0]);
+    memcpy(offset, op + 1, sizeof(*offset));
+    memcpy(size, op + 3, sizeof(*size));
+  }
+
+  static bool Valid(const char* delta, size_t n, size_t value_size) {
+    for (size_t pos = 0; pos < n;) {
+      if (n - pos < kOpHeaderSize) {
+        return false;
+      }
+      uint8_t kind;
+      uint16_t offset, size;
+      Header(delta + pos, &kind, &offset, &size);
+      if (kind > kAddFloat || (kind != kSet && size != 4) ||
+          n - pos - kOpHeaderSize < size ||
+          size_t(offset) + size > value_size) {
+        return false;
+      }
+      pos += kOpHeaderSize + size;
+    }
+    return true;
+  }
+
+  std::string encoded_;
+};
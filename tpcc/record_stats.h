@@ -0,0 +1,152 @@
+//
+// record_stats.h
+//
+// Created by Zacharyliu-CS on 04/27/2024.
+// Copyright (c) 2024 liuzhenm@mail.ustc.edu.cn.
+//
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <sstream>
+#include <string>
+#include "config.h"
+#include "utils.h"
+
+namespace TPCC {
+
+inline const char* TableName(TPCCTableType table) {
+  static const char* const kNames[TPCC_TABLE_TYPES] = {
+      "warehouse", "district", "customer", "history",
+      "new_order", "order",    "order_line", "item",
+      "stock",     "customer_index", "order_index",
+      "customer_hot", "customer_cold", "stock_hot", "stock_cold"};
+  size_t i = static_cast<size_t>(table);
+  return i < TPCC_TABLE_TYPES && kNames[i] != nullptr ? kNames[i] : "unknown";
+}
+
+// Record operations on one table
+struct RecordCounts {
+  uint64_t gets = 0;
+  uint64_t misses = 0;  // gets that found nothing
+  uint64_t puts = 0;
+  uint64_t merges = 0;  // partial updates, see KVInterface::Merge()
+  uint64_t deletes = 0;
+  uint64_t loads = 0;
+  uint64_t bytes_read = 0;
+  uint64_t bytes_written = 0;
+
+  RecordCounts& operator-=(const RecordCounts& other) {
+    gets -= other.gets;
+    misses -= other.misses;
+    puts -= other.puts;
+    merges -= other.merges;
+    deletes -= other.deletes;
+    loads -= other.loads;
+    bytes_read -= other.bytes_read;
+    bytes_written -= other.bytes_written;
+    return *this;
+  }
+};
+
+using TableRecordCounts = std::array<RecordCounts, TPCC_TABLE_TYPES>;
+
+// Record counters of TPCCTable. Every thread counts into its own cache
+// lines, only the owner writes them (a relaxed load and store, no locked
+// instruction) and a reader sums up all threads.
+class RecordStats {
+ public:
+  RecordStats() : threads_(new ThreadCounts[Utils::kMaxThreads]) {}
+
+  void Get(TPCCTableType table, bool hit, uint64_t bytes) {
+    Counters& c = Mine(table);
+    Add(c.gets, 1);
+    Add(hit ? c.bytes_read : c.misses, hit ? bytes : 1);
+  }
+  void Put(TPCCTableType table, uint64_t bytes) {
+    Counters& c = Mine(table);
+    Add(c.puts, 1);
+    Add(c.bytes_written, bytes);
+  }
+  void Merge(TPCCTableType table, uint64_t bytes) {
+    Counters& c = Mine(table);
+    Add(c.merges, 1);
+    Add(c.bytes_written, bytes);
+  }
+  void Delete(TPCCTableType table) { Add(Mine(table).deletes, 1); }
+  void Load(TPCCTableType table, uint64_t bytes) {
+    Counters& c = Mine(table);
+    Add(c.loads, 1);
+    Add(c.bytes_written, bytes);
+  }
+
+  // Sum over all threads, consistent per counter only while threads count
+  TableRecordCounts Collect() const {
+    TableRecordCounts total{};
+    for (uint32_t t = 0; t < Utils::kMaxThreads; t++) {
+      for (size_t i = 0; i < TPCC_TABLE_TYPES; i++) {
+        const Counters& c = threads_[t].tables[i];
+        RecordCounts& sum = total[i];
+        sum.gets += c.gets.load(std::memory_order_relaxed);
+        sum.misses += c.misses.load(std::memory_order_relaxed);
+        sum.puts += c.puts.load(std::memory_order_relaxed);
+        sum.merges += c.merges.load(std::memory_order_relaxed);
+        sum.deletes += c.deletes.load(std::memory_order_relaxed);
+        sum.loads += c.loads.load(std::memory_order_relaxed);
+        sum.bytes_read += c.bytes_read.load(std::memory_order_relaxed);
+        sum.bytes_written += c.bytes_written.load(std::memory_order_relaxed);
+      }
+    }
+    return total;
+  }
+
+  // "customer: gets=..; misses=..; ... | stock: ..." over the tables that
+  // were touched
+  static std::string Summary(const TableRecordCounts& counts) {
+    std::ostringstream out;
+    for (size_t i = 0; i < TPCC_TABLE_TYPES; i++) {
+      const RecordCounts& c = counts[i];
+      if (c.gets + c.puts + c.merges + c.deletes + c.loads == 0) {
+        continue;
+      }
+      if (out.tellp() > 0) {
+        out << " | ";
+      }
+      out << TableName(static_cast<TPCCTableType>(i)) << ": gets=" << c.gets
+          << "; misses=" << c.misses << "; puts=" << c.puts
+          << "; merges=" << c.merges << "; deletes=" << c.deletes
+          << "; loads=" << c.loads << "; bytes_read=" << c.bytes_read
+          << "; bytes_written=" << c.bytes_written;
+    }
+    return out.str();
+  }
+
+ private:
+  struct Counters {
+    std::atomic<uint64_t> gets{0};
+    std::atomic<uint64_t> misses{0};
+    std::atomic<uint64_t> puts{0};
+    std::atomic<uint64_t> merges{0};
+    std::atomic<uint64_t> deletes{0};
+    std::atomic<uint64_t> loads{0};
+    std::atomic<uint64_t> bytes_read{0};
+    std::atomic<uint64_t> bytes_written{0};
+  };
+  struct alignas(64) ThreadCounts {
+    std::array<Counters, TPCC_TABLE_TYPES> tables;
+  };
+
+  Counters& Mine(TPCCTableType table) {
+    return threads_[Utils::ThreadIndex()]
+        .tables[static_cast<size_t>(table)];
+  }
+  static void Add(std::atomic<uint64_t>& counter, uint64_t n) {
+    counter.store(counter.load(std::memory_order_relaxed) + n,
+                  std::memory_order_relaxed);
+  }
+
+  std::unique_ptr<ThreadCounts[]> threads_;
+};
+
+}  // end of namespace TPCC
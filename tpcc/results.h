@@ -0,0 +1,50 @@
+//
+// results.h
+//
+// Created by Zacharyliu-CS on 03/02/2024.
+// Copyright (c) 2024 liuzhenm@mail.ustc.edu.cn.
+//
+#pragma once
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace TPCC {
+
+// Ordered "key = value" summary of one run. Every run appends one block to
+// the results file so that numbers and the settings that produced them stay
+// together.
+class RunResults {
+ public:
+  template <typename T>
+  void Add(const std::string& key, const T& value) {
+    std::ostringstream out;
+    out << value;
+    items_.emplace_back(key, out.str());
+  }
+
+  void Dump(std::ostream& out) const {
+    out << "---- tpcc run " << std::time(nullptr) << " ----" << std::endl;
+    for (auto& item : items_) {
+      out << item.first << " = " << item.second << std::endl;
+    }
+  }
+
+  bool AppendToFile(const std::string& path) const {
+    std::ofstream out(path, std::ios::app);
+    if (!out.is_open()) {
+      return false;
+    }
+    Dump(out);
+    return out.good();
+  }
+
+ private:
+  std::vector<std::pair<std::string, std::string>> items_;
+};
+
+}  // end of namespace TPCC
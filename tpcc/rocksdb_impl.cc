@@ -7,75 +7,762 @@
 
 #include "rocksdb_impl.h"
 #include <rocksdb/status.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <chrono>
+#include <sstream>
 #include <string>
 #include <valarray>
+#include <vector>
 #include "rocksdb/cache.h"
+#include "rocksdb/convenience.h"
 #include "rocksdb/filter_policy.h"
 #include "rocksdb/iterator.h"
+#include "rocksdb/merge_operator.h"
+#include "rocksdb/sst_file_writer.h"
 #include "rocksdb/statistics.h"
 #include "rocksdb/table.h"
+#include "rocksdb/utilities/options_util.h"
+#include "rocksdb/write_batch.h"
 #include "logging.h"
 
 using namespace TPCC;
 
-RocksDBImpl::RocksDBImpl(std::string dbpath) {
+namespace {
+
+// Named configurations selectable by --ROCKSDB_PROFILE. "pmem-kvsep" is the
+// configuration the benchmark has always been run with.
+struct RocksDBProfile {
+  const char* name;
+  bool on_dcpmm;         // DCPMM env, mmap reads/writes on pmem
+  bool kvs_enable;       // dcpmm kv separation
+  uint64_t kvs_value_thres;
+  uint64_t kvs_file_size;
+  size_t write_buffer_size;
+  int max_write_buffer_number;
+  uint64_t target_file_size_base;
+  int level0_file_num_compaction_trigger;
+  int max_background_compactions;
+  size_t block_cache_size;
+  int bloom_bits;
+  bool cache_index_and_filter_blocks;
+};
+
+const uint64_t kGB = uint64_t(1024 * 1024 * 1024);
+
+// A thread counts as a group committer while it joined one of the last
+// this many groups; one that exited or stopped committing drops out after.
+const uint64_t kActiveGroups = 4;
+
+// Big-endian, so that the bytewise order of the keys is their numeric order
+// and every table (top byte) is one contiguous key range.
+inline std::string EncodeKey(uint64_t key) {
+  std::string buf(sizeof(key), 0);
+  for (int i = sizeof(key) - 1; i >= 0; i--) {
+    buf[i] = char(key & 0xff);
+    key >>= 8;
+  }
+  return buf;
+}
+
+const RocksDBProfile kProfiles[] = {
+    // name, dcpmm, kvsep, thres, kvs size, wbuf, #wbuf, sst, l0, bg, cache,
+    // bloom, cache idx/filter
+    {"pmem-kvsep", true, true, 64, 16 * kGB, 64 << 20, 2, 16 << 20, 4, 8,
+     500 << 20, 10, false},
+    {"pmem-no-kvsep", true, false, 0, 0, 64 << 20, 2, 16 << 20, 4, 8,
+     500 << 20, 10, false},
+    {"dram-baseline", false, false, 0, 0, 64 << 20, 2, 16 << 20, 4, 8,
+     500 << 20, 10, false},
+    {"write-optimized", true, true, 64, 16 * kGB, 256 << 20, 4, 64 << 20, 8,
+     16, 500 << 20, 10, false},
+    {"read-optimized", true, true, 64, 16 * kGB, 64 << 20, 2, 16 << 20, 4, 8,
+     size_t(4) * kGB, 16, true},
+};
+
+// Copies the records of one transaction batch into the group batch
+class BatchAppender : public rocksdb::WriteBatch::Handler {
+ public:
+  explicit BatchAppender(rocksdb::WriteBatch* dst) : dst_(dst) {}
+  rocksdb::Status PutCF(uint32_t column_family_id, const rocksdb::Slice& key,
+                        const rocksdb::Slice& value) override {
+    return dst_->Put(key, value);
+  }
+  rocksdb::Status DeleteCF(uint32_t column_family_id,
+                           const rocksdb::Slice& key) override {
+    return dst_->Delete(key);
+  }
+  rocksdb::Status MergeCF(uint32_t column_family_id, const rocksdb::Slice& key,
+                          const rocksdb::Slice& value) override {
+    return dst_->Merge(key, value);
+  }
+
+ private:
+  rocksdb::WriteBatch* dst_;
+};
+
+// Applies the RecordDelta operands of KVInterface::Merge() to the stored
+// record. The deltas of one key stack up by concatenation.
+class RecordDeltaMergeOperator : public rocksdb::MergeOperator {
+ public:
+  bool FullMergeV2(const MergeOperationInput& merge_in,
+                   MergeOperationOutput* merge_out) const override {
+    if (merge_in.existing_value == nullptr) {
+      return false;  // a delta without its record
+    }
+    merge_out->new_value.assign(merge_in.existing_value->data(),
+                                merge_in.existing_value->size());
+    for (const rocksdb::Slice& operand : merge_in.operand_list) {
+      if (!RecordDelta::Apply(operand.data(), operand.size(),
+                              &merge_out->new_value)) {
+        return false;
+      }
+    }
+    return true;
+  }
+  bool PartialMerge(const rocksdb::Slice& key,
+                    const rocksdb::Slice& left_operand,
+                    const rocksdb::Slice& right_operand,
+                    std::string* new_value,
+                    rocksdb::Logger* logger) const override {
+    new_value->assign(left_operand.data(), left_operand.size());
+    new_value->append(right_operand.data(), right_operand.size());
+    return true;
+  }
+  const char* Name() const override { return "TPCCRecordDelta"; }
+};
+
+}  // namespace
+
+// One SST file, ingested by Finish(). Unsorted runs are buffered and sorted
+// first because SstFileWriter only accepts increasing keys.
+class RocksDBBulkWriter : public KVBulkWriter {
+ public:
+  RocksDBBulkWriter(RocksDBImpl* db, bool sorted)
+      : db_(db),
+        sorted_(sorted),
+        writer_(rocksdb::EnvOptions(), db->options) {
+    path_ = db_->bulk_dir_ + "/" +
+            std::to_string(db_->bulk_file_number_.fetch_add(1)) + ".sst";
+  }
+
+  int Add(uint64_t key, const std::string& value) override {
+    if (!sorted_) {
+      buffer_.emplace_back(key, value);
+      return 1;
+    }
+    return Write(key, value) ? 1 : -1;
+  }
+
+  int Finish() override {
+    if (!sorted_) {
+      // stable, a later record of the same key wins like a later Put
+      std::stable_sort(buffer_.begin(), buffer_.end(),
+                       [](const std::pair<uint64_t, std::string>& a,
+                          const std::pair<uint64_t, std::string>& b) {
+                         return a.first < b.first;
+                       });
+      for (size_t i = 0; i < buffer_.size(); i++) {
+        if (i + 1 < buffer_.size() && buffer_[i].first == buffer_[i + 1].first) {
+          continue;
+        }
+        if (!Write(buffer_[i].first, buffer_[i].second)) {
+          return -1;
+        }
+      }
+      buffer_.clear();
+    }
+    if (!opened_) {
+      return 1;  // nothing was added
+    }
+    rocksdb::Status s = writer_.Finish();
+    if (s.ok()) {
+      rocksdb::IngestExternalFileOptions ingest_options;
+      ingest_options.move_files = true;
+      s = db_->db_->IngestExternalFile({path_}, ingest_options);
+    }
+    if (!s.ok()) {
+      LOG("ingest ", path_, " failed: ", s.ToString());
+      return -1;
+    }
+    db_->bulk_files_ingested_++;
+    return 1;
+  }
+
+ private:
+  bool Write(uint64_t key, const std::string& value) {
+    if (!opened_) {
+      if (!writer_.Open(path_).ok()) {
+        LOG("open sst file ", path_, " failed");
+        return false;
+      }
+      opened_ = true;
+    } else if (key <= last_key_) {
+      // a duplicate in a sorted run is an error of the caller
+      return false;
+    }
+    last_key_ = key;
+    return writer_.Put(EncodeKey(key), value).ok();
+  }
+
+  RocksDBImpl* db_;
+  bool sorted_;
+  bool opened_ = false;
+  uint64_t last_key_ = 0;
+  std::string path_;
+  rocksdb::SstFileWriter writer_;
+  std::vector<std::pair<uint64_t, std::string>> buffer_;
+};
+
+RocksDBImpl::RocksDBImpl(std::string dbpath, std::string profile,
+                         std::string options_file, std::string txn_mode,
+                         std::string durability,
+                         uint32_t group_commit_window_us)
+    : txn_slots_(new TxnSlot[Utils::kMaxThreads]),
+      attached_(new TxnSlot*[Utils::kMaxThreads]()),
+      group_commit_window_us_(group_commit_window_us),
+      profile_(profile),
+      options_file_(options_file),
+      txn_mode_name_(txn_mode),
+      durability_name_(durability) {
+  if (txn_mode == "pessimistic") {
+    txn_mode_ = TxnMode::kPessimistic;
+  } else if (txn_mode == "optimistic") {
+    txn_mode_ = TxnMode::kOptimistic;
+  } else if (txn_mode != "none") {
+    LOG("unknown rocksdb txn mode: ", txn_mode);
+    abort();
+  }
+  ApplyDurability(durability);
+
+  // setup the pmem configuration
+  std::string pmem_rocksdb_path = dbpath;
+
+  LOG("pm rocksdb path: ", pmem_rocksdb_path, ", profile: ", profile);
+  ApplyProfile(profile, pmem_rocksdb_path);
+  if (!options_file.empty()) {
+    ApplyOptionsFile(options_file);
+  }
+
+  rocksdb::Status s;
+  switch (txn_mode_) {
+    case TxnMode::kPessimistic:
+      s = rocksdb::TransactionDB::Open(options,
+                                       rocksdb::TransactionDBOptions(),
+                                       pmem_rocksdb_path, &txn_db_);
+      db_ = txn_db_;
+      break;
+    case TxnMode::kOptimistic:
+      s = rocksdb::OptimisticTransactionDB::Open(options, pmem_rocksdb_path,
+                                                 &optimistic_txn_db_);
+      db_ = s.ok() ? optimistic_txn_db_->GetBaseDB() : nullptr;
+      break;
+    default:
+      s = rocksdb::DB::Open(options, pmem_rocksdb_path, &db_);
+  }
+  if (!s.ok()) {
+    LOG("init rocksdb failed!");
+    abort();
+  }
+  bulk_dir_ = pmem_rocksdb_path + "/bulk";
+  if (durability_ == Durability::kGroupCommit &&
+      txn_mode_ == TxnMode::kNone) {
+    group_committer_ = std::thread(&RocksDBImpl::GroupCommitLoop, this);
+  }
+}
+
+RocksDBImpl::~RocksDBImpl() {
+  if (group_committer_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(group_mutex_);
+      group_stop_ = true;
+    }
+    group_cv_.notify_one();
+    group_committer_.join();
+  }
+  for (uint32_t i = 0; i < Utils::kMaxThreads; i++) {
+    delete txn_slots_[i].txn;
+    delete txn_slots_[i].batch;
+  }
+  // close the store so that the next run can reopen it
+  if (txn_db_ != nullptr) {
+    delete txn_db_;
+  } else if (optimistic_txn_db_ != nullptr) {
+    delete optimistic_txn_db_;  // owns the base db
+  } else {
+    delete db_;
+  }
+}
+
+void RocksDBImpl::ApplyDurability(const std::string& durability) {
+  if (durability == "none") {
+    durability_ = Durability::kNone;
+  } else if (durability == "wal-async") {
+    durability_ = Durability::kWalAsync;
+  } else if (durability == "wal-sync-per-txn") {
+    durability_ = Durability::kWalSyncPerTxn;
+  } else if (durability == "group-commit") {
+    durability_ = Durability::kGroupCommit;
+  } else {
+    LOG("unknown rocksdb durability: ", durability);
+    abort();
+  }
+
+  // Loading and single puts never wait for the disk; only transaction
+  // commits pay for the sync.
+  write_options_.disableWAL = durability_ == Durability::kNone;
+  write_options_.sync = false;
+  commit_options_ = write_options_;
+  // The engine transactions have no hook for our own committer, a synced
+  // commit there is grouped by the rocksdb write thread instead.
+  commit_options_.sync = durability_ == Durability::kWalSyncPerTxn ||
+                         durability_ == Durability::kGroupCommit;
+}
+
+rocksdb::Status RocksDBImpl::GroupCommit(rocksdb::WriteBatch* batch) {
+  CommitRequest request;
+  request.batch = batch;
+  std::unique_lock<std::mutex> lock(group_mutex_);
+  group_joined_[Utils::ThreadIndex()] = group_seq_;
+  group_queue_.push_back(&request);
+  group_cv_.notify_one();
+  group_done_cv_.wait(lock, [&request] { return request.done; });
+  return request.status;
+}
+
+void RocksDBImpl::GroupCommitLoop() {
+  std::vector<CommitRequest*> group;
+  rocksdb::WriteBatch group_batch;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(group_mutex_);
+      group_cv_.wait(lock,
+                     [this] { return group_stop_ || !group_queue_.empty(); });
+      if (group_queue_.empty()) {
+        return;  // stopped and drained
+      }
+      if (group_commit_window_us_ > 0) {
+        // give the other workers the whole window to join this group; it
+        // closes early once every thread that commits is waiting in it
+        size_t committers = 0;
+        for (uint32_t i = 0; i < Utils::kMaxThreads; i++) {
+          committers += group_joined_[i] != 0 &&
+                        group_joined_[i] + kActiveGroups > group_seq_;
+        }
+        auto deadline = std::chrono::steady_clock::now() +
+                        std::chrono::microseconds(group_commit_window_us_);
+        group_cv_.wait_until(lock, deadline, [this, committers] {
+          return group_stop_ || group_queue_.size() >= committers;
+        });
+      }
+      group.swap(group_queue_);
+      group_seq_++;
+    }
+
+    group_batch.Clear();
+    BatchAppender appender(&group_batch);
+    rocksdb::Status s;
+    for (auto request : group) {
+      s = request->batch->Iterate(&appender);
+      if (!s.ok()) {
+        break;
+      }
+    }
+    if (s.ok()) {
+      s = db_->Write(commit_options_, &group_batch);
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(group_mutex_);
+      group_writes_++;
+      group_txns_ += group.size();
+      for (auto request : group) {
+        request->status = s;
+        request->done = true;
+      }
+    }
+    group_done_cv_.notify_all();
+    group.clear();
+  }
+}
+
+void RocksDBImpl::ApplyProfile(const std::string& profile,
+                               const std::string& dbpath) {
+  const RocksDBProfile* p = nullptr;
+  for (auto& candidate : kProfiles) {
+    if (profile == candidate.name) {
+      p = &candidate;
+      break;
+    }
+  }
+  if (p == nullptr) {
+    LOG("unknown rocksdb profile: ", profile);
+    abort();
+  }
 
   options.create_if_missing = true;
   options.use_direct_reads = false;
   options.use_direct_io_for_flush_and_compaction = false;
   options.disable_auto_compactions = false;
-  options.max_background_compactions = 8;
+  options.max_background_compactions = p->max_background_compactions;
   options.max_background_jobs = options.max_background_compactions + 4;
-  options.write_buffer_size = 64 << 20;
-  options.target_file_size_base = 16 << 20;
+  options.write_buffer_size = p->write_buffer_size;
+  options.max_write_buffer_number = p->max_write_buffer_number;
+  options.target_file_size_base = p->target_file_size_base;
+  options.level0_file_num_compaction_trigger =
+      p->level0_file_num_compaction_trigger;
 
-  // setup the pmem configuration
-  std::string pmem_rocksdb_path = dbpath;
-
-  LOG("pm rocksdb path: ", pmem_rocksdb_path);
-  // configure for pmem kv sepeartion
-  options.wal_dir = pmem_rocksdb_path + "/wal";
-  options.dcpmm_kvs_enable = true;
-  options.dcpmm_kvs_mmapped_file_fullpath = pmem_rocksdb_path + "/kvs";
-  options.dcpmm_kvs_mmapped_file_size = 16*uint64_t(1024*1024*1024);
-  options.dcpmm_kvs_value_thres = 64;  // minimal size to do kv sep
-  options.dcpmm_compress_value = false;
-  options.allow_mmap_reads = true;
-  options.allow_mmap_writes = true;
-  options.allow_dcpmm_writes = true;
+  if (p->on_dcpmm) {
+    // configure for pmem kv sepeartion
+    options.wal_dir = dbpath + "/wal";
+    options.dcpmm_kvs_enable = p->kvs_enable;
+    if (p->kvs_enable) {
+      options.dcpmm_kvs_mmapped_file_fullpath = dbpath + "/kvs";
+      options.dcpmm_kvs_mmapped_file_size = p->kvs_file_size;
+      options.dcpmm_kvs_value_thres = p->kvs_value_thres;  // minimal size to do kv sep
+    }
+    options.dcpmm_compress_value = false;
+    options.allow_mmap_reads = true;
+    options.allow_mmap_writes = true;
+    options.allow_dcpmm_writes = true;
+    options.env = rocksdb::NewDCPMMEnv(rocksdb::DCPMMEnvOptions());
+  }
 
   rocksdb::BlockBasedTableOptions block_options;
   block_options.filter_policy.reset(
-      rocksdb::NewBloomFilterPolicy(10));
-  block_options.block_cache = rocksdb::NewLRUCache(500<<20);
+      rocksdb::NewBloomFilterPolicy(p->bloom_bits));
+  block_cache_ = rocksdb::NewLRUCache(p->block_cache_size);
+  block_options.block_cache = block_cache_;
+  block_options.cache_index_and_filter_blocks =
+      p->cache_index_and_filter_blocks;
 
   options.table_factory.reset(
       rocksdb::NewBlockBasedTableFactory(block_options));
   options.statistics = rocksdb::CreateDBStatistics();
-  options.env = rocksdb::NewDCPMMEnv(rocksdb::DCPMMEnvOptions());
+  options.merge_operator = std::make_shared<RecordDeltaMergeOperator>();
+}
+
+void RocksDBImpl::ApplyOptionsFile(const std::string& options_file) {
+  // The OPTIONS file overrides every option it can express; the env,
+  // statistics, block cache, merge operator, dcpmm and mmap settings keep
+  // coming from the profile.
+  rocksdb::DBOptions db_options;
+  std::vector<rocksdb::ColumnFamilyDescriptor> cf_descs;
+  rocksdb::Status s = rocksdb::LoadOptionsFromFile(
+      options_file, rocksdb::Env::Default(), &db_options, &cf_descs, false,
+      &block_cache_);
+  if (!s.ok() || cf_descs.empty()) {
+    LOG("load rocksdb options file failed: ", options_file, " ",
+        s.ToString());
+    abort();
+  }
+  rocksdb::ColumnFamilyOptions cf_options = cf_descs[0].options;
+  for (auto& desc : cf_descs) {
+    if (desc.name == rocksdb::kDefaultColumnFamilyName) {
+      cf_options = desc.options;
+    }
+  }
+
+  rocksdb::Options profile_options = options;
+  options = rocksdb::Options(db_options, cf_options);
+  options.create_if_missing = true;
+  options.env = profile_options.env;
+  options.statistics = profile_options.statistics;
+  options.merge_operator = profile_options.merge_operator;
+  options.wal_dir = profile_options.wal_dir;
+  options.dcpmm_kvs_enable = profile_options.dcpmm_kvs_enable;
+  options.dcpmm_kvs_mmapped_file_fullpath =
+      profile_options.dcpmm_kvs_mmapped_file_fullpath;
+  options.dcpmm_kvs_mmapped_file_size =
+      profile_options.dcpmm_kvs_mmapped_file_size;
+  options.dcpmm_kvs_value_thres = profile_options.dcpmm_kvs_value_thres;
+  options.dcpmm_compress_value = profile_options.dcpmm_compress_value;
+  options.allow_dcpmm_writes = profile_options.allow_dcpmm_writes;
+  // the pmem profiles map the files the dcpmm settings point into
+  options.allow_mmap_reads = profile_options.allow_mmap_reads;
+  options.allow_mmap_writes = profile_options.allow_mmap_writes;
+}
+
+std::string RocksDBImpl::DumpOptions() {
+  std::ostringstream out;
+  out << "profile=" << profile_ << "; txn_mode=" << txn_mode_name_
+      << "; durability=" << durability_name_
+      << "; group_commit_window_us=" << group_commit_window_us_
+      << "; options_file="
+      << (options_file_.empty() ? "none" : options_file_)
+      << "; block_cache_capacity="
+      << (block_cache_ ? block_cache_->GetCapacity() : 0)
+      << "; dcpmm_kvs_enable=" << options.dcpmm_kvs_enable
+      << "; dcpmm_kvs_value_thres=" << options.dcpmm_kvs_value_thres
+      << "; dcpmm_kvs_mmapped_file_size="
+      << options.dcpmm_kvs_mmapped_file_size
+      << "; allow_dcpmm_writes=" << options.allow_dcpmm_writes;
+
+  std::string db_str, cf_str;
+  if (rocksdb::GetStringFromDBOptions(&db_str, options, "; ").ok()) {
+    out << "; " << db_str;
+  }
+  if (rocksdb::GetStringFromColumnFamilyOptions(&cf_str, options, "; ")
+          .ok()) {
+    out << "; " << cf_str;
+  }
+  return out.str();
+}
+
+std::string RocksDBImpl::DumpStats() {
+  std::ostringstream out;
+  std::lock_guard<std::mutex> lock(group_mutex_);
+  out << "group_commit_writes=" << group_writes_
+      << "; group_commit_txns=" << group_txns_
+      << "; bulk_files_ingested=" << bulk_files_ingested_.load()
+      << "; multiget_batches=" << multiget_batches_.load()
+      << "; multiget_keys=" << multiget_keys_.load();
+  if (group_writes_ > 0) {
+    out << "; group_commit_avg_size="
+        << double(group_txns_) / group_writes_;
+  }
+  return out.str();
+}
+
+KVMemoryUsage RocksDBImpl::MemoryUsage() {
+  KVMemoryUsage usage;
+  uint64_t bytes;
+  if (db_->GetAggregatedIntProperty(
+          rocksdb::DB::Properties::kSizeAllMemTables, &bytes)) {
+    usage.table_bytes = bytes;
+  }
+  if (db_->GetAggregatedIntProperty(
+          rocksdb::DB::Properties::kEstimateTableReadersMem, &bytes)) {
+    usage.index_bytes = bytes;
+  }
+  if (block_cache_) {
+    usage.cache_bytes = block_cache_->GetUsage();
+  }
+  return usage;
+}
 
+KVBulkWriter* RocksDBImpl::NewBulkWriter(bool sorted) {
+  mkdir(bulk_dir_.c_str(), 0755);
+  return new RocksDBBulkWriter(this, sorted);
+}
 
-  rocksdb::Status s = rocksdb::DB::Open(options, pmem_rocksdb_path, &db_);
+int RocksDBImpl::Flush() {
+  // the memtables may have been filled without WAL
+  rocksdb::Status s = db_->Flush(rocksdb::FlushOptions());
+  if (s.ok() && !write_options_.disableWAL) {
+    s = db_->SyncWAL();
+  }
+  return s.ok() ? 1 : -1;
+}
+
+int RocksDBImpl::Begin() {
+  TxnSlot* slot = CurrentSlot();
+  assert(!slot->active);
+  switch (txn_mode_) {
+    case TxnMode::kPessimistic: {
+      rocksdb::TransactionOptions txn_options;
+      // A transaction interleaved with others of its thread (INFLIGHT_TXNS)
+      // must not wait for a lock: the holder may be one of them, and it only
+      // runs again once this one yields. It gets Busy at once and aborts.
+      if (attached_[Utils::ThreadIndex()] != nullptr) {
+        txn_options.lock_timeout = 0;
+      }
+      slot->txn =
+          txn_db_->BeginTransaction(commit_options_, txn_options, slot->txn);
+      break;
+    }
+    case TxnMode::kOptimistic:
+      slot->txn = optimistic_txn_db_->BeginTransaction(
+          commit_options_, rocksdb::OptimisticTransactionOptions(),
+          slot->txn);
+      break;
+    default:
+      // Without engine transactions only a synced commit needs the writes
+      // of a transaction together; otherwise they go straight to the db.
+      if (!commit_options_.sync) {
+        return 1;
+      }
+      if (slot->batch == nullptr) {
+        slot->batch = new rocksdb::WriteBatchWithIndex(
+            rocksdb::BytewiseComparator(), 0, true);
+      }
+      slot->batch->Clear();
+  }
+  slot->active = true;
+  slot->failed = false;
+  return 1;
+}
+
+int RocksDBImpl::Commit() {
+  TxnSlot* slot = ActiveTxn();
+  if (slot == nullptr) {
+    return 1;
+  }
+  slot->active = false;
+  rocksdb::Status s;
+  if (txn_mode_ == TxnMode::kNone) {
+    if (slot->failed) {
+      return -1;
+    }
+    rocksdb::WriteBatch* batch = slot->batch->GetWriteBatch();
+    if (batch->Count() == 0) {
+      return 1;  // read only
+    }
+    if (durability_ == Durability::kGroupCommit) {
+      s = GroupCommit(batch);
+    } else {
+      s = db_->Write(commit_options_, batch);
+    }
+    return s.ok() ? 1 : -1;
+  }
+  if (!slot->failed) {
+    // Busy/TryAgain here is an optimistic validation failure
+    s = slot->txn->Commit();
+  }
+  if (slot->failed || !s.ok()) {
+    slot->txn->Rollback();
+    return -1;
+  }
+  return 1;
+}
+
+int RocksDBImpl::Rollback() {
+  TxnSlot* slot = ActiveTxn();
+  if (slot == nullptr) {
+    return 1;
+  }
+  if (slot->txn != nullptr) {
+    slot->txn->Rollback();
+  }
+  slot->active = false;
+  return 1;
+}
+
+int RocksDBImpl::GetForUpdate(uint64_t key, std::string& value) {
+  TxnSlot* slot = ActiveTxn();
+  if (slot == nullptr || txn_mode_ == TxnMode::kNone) {
+    return Get(key, value);
+  }
+  rocksdb::Status s = slot->txn->GetForUpdate(rocksdb::ReadOptions(),
+                                              EncodeKey(key), &value);
   if (!s.ok()) {
-    LOG("init rocksdb failed!");
-    abort();
+    // lock timeouts and deadlocks doom the transaction, a miss does not
+    slot->failed |= !s.IsNotFound();
+    return -1;
   }
+  return 1;
 }
+
 int RocksDBImpl::Put(uint64_t key, const std::string&value) {
   rocksdb::Status s;
-  s = db_->Put(rocksdb::WriteOptions(), std::to_string(key), 
+  TxnSlot* slot = ActiveTxn();
+  if (slot != nullptr) {
+    if (txn_mode_ == TxnMode::kNone) {
+      s = slot->batch->Put(EncodeKey(key), value);
+    } else {
+      s = slot->txn->Put(EncodeKey(key), value);
+    }
+    slot->failed |= !s.ok();
+    return s.ok() ? 1 : -1;
+  }
+  s = db_->Put(write_options_, EncodeKey(key), 
   value);
   if( !s.ok()){
     return -1;
   }
   return 1;
 }
+int RocksDBImpl::Merge(uint64_t key, const std::string& delta) {
+  rocksdb::Status s;
+  TxnSlot* slot = ActiveTxn();
+  if (slot != nullptr) {
+    if (txn_mode_ == TxnMode::kNone) {
+      s = slot->batch->Merge(EncodeKey(key), delta);
+    } else {
+      s = slot->txn->Merge(EncodeKey(key), delta);
+    }
+    slot->failed |= !s.ok();
+    return s.ok() ? 1 : -1;
+  }
+  s = db_->Merge(write_options_, EncodeKey(key), delta);
+  return s.ok() ? 1 : -1;
+}
+int RocksDBImpl::Delete(uint64_t key) {
+  rocksdb::Status s;
+  TxnSlot* slot = ActiveTxn();
+  if (slot != nullptr) {
+    if (txn_mode_ == TxnMode::kNone) {
+      s = slot->batch->Delete(EncodeKey(key));
+    } else {
+      s = slot->txn->Delete(EncodeKey(key));
+    }
+    slot->failed |= !s.ok();
+    return s.ok() ? 1 : -1;
+  }
+  s = db_->Delete(write_options_, EncodeKey(key));
+  return s.ok() ? 1 : -1;
+}
+
 int RocksDBImpl::Get(uint64_t key, std::string& value) {
   rocksdb::Status s;
-  s = db_->Get(rocksdb::ReadOptions(), std::to_string(key) ,
+  TxnSlot* slot = ActiveTxn();
+  if (slot != nullptr) {
+    if (txn_mode_ == TxnMode::kNone) {
+      s = slot->batch->GetFromBatchAndDB(db_, rocksdb::ReadOptions(),
+                                         EncodeKey(key), &value);
+    } else {
+      s = slot->txn->Get(rocksdb::ReadOptions(), EncodeKey(key), &value);
+    }
+    return s.ok() ? 1 : -1;
+  }
+  s = db_->Get(rocksdb::ReadOptions(), EncodeKey(key) ,
   &value);
   if( !s.ok()){
     return -1;
   }
   return 1;
-}
\ No newline at end of file
+}
+
+void RocksDBImpl::DeleteTxnContext(void* txn_context) {
+  TxnSlot* slot = static_cast<TxnSlot*>(txn_context);
+  delete slot->txn;
+  delete slot->batch;
+  delete slot;
+}
+
+void RocksDBImpl::MultiGet(KVRead* const* reads, size_t n) {
+  // Reads of a transaction that buffers writes have to see them and locked
+  // reads go through the transaction; those are served one by one. The rest
+  // read the db directly and are batched.
+  std::vector<KVRead*> batched;
+  batched.reserve(n);
+  for (size_t i = 0; i < n; i++) {
+    KVRead* read = reads[i];
+    SwitchTxnContext(read->txn_context);
+    if (ActiveTxn() == nullptr) {
+      batched.push_back(read);
+    } else {
+      read->status = read->for_update ? GetForUpdate(read->key, read->value)
+                                      : Get(read->key, read->value);
+    }
+  }
+  SwitchTxnContext(nullptr);
+  if (batched.empty()) {
+    return;
+  }
+  std::vector<std::string> keys(batched.size());
+  std::vector<rocksdb::Slice> key_slices(batched.size());
+  for (size_t i = 0; i < batched.size(); i++) {
+    keys[i] = EncodeKey(batched[i]->key);
+    key_slices[i] = keys[i];
+  }
+  std::vector<std::string> values;
+  std::vector<rocksdb::Status> statuses =
+      db_->MultiGet(rocksdb::ReadOptions(), key_slices, &values);
+  for (size_t i = 0; i < batched.size(); i++) {
+    batched[i]->status = statuses[i].ok() ? 1 : -1;
+    batched[i]->value.swap(values[i]);
+  }
+  multiget_batches_.fetch_add(1, std::memory_order_relaxed);
+  multiget_keys_.fetch_add(batched.size(), std::memory_order_relaxed);
+}
@@ -5,19 +5,143 @@
 // Copyright (c) 2023 liuzhenm@mail.ustc.edu.cn.
 //
 #pragma once
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
 #include "kv_interface.h"
 #include "rocksdb/db.h"
 #include "rocksdb/options.h"
+#include "rocksdb/utilities/write_batch_with_index.h"
+#include "rocksdb/utilities/optimistic_transaction_db.h"
+#include "rocksdb/utilities/transaction.h"
+#include "rocksdb/utilities/transaction_db.h"
+#include "utils.h"
 
 
 class RocksDBImpl : public KVInterface {
  public:
-  RocksDBImpl(std::string dbpath);
+  // profile: one of the named configurations in rocksdb_impl.cc;
+  // options_file: optional RocksDB OPTIONS file applied on top of the profile;
+  // txn_mode: "none", "pessimistic" (TransactionDB) or "optimistic"
+  // (OptimisticTransactionDB);
+  // durability: "none" (no WAL), "wal-async", "wal-sync-per-txn" or
+  // "group-commit" (a committer thread syncs several transactions at once).
+  RocksDBImpl(std::string dbpath, std::string profile = "pmem-kvsep",
+              std::string options_file = "", std::string txn_mode = "none",
+              std::string durability = "wal-async",
+              uint32_t group_commit_window_us = 0);
   int Put(uint64_t key, const std::string& value) override;
   int Get(uint64_t key, std::string& value) override;
-  virtual ~RocksDBImpl() {}
+  int Begin() override;
+  int Commit() override;
+  int Rollback() override;
+  int GetForUpdate(uint64_t key, std::string& value) override;
+  // Writes the delta as a merge operand, see RecordDeltaMergeOperator. A
+  // missing key is only noticed when it is read.
+  int Merge(uint64_t key, const std::string& delta) override;
+  int Delete(uint64_t key) override;
+  // a context is a TxnSlot of its own
+  void* NewTxnContext() override { return new TxnSlot; }
+  void DeleteTxnContext(void* txn_context) override;
+  void SwitchTxnContext(void* txn_context) override {
+    attached_[Utils::ThreadIndex()] = static_cast<TxnSlot*>(txn_context);
+  }
+  // Reads outside of an engine transaction go to the db in one MultiGet
+  void MultiGet(KVRead* const* reads, size_t n) override;
+  std::string DumpOptions() override;
+  std::string DumpStats() override;
+  // memtables, table readers and block cache of all column families
+  KVMemoryUsage MemoryUsage() override;
+  int Flush() override;
+  bool Persistent() override { return true; }
+  // SST files written with SstFileWriter and ingested on Finish()
+  KVBulkWriter* NewBulkWriter(bool sorted) override;
+  virtual ~RocksDBImpl();
 
  private:
+  friend class RocksDBBulkWriter;
+
+  enum class TxnMode : uint8_t { kNone = 0, kPessimistic, kOptimistic };
+  enum class Durability : uint8_t {
+    kNone = 0,
+    kWalAsync,
+    kWalSyncPerTxn,
+    kGroupCommit
+  };
+
+  // Transaction owned by one worker thread. With an engine txn_mode the
+  // rocksdb::Transaction is kept and reused by the next BeginTransaction();
+  // otherwise the writes are collected in an indexed batch (so the
+  // transaction reads its own writes) and written at commit.
+  struct alignas(64) TxnSlot {
+    rocksdb::Transaction* txn = nullptr;
+    rocksdb::WriteBatchWithIndex* batch = nullptr;
+    bool active = false;
+    bool failed = false;  // a lock or write error happened, commit will abort
+  };
+
+  // One transaction waiting for the group committer
+  struct CommitRequest {
+    rocksdb::WriteBatch* batch;
+    rocksdb::Status status;
+    bool done = false;
+  };
+
+  void ApplyProfile(const std::string& profile, const std::string& dbpath);
+  void ApplyOptionsFile(const std::string& options_file);
+  void ApplyDurability(const std::string& durability);
+  rocksdb::Status GroupCommit(rocksdb::WriteBatch* batch);
+  void GroupCommitLoop();
+  // the attached context, else the thread's own slot
+  TxnSlot* CurrentSlot() {
+    uint32_t thread = Utils::ThreadIndex();
+    return attached_[thread] != nullptr ? attached_[thread]
+                                        : &txn_slots_[thread];
+  }
+  TxnSlot* ActiveTxn() {
+    TxnSlot* slot = CurrentSlot();
+    return slot->active ? slot : nullptr;
+  }
+
   rocksdb::DB* db_;
+  rocksdb::TransactionDB* txn_db_ = nullptr;
+  rocksdb::OptimisticTransactionDB* optimistic_txn_db_ = nullptr;
+  TxnMode txn_mode_ = TxnMode::kNone;
+  std::unique_ptr<TxnSlot[]> txn_slots_;
+  std::unique_ptr<TxnSlot*[]> attached_;  // per thread, see SwitchTxnContext()
+  std::atomic<uint64_t> multiget_batches_{0};
+  std::atomic<uint64_t> multiget_keys_{0};
+
+  Durability durability_ = Durability::kWalAsync;
+  rocksdb::WriteOptions write_options_;  // puts outside of a transaction
+  rocksdb::WriteOptions commit_options_;  // transaction commits
+
+  // group commit
+  uint32_t group_commit_window_us_ = 0;
+  std::mutex group_mutex_;
+  std::condition_variable group_cv_;       // wakes the committer
+  std::condition_variable group_done_cv_;  // wakes the waiting workers
+  std::vector<CommitRequest*> group_queue_;
+  // last group each thread joined, by index, 0 for none; a thread has at
+  // most one request queued
+  std::unique_ptr<uint64_t[]> group_joined_{
+      new uint64_t[Utils::kMaxThreads]()};
+  uint64_t group_seq_ = 1;  // the group being gathered
+  bool group_stop_ = false;
+  uint64_t group_writes_ = 0;
+  uint64_t group_txns_ = 0;
+  std::thread group_committer_;
+
   rocksdb::Options options;
+  std::shared_ptr<rocksdb::Cache> block_cache_;
+  std::string profile_;
+  std::string options_file_;
+  std::string txn_mode_name_;
+  std::string durability_name_;
+
+  std::string bulk_dir_;  // staging directory of bulk load files
+  std::atomic<uint64_t> bulk_file_number_{0};
+  std::atomic<uint64_t> bulk_files_ingested_{0};
 };
@@ -177,6 +177,37 @@ struct tpcc_customer_val_t {
 
 static_assert(sizeof(tpcc_customer_val_t) == 664, "");
 
+// HOT_COLD_SPLIT stores a customer as two records under the same key: the
+// fields Payment, Delivery and NewOrder use, and the rest. Only the BC
+// C_DATA rewrite of Payment writes the cold one.
+struct tpcc_customer_hot_val_t {
+  float c_credit_lim;
+  float c_discount;
+  float c_balance;
+  float c_ytd_payment;
+  int32_t c_payment_cnt;
+  int32_t c_delivery_cnt;
+  uint32_t c_since;
+  char c_credit[tpcc_customer_val_t::CREDIT + 1];
+};
+
+static_assert(sizeof(tpcc_customer_hot_val_t) == 32, "");
+
+struct tpcc_customer_cold_val_t {
+  char c_first[tpcc_customer_val_t::MAX_FIRST + 1];
+  char c_middle[tpcc_customer_val_t::MIDDLE + 1];
+  char c_last[tpcc_customer_val_t::MAX_LAST + 1];
+  char c_street_1[Address::MAX_STREET + 1];
+  char c_street_2[Address::MAX_STREET + 1];
+  char c_city[Address::MAX_CITY + 1];
+  char c_state[Address::STATE + 1];
+  char c_zip[Address::ZIP + 1];
+  char c_phone[tpcc_customer_val_t::PHONE + 1];
+  char c_data[tpcc_customer_val_t::MAX_DATA + 1];
+};
+
+static_assert(sizeof(tpcc_customer_cold_val_t) == 631, "");
+
 union tpcc_customer_index_key_t {
   struct {
     uint64_t c_index_id;
@@ -389,5 +420,103 @@ struct tpcc_stock_val_t {
 static_assert(sizeof(tpcc_stock_val_t) == 328, ""); // add debug magic
 // static_assert(sizeof(tpcc_stock_val_t) == 320, "");
 
+// HOT_COLD_SPLIT stores a stock row as the counters NewOrder updates and
+// the S_DIST_xx / S_DATA strings it only reads, under the same key.
+struct tpcc_stock_hot_val_t {
+  int32_t s_quantity;
+  int32_t s_ytd;
+  int32_t s_order_cnt;
+  int32_t s_remote_cnt;
+  int64_t debug_magic;
+};
+
+static_assert(sizeof(tpcc_stock_hot_val_t) == 24, "");
+
+struct tpcc_stock_cold_val_t {
+  char s_dist[NUM_DISTRICT_PER_WAREHOUSE][DIST + 1];
+  char s_data[tpcc_stock_val_t::MAX_DATA + 1];
+};
+
+static_assert(sizeof(tpcc_stock_cold_val_t) == 301, "");
+
+// Split a full row into its hot and cold records.
+inline void SplitRecord(const tpcc_customer_val_t& val,
+                        tpcc_customer_hot_val_t* hot,
+                        tpcc_customer_cold_val_t* cold) {
+  hot->c_credit_lim = val.c_credit_lim;
+  hot->c_discount = val.c_discount;
+  hot->c_balance = val.c_balance;
+  hot->c_ytd_payment = val.c_ytd_payment;
+  hot->c_payment_cnt = val.c_payment_cnt;
+  hot->c_delivery_cnt = val.c_delivery_cnt;
+  hot->c_since = val.c_since;
+  memcpy(hot->c_credit, val.c_credit, sizeof(hot->c_credit));
+  memcpy(cold->c_first, val.c_first, sizeof(cold->c_first));
+  memcpy(cold->c_middle, val.c_middle, sizeof(cold->c_middle));
+  memcpy(cold->c_last, val.c_last, sizeof(cold->c_last));
+  memcpy(cold->c_street_1, val.c_street_1, sizeof(cold->c_street_1));
+  memcpy(cold->c_street_2, val.c_street_2, sizeof(cold->c_street_2));
+  memcpy(cold->c_city, val.c_city, sizeof(cold->c_city));
+  memcpy(cold->c_state, val.c_state, sizeof(cold->c_state));
+  memcpy(cold->c_zip, val.c_zip, sizeof(cold->c_zip));
+  memcpy(cold->c_phone, val.c_phone, sizeof(cold->c_phone));
+  memcpy(cold->c_data, val.c_data, sizeof(cold->c_data));
+}
+
+inline void SplitRecord(const tpcc_stock_val_t& val,
+                        tpcc_stock_hot_val_t* hot,
+                        tpcc_stock_cold_val_t* cold) {
+  hot->s_quantity = val.s_quantity;
+  hot->s_ytd = val.s_ytd;
+  hot->s_order_cnt = val.s_order_cnt;
+  hot->s_remote_cnt = val.s_remote_cnt;
+  hot->debug_magic = val.debug_magic;
+  memcpy(cold->s_dist, val.s_dist, sizeof(cold->s_dist));
+  memcpy(cold->s_data, val.s_data, sizeof(cold->s_data));
+}
+
+template <typename T>
+struct HotColdOf;
+
+template <>
+struct HotColdOf<tpcc_customer_val_t> {
+  using Hot = tpcc_customer_hot_val_t;
+  using Cold = tpcc_customer_cold_val_t;
+};
+
+template <>
+struct HotColdOf<tpcc_stock_val_t> {
+  using Hot = tpcc_stock_hot_val_t;
+  using Cold = tpcc_stock_cold_val_t;
+};
+
+/*
+ * Value type -> table the record is stored in
+ */
+template <typename T>
+struct TableOf;
+
+#define TPCC_TABLE_OF(val_t, table_type)                          \
+  template <>                                                     \
+  struct TableOf<val_t> {                                         \
+    static constexpr TPCCTableType type = TPCCTableType::table_type; \
+  }
+
+TPCC_TABLE_OF(tpcc_warehouse_val_t, kWarehouseTable);
+TPCC_TABLE_OF(tpcc_district_val_t, kDistrictTable);
+TPCC_TABLE_OF(tpcc_customer_val_t, kCustomerTable);
+TPCC_TABLE_OF(tpcc_history_val_t, kHistoryTable);
+TPCC_TABLE_OF(tpcc_new_order_val_t, kNewOrderTable);
+TPCC_TABLE_OF(tpcc_order_val_t, kOrderTable);
+TPCC_TABLE_OF(tpcc_order_line_val_t, kOrderLineTable);
+TPCC_TABLE_OF(tpcc_item_val_t, kItemTable);
+TPCC_TABLE_OF(tpcc_stock_val_t, kStockTable);
+TPCC_TABLE_OF(tpcc_customer_index_val_t, kCustomerIndexTable);
+TPCC_TABLE_OF(tpcc_order_index_val_t, kOrderIndexTable);
+TPCC_TABLE_OF(tpcc_customer_hot_val_t, kCustomerHotTable);
+TPCC_TABLE_OF(tpcc_customer_cold_val_t, kCustomerColdTable);
+TPCC_TABLE_OF(tpcc_stock_hot_val_t, kStockHotTable);
+TPCC_TABLE_OF(tpcc_stock_cold_val_t, kStockColdTable);
+
 
 } // end of namespace TPCC
\ No newline at end of file
@@ -0,0 +1,222 @@
+//
+// snapshot.cc
+//
+// Created by Zacharyliu-CS on 03/09/2024.
+// Copyright (c) 2024 liuzhenm@mail.ustc.edu.cn.
+//
+#include "snapshot.h"
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+namespace TPCC {
+
+namespace fs = std::filesystem;
+
+bool LoadManifest::Write(const std::string& path) const {
+  // write aside and rename, a torn manifest must never look valid
+  std::string tmp_path = path + ".tmp";
+  {
+    std::ofstream out(tmp_path, std::ios::trunc);
+    if (!out.is_open()) {
+      return false;
+    }
+    out << "format_version = " << format_version << std::endl;
+    out << "num_warehouse = " << num_warehouse << std::endl;
+    out << "num_district_per_warehouse = " << num_district_per_warehouse
+        << std::endl;
+    out << "num_customer_per_district = " << num_customer_per_district
+        << std::endl;
+    out << "num_item = " << num_item << std::endl;
+    out << "num_stock_per_warehouse = " << num_stock_per_warehouse
+        << std::endl;
+    out << "seeds =";
+    for (auto seed : seeds) {
+      out << " " << seed;
+    }
+    out << std::endl;
+    out << "hot_cold_split = " << hot_cold_split << std::endl;
+    out << "table_records =";
+    for (auto count : table_records) {
+      out << " " << count;
+    }
+    out << std::endl;
+    out << "total_records = " << total_records << std::endl;
+    if (!out.good()) {
+      return false;
+    }
+  }
+  std::error_code ec;
+  fs::rename(tmp_path, path, ec);
+  return !ec;
+}
+
+bool LoadManifest::Read(const std::string& path) {
+  std::ifstream in(path);
+  if (!in.is_open()) {
+    return false;
+  }
+  std::string line;
+  uint32_t fields = 0;
+  while (std::getline(in, line)) {
+    size_t pos = line.find('=');
+    if (pos == std::string::npos) {
+      continue;
+    }
+    std::string key = line.substr(0, pos);
+    key.erase(key.find_last_not_of(' ') + 1);
+    std::istringstream value(line.substr(pos + 1));
+    if (key == "format_version") {
+      value >> format_version;
+    } else if (key == "num_warehouse") {
+      value >> num_warehouse;
+    } else if (key == "num_district_per_warehouse") {
+      value >> num_district_per_warehouse;
+    } else if (key == "num_customer_per_district") {
+      value >> num_customer_per_district;
+    } else if (key == "num_item") {
+      value >> num_item;
+    } else if (key == "num_stock_per_warehouse") {
+      value >> num_stock_per_warehouse;
+    } else if (key == "seeds") {
+      seeds.clear();
+      uint64_t seed;
+      while (value >> seed) {
+        seeds.push_back(seed);
+      }
+    } else if (key == "hot_cold_split") {
+      value >> hot_cold_split;
+    } else if (key == "table_records") {
+      for (auto& count : table_records) {
+        value >> count;
+      }
+    } else if (key == "total_records") {
+      value >> total_records;
+    } else {
+      continue;
+    }
+    if (value.bad()) {
+      return false;
+    }
+    fields++;
+  }
+  return fields == 10;
+}
+
+bool LoadManifest::SameLoad(const LoadManifest& other,
+                            std::string* reason) const {
+  auto mismatch = [reason](const std::string& what) {
+    if (reason != nullptr) {
+      *reason = what + " differs";
+    }
+    return false;
+  };
+  if (format_version != other.format_version) {
+    return mismatch("format_version");
+  }
+  if (num_warehouse != other.num_warehouse) {
+    return mismatch("num_warehouse");
+  }
+  if (num_district_per_warehouse != other.num_district_per_warehouse ||
+      num_customer_per_district != other.num_customer_per_district ||
+      num_item != other.num_item ||
+      num_stock_per_warehouse != other.num_stock_per_warehouse) {
+    return mismatch("scale");
+  }
+  if (seeds != other.seeds) {
+    return mismatch("seeds");
+  }
+  if (hot_cold_split != other.hot_cold_split) {
+    return mismatch("hot_cold_split");
+  }
+  return true;
+}
+
+namespace {
+
+// Copy the data extents of src_fd (SEEK_DATA/SEEK_HOLE) and size dst_fd to
+// match; the holes of a sparse file stay holes instead of being written out
+// as zeros. Filesystems without hole tracking report one extent.
+bool CopySparse(int src_fd, int dst_fd) {
+  struct stat st;
+  if (fstat(src_fd, &st) != 0) {
+    return false;
+  }
+  char buf[1 << 16];
+  off_t data = 0;
+  while (data < st.st_size) {
+    data = lseek(src_fd, data, SEEK_DATA);
+    if (data < 0) {
+      if (errno == ENXIO) {
+        break;  // a hole up to the end
+      }
+      return false;
+    }
+    off_t hole = lseek(src_fd, data, SEEK_HOLE);
+    if (hole < 0) {
+      return false;
+    }
+    while (data < hole) {
+      size_t len = size_t(std::min<off_t>(sizeof(buf), hole - data));
+      ssize_t n = pread(src_fd, buf, len, data);
+      if (n <= 0 || pwrite(dst_fd, buf, n, data) != n) {
+        return false;
+      }
+      data += n;
+    }
+  }
+  return ftruncate(dst_fd, st.st_size) == 0;
+}
+
+bool CloneFile(const fs::path& src, const fs::path& dst) {
+  int src_fd = open(src.c_str(), O_RDONLY);
+  if (src_fd < 0) {
+    return false;
+  }
+  int dst_fd = open(dst.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (dst_fd < 0) {
+    close(src_fd);
+    return false;
+  }
+  bool ok = ioctl(dst_fd, FICLONE, src_fd) == 0;
+  if (!ok) {
+    // no reflink across filesystems or on ext4/pmem, fall back to a copy
+    ok = CopySparse(src_fd, dst_fd);
+  }
+  close(src_fd);
+  close(dst_fd);
+  return ok;
+}
+
+}  // namespace
+
+bool CloneDirectory(const std::string& src, const std::string& dst) {
+  std::error_code ec;
+  if (!fs::is_directory(src, ec)) {
+    return false;
+  }
+  fs::remove_all(dst, ec);
+  fs::create_directories(dst, ec);
+  if (ec) {
+    return false;
+  }
+  for (auto it = fs::recursive_directory_iterator(src, ec);
+       !ec && it != fs::recursive_directory_iterator(); it.increment(ec)) {
+    fs::path target = fs::path(dst) / fs::relative(it->path(), src);
+    if (it->is_directory()) {
+      fs::create_directories(target, ec);
+    } else if (!CloneFile(it->path(), target)) {
+      return false;
+    }
+  }
+  return !ec;
+}
+
+}  // end of namespace TPCC
@@ -0,0 +1,49 @@
+//
+// snapshot.h
+//
+// Created by Zacharyliu-CS on 03/09/2024.
+// Copyright (c) 2024 liuzhenm@mail.ustc.edu.cn.
+//
+#pragma once
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "config.h"
+
+namespace TPCC {
+
+// Describes what LoadTables() wrote into a database directory, so that later
+// runs can reopen the store instead of populating it again.
+struct LoadManifest {
+  static const uint32_t kFormatVersion = 4;
+  static constexpr const char* kFileName = "TPCC_LOAD_MANIFEST";
+
+  uint32_t format_version = kFormatVersion;
+  uint32_t num_warehouse = 0;
+  uint32_t num_district_per_warehouse = 0;
+  uint32_t num_customer_per_district = 0;
+  uint32_t num_item = 0;
+  uint32_t num_stock_per_warehouse = 0;
+  std::vector<uint64_t> seeds;
+  bool hot_cold_split = false;  // HOT_COLD_SPLIT layout
+  std::array<uint64_t, TPCC_TABLE_TYPES> table_records{};
+  uint64_t total_records = 0;
+
+  static std::string PathOf(const std::string& db_dir) {
+    return db_dir + "/" + kFileName;
+  }
+  bool Write(const std::string& path) const;
+  // false when the file is missing or malformed
+  bool Read(const std::string& path);
+  // Same format, scale and seeds, i.e. the store holds the load we asked for.
+  // reason explains the first mismatch.
+  bool SameLoad(const LoadManifest& other, std::string* reason) const;
+};
+
+// Replace dst with a copy of the directory tree src. Files are reflinked
+// (FICLONE) when the filesystem supports it and copied otherwise, keeping
+// the holes of sparse files.
+bool CloneDirectory(const std::string& src, const std::string& dst);
+
+}  // end of namespace TPCC
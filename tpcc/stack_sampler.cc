@@ -0,0 +1,182 @@
+//
+// stack_sampler.cc
+//
+// Created by Zacharyliu-CS on 05/18/2024.
+// Copyright (c) 2024 liuzhenm@mail.ustc.edu.cn.
+//
+#include "stack_sampler.h"
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <signal.h>
+#include <sys/time.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace TPCC {
+
+namespace {
+
+// the handler and the signal trampoline
+const uint32_t kSkipFrames = 2;
+
+std::string SymbolOf(void* pc) {
+  Dl_info info;
+  if (dladdr(pc, &info) == 0) {
+    return "[unknown]";
+  }
+  if (info.dli_sname != nullptr) {
+    int status = 0;
+    char* demangled =
+        abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+    std::string name = status == 0 ? demangled : info.dli_sname;
+    free(demangled);
+    return name;
+  }
+  // not exported: module and offset, for addr2line
+  std::ostringstream out;
+  const char* module = info.dli_fname ? strrchr(info.dli_fname, '/') : nullptr;
+  out << "[" << (module ? module + 1 : "unknown") << "+0x" << std::hex
+      << (uintptr_t(pc) - uintptr_t(info.dli_fbase)) << "]";
+  return out.str();
+}
+
+}  // namespace
+
+StackSampler& StackSampler::Get() {
+  static StackSampler sampler;
+  return sampler;
+}
+
+bool StackSampler::Init(uint32_t hz, std::string* error) {
+  if (hz == 0 || hz > 10000) {
+    *error = "sample rate must be in [1, 10000] hz";
+    return false;
+  }
+  hz_ = hz;
+  for (Buffer& buffer : buffers_) {
+    buffer.samples.reset(new Sample[kCapacity]);
+  }
+  // the first backtrace() loads the unwinder, which must not happen in the
+  // handler
+  void* warmup[1];
+  backtrace(warmup, 1);
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = &StackSampler::Handler;
+  action.sa_flags = SA_RESTART;
+  sigemptyset(&action.sa_mask);
+  if (sigaction(SIGPROF, &action, nullptr) != 0) {
+    *error = std::string("sigaction: ") + strerror(errno);
+    return false;
+  }
+  return true;
+}
+
+void StackSampler::Handler(int) {
+  int saved_errno = errno;
+  StackSampler& sampler = Get();
+  sampler.in_handler_.fetch_add(1);
+  Buffer& buffer = sampler.buffers_[sampler.active_.load()];
+  uint32_t slot = buffer.next.fetch_add(1, std::memory_order_relaxed);
+  if (slot >= kCapacity) {
+    sampler.dropped_.fetch_add(1, std::memory_order_relaxed);
+  } else {
+    Sample& sample = buffer.samples[slot];
+    sample.depth = backtrace(sample.pcs, kMaxDepth);
+  }
+  sampler.in_handler_.fetch_sub(1, std::memory_order_release);
+  errno = saved_errno;
+}
+
+void StackSampler::Drain() {
+  uint32_t full = active_.load();
+  active_.store(full ^ 1);
+  // a handler that came in before the swap may still write to full
+  while (in_handler_.load(std::memory_order_acquire) != 0) {
+    std::this_thread::yield();
+  }
+  Buffer& buffer = buffers_[full];
+  uint32_t taken = std::min(buffer.next.load(), kCapacity);
+  for (uint32_t i = 0; i < taken; i++) {
+    const Sample& sample = buffer.samples[i];
+    if (sample.depth > kSkipFrames) {
+      stacks_[std::vector<void*>(sample.pcs + kSkipFrames,
+                                 sample.pcs + sample.depth)]++;
+    }
+  }
+  buffer.next.store(0);
+}
+
+void StackSampler::Start() {
+  sampling_ = true;
+  drainer_ = std::thread([this]() {
+    std::unique_lock<std::mutex> lock(drainer_mutex_);
+    while (!drainer_cv_.wait_for(lock, kDrainInterval,
+                                 [this]() { return !sampling_; })) {
+      Drain();
+    }
+  });
+  struct itimerval timer;
+  timer.it_interval.tv_sec = 0;
+  timer.it_interval.tv_usec = 1000000 / hz_;
+  timer.it_value = timer.it_interval;
+  setitimer(ITIMER_PROF, &timer, nullptr);
+}
+
+void StackSampler::Stop() {
+  struct itimerval timer;
+  memset(&timer, 0, sizeof(timer));
+  setitimer(ITIMER_PROF, &timer, nullptr);
+  {
+    std::lock_guard<std::mutex> lock(drainer_mutex_);
+    sampling_ = false;
+  }
+  drainer_cv_.notify_one();
+  drainer_.join();
+  Drain();
+}
+
+bool StackSampler::WriteFolded(const std::string& path) {
+  std::unordered_map<void*, std::string> names;
+  std::map<std::string, uint64_t> stacks;
+  for (auto& pcs_count : stacks_) {
+    const std::vector<void*>& pcs = pcs_count.first;
+    std::string stack;
+    for (size_t d = pcs.size(); d-- > 0;) {
+      auto it = names.find(pcs[d]);
+      if (it == names.end()) {
+        it = names.emplace(pcs[d], SymbolOf(pcs[d])).first;
+      }
+      if (!stack.empty()) {
+        stack += ';';
+      }
+      stack += it->second;
+    }
+    stacks[stack] += pcs_count.second;
+  }
+  uint64_t dropped = dropped_.exchange(0);
+  stacks_.clear();
+
+  std::ofstream out(path, std::ios::trunc);
+  if (!out.is_open()) {
+    return false;
+  }
+  for (auto& stack : stacks) {
+    out << stack.first << " " << stack.second << "\n";
+  }
+  if (dropped > 0) {
+    out << "[dropped] " << dropped << "\n";
+  }
+  return out.good();
+}
+
+}  // end of namespace TPCC
@@ -0,0 +1,73 @@
+//
+// stack_sampler.h
+//
+// Created by Zacharyliu-CS on 05/18/2024.
+// Copyright (c) 2024 liuzhenm@mail.ustc.edu.cn.
+//
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace TPCC {
+
+// In-process CPU profiler: ITIMER_PROF raises SIGPROF at hz per second of
+// process cpu time, in whichever thread is running, and the handler saves
+// the thread's return addresses into one of two preallocated buffers. While
+// sampling, a drainer thread swaps the buffers every kDrainInterval and
+// folds the full one into counts per stack, so a run of any length fits.
+// After Stop(), WriteFolded() turns the counts into folded stacks
+// ("root;...;leaf count" lines, the input of flamegraph.pl) and clears them.
+// Names come from the dynamic symbol table, the binary is linked with
+// exported symbols for that.
+class StackSampler {
+ public:
+  // SIGPROF and the timer are per process, so is the sampler
+  static StackSampler& Get();
+
+  bool Init(uint32_t hz, std::string* error);
+  void Start();
+  void Stop();
+  // call after Stop(); false when path can not be written
+  bool WriteFolded(const std::string& path);
+
+ private:
+  static const uint32_t kMaxDepth = 48;
+  static const uint32_t kCapacity = 1 << 15;
+  static constexpr std::chrono::milliseconds kDrainInterval{50};
+  struct Sample {
+    uint32_t depth;
+    void* pcs[kMaxDepth];
+  };
+  struct Buffer {
+    std::unique_ptr<Sample[]> samples;
+    std::atomic<uint32_t> next{0};  // slots taken
+  };
+
+  StackSampler() {}
+  static void Handler(int signo);
+  // fold the buffer the handlers filled so far, they go on in the other one
+  void Drain();
+
+  uint32_t hz_ = 0;
+  Buffer buffers_[2];
+  std::atomic<uint32_t> active_{0};      // buffer the handlers fill
+  std::atomic<uint32_t> in_handler_{0};  // handlers running now
+  std::atomic<uint64_t> dropped_{0};     // samples beyond kCapacity
+  // return addresses of a stack, leaf first, and how often it was seen
+  std::map<std::vector<void*>, uint64_t> stacks_;
+
+  std::thread drainer_;
+  std::mutex drainer_mutex_;
+  std::condition_variable drainer_cv_;
+  bool sampling_ = false;
+};
+
+}  // end of namespace TPCC
@@ -0,0 +1,81 @@
+//
+// stock_quantity_column.cc
+//
+// Created by Zacharyliu-CS on 06/15/2024.
+// Copyright (c) 2024 liuzhenm@mail.ustc.edu.cn.
+//
+#include "stock_quantity_column.h"
+#include <immintrin.h>
+#include <cstdlib>
+#include <cstring>
+#include "logging.h"
+
+namespace TPCC {
+
+namespace {
+
+// base[id] is the quantity of item id
+uint32_t CountBelowScalar(const int32_t* base, const int32_t* item_ids,
+                          size_t n, int32_t threshold, DistinctItemSet* seen) {
+  uint32_t distinct = 0;
+  for (size_t i = 0; i < n; i++) {
+    if (__atomic_load_n(&base[item_ids[i]], __ATOMIC_RELAXED) < threshold) {
+      distinct += seen->Insert(item_ids[i]);
+    }
+  }
+  return distinct;
+}
+
+__attribute__((target("avx2"))) uint32_t CountBelowAvx2(
+    const int32_t* base, const int32_t* item_ids, size_t n, int32_t threshold,
+    DistinctItemSet* seen) {
+  const __m256i limit = _mm256_set1_epi32(threshold);
+  uint32_t distinct = 0;
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256i ids = _mm256_loadu_si256((const __m256i*)(item_ids + i));
+    __m256i quantities = _mm256_i32gather_epi32(base, ids, 4);
+    uint32_t below = uint32_t(_mm256_movemask_ps(
+        _mm256_castsi256_ps(_mm256_cmpgt_epi32(limit, quantities))));
+    while (below != 0) {
+      distinct += seen->Insert(item_ids[i + __builtin_ctz(below)]);
+      below &= below - 1;
+    }
+  }
+  return distinct +
+         CountBelowScalar(base, item_ids + i, n - i, threshold, seen);
+}
+
+}  // namespace
+
+StockQuantityColumn::~StockQuantityColumn() { free(quantities_); }
+
+void StockQuantityColumn::Init(uint32_t num_warehouse, uint32_t num_item) {
+  num_warehouse_ = num_warehouse;
+  num_item_ = num_item;
+  size_t bytes = size_t(num_warehouse) * num_item * sizeof(int32_t);
+  // a whole number of cache lines for aligned_alloc
+  bytes = (bytes + 63) / 64 * 64;
+  quantities_ = static_cast<int32_t*>(aligned_alloc(64, bytes));
+  if (quantities_ == nullptr) {
+    LOG("allocate stock quantity column failed, bytes = ", bytes);
+    abort();
+  }
+  memset(quantities_, 0, bytes);
+  use_avx2_ = __builtin_cpu_supports("avx2");
+}
+
+uint32_t StockQuantityColumn::CountDistinctBelow(uint32_t w_id,
+                                                 const int32_t* item_ids,
+                                                 size_t n, int32_t threshold,
+                                                 DistinctItemSet* seen) {
+  // item ids start at 1
+  const int32_t* base = quantities_ + Index(w_id, 1) - 1;
+  uint32_t distinct =
+      use_avx2_ ? CountBelowAvx2(base, item_ids, n, threshold, seen)
+                : CountBelowScalar(base, item_ids, n, threshold, seen);
+  seen->Clear(item_ids, n);
+  return distinct;
+}
+
+}  // end of namespace TPCC
@@ -0,0 +1,56 @@
+//
+// stock_quantity_column.h
+//
+// Created by Zacharyliu-CS on 06/15/2024.
+// Copyright (c) 2024 liuzhenm@mail.ustc.edu.cn.
+//
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "distinct_items.h"
+
+namespace TPCC {
+
+// STOCK_QUANTITY_COLUMN: S_QUANTITY of every stock row in one dense int32
+// array indexed by (warehouse, item), a column copy next to the kv rows
+// the way an HTAP engine keeps one for its analytic queries. NewOrder adds
+// its changes after committing, StockLevel reads it instead of the rows.
+class StockQuantityColumn {
+ public:
+  StockQuantityColumn() {}
+  ~StockQuantityColumn();
+
+  // Allocate the column, every quantity 0
+  void Init(uint32_t num_warehouse, uint32_t num_item);
+  bool Enabled() const { return quantities_ != nullptr; }
+
+  void Set(uint32_t w_id, int32_t i_id, int32_t quantity) {
+    __atomic_store_n(&quantities_[Index(w_id, i_id)], quantity,
+                     __ATOMIC_RELAXED);
+  }
+  void Add(uint32_t w_id, int32_t i_id, int32_t delta) {
+    __atomic_fetch_add(&quantities_[Index(w_id, i_id)], delta,
+                       __ATOMIC_RELAXED);
+  }
+  int32_t Get(uint32_t w_id, int32_t i_id) const {
+    return __atomic_load_n(&quantities_[Index(w_id, i_id)], __ATOMIC_RELAXED);
+  }
+
+  // Number of distinct items among item_ids (ids of warehouse w_id) whose
+  // quantity is below threshold, counted in seen (empty before and after).
+  // The quantities are gathered 8 at a time with AVX2 when the cpu has it.
+  uint32_t CountDistinctBelow(uint32_t w_id, const int32_t* item_ids, size_t n,
+                              int32_t threshold, DistinctItemSet* seen);
+
+ private:
+  size_t Index(uint32_t w_id, int32_t i_id) const {
+    return size_t(w_id - 1) * num_item_ + size_t(i_id - 1);
+  }
+
+  uint32_t num_warehouse_ = 0;
+  uint32_t num_item_ = 0;
+  int32_t* quantities_ = nullptr;
+  bool use_avx2_ = false;
+};
+
+}  // end of namespace TPCC
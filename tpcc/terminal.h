@@ -0,0 +1,105 @@
+//
+// terminal.h
+//
+// Created by Zacharyliu-CS on 04/06/2024.
+// Copyright (c) 2024 liuzhenm@mail.ustc.edu.cn.
+//
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "config.h"
+#include "utils.h"
+
+namespace TPCC {
+
+// Minimum keying time and mean think time of a transaction type in seconds,
+// TPC-C 5.2.5.7 and 5.2.5.4.
+struct TerminalTimes {
+  double keying_sec;
+  double think_mean_sec;
+};
+
+inline TerminalTimes SpecTerminalTimes(TPCCTxType type) {
+  switch (type) {
+    case TPCCTxType::kNewOrder:
+      return {18, 12};
+    case TPCCTxType::kPayment:
+      return {3, 12};
+    case TPCCTxType::kOrderStatus:
+      return {2, 10};
+    case TPCCTxType::kDelivery:
+      return {2, 5};
+    case TPCCTxType::kStockLevel:
+      return {2, 5};
+    default:
+      return {0, 0};
+  }
+}
+
+// Think time drawn from a negative exponential distribution, truncated at
+// ten times its mean as the spec allows.
+inline double ThinkTimeSec(double mean_sec, Utils::FastRandom& r) {
+  return std::min(-std::log(1 - r.NextUniform()) * mean_sec, 10 * mean_sec);
+}
+
+// Hashed timing wheel holding the wakeups of the terminals one thread
+// emulates. Schedule and expiry are O(1); a slot keeps the timers of every
+// lap, the ones of later laps stay until their turn.
+class TimerWheel {
+ public:
+  TimerWheel(uint64_t tick_ns, uint32_t num_slots, uint64_t now_ns)
+      : tick_ns_(tick_ns),
+        slots_(num_slots),
+        current_tick_(now_ns / tick_ns) {}
+
+  void Schedule(uint64_t due_ns, uint32_t id) {
+    // never early: the first tick starting at or after due_ns; a timer in
+    // the past fires on the next Advance()
+    uint64_t tick = std::max((due_ns + tick_ns_ - 1) / tick_ns_, current_tick_);
+    slots_[tick % slots_.size()].push_back({tick, id});
+    size_++;
+  }
+
+  // Move the wheel up to now_ns, appending the ids that expired to expired.
+  void Advance(uint64_t now_ns, std::vector<uint32_t>* expired) {
+    uint64_t now_tick = now_ns / tick_ns_;
+    for (; current_tick_ <= now_tick; current_tick_++) {
+      std::vector<Timer>& slot = slots_[current_tick_ % slots_.size()];
+      size_t kept = 0;
+      for (size_t i = 0; i < slot.size(); i++) {
+        if (slot[i].tick <= current_tick_) {
+          expired->push_back(slot[i].id);
+        } else {
+          slot[kept++] = slot[i];
+        }
+      }
+      size_ -= slot.size() - kept;
+      slot.resize(kept);
+      if (size_ == 0) {
+        // nothing left to visit, jump ahead
+        current_tick_ = now_tick;
+      }
+    }
+    current_tick_ = now_tick;
+  }
+
+  // Start of the tick after the last one visited, the earliest time a new
+  // expiry is possible.
+  uint64_t NextTickNs() const { return (current_tick_ + 1) * tick_ns_; }
+  size_t Size() const { return size_; }
+
+ private:
+  struct Timer {
+    uint64_t tick;
+    uint32_t id;
+  };
+
+  uint64_t tick_ns_;
+  std::vector<std::vector<Timer>> slots_;
+  uint64_t current_tick_;
+  size_t size_ = 0;
+};
+
+}  // end of namespace TPCC
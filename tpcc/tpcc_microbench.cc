@@ -0,0 +1,382 @@
+//
+// tpcc_microbench.cc
+//
+// Created by Zacharyliu-CS on 05/25/2024.
+// Copyright (c) 2024 liuzhenm@mail.ustc.edu.cn.
+//
+// Microbenchmarks of the pieces a run is made of: record puts and gets per
+// backend and value size, the key encoders, the random generators and every
+// transaction on a loaded memorydb warehouse. Run with
+// --benchmark_repetitions and --benchmark_min_time for stable numbers and
+// compare two builds with benchmark's compare.py.
+//
+
+#include <benchmark/benchmark.h>
+#include <gflags/gflags.h>
+#include <algorithm>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "alloc_counter.h"
+#include "kv_factory.h"
+#include "schemas.h"
+#include "tpcc_tables.h"
+#include "tpcc_txn.h"
+
+namespace TPCC {
+DEFINE_string(MICROBENCH_BACKENDS, "memorydb",
+              "Comma separated backends of the record benchmarks.");
+}
+
+namespace {
+
+// keys the record benchmarks spread over
+const uint32_t kNumKeys = 100000;
+
+// An empty table per backend, shared by the record benchmarks
+TPCC::TPCCTable* EmptyTable(TPCC::DBType db_type, const std::string& name) {
+  static std::map<std::string, std::unique_ptr<TPCC::TPCCTable>> tables;
+  auto it = tables.find(name);
+  if (it == tables.end()) {
+    std::string base = TPCC::FLAGS_DB_PATH;
+    TPCC::FLAGS_DB_PATH = base + "/" + name;
+    std::filesystem::remove_all(TPCC::FLAGS_DB_PATH);
+    std::filesystem::create_directories(TPCC::FLAGS_DB_PATH);
+    it = tables.emplace(name, std::make_unique<TPCC::TPCCTable>(db_type)).first;
+    TPCC::FLAGS_DB_PATH = base;
+  }
+  return it->second.get();
+}
+
+template <typename T>
+void BM_PutRecord(benchmark::State& state, TPCC::TPCCTable* table) {
+  T value;
+  memset(&value, 'v', sizeof(T));
+  FastRandom r(1, Utils::RandomKind::kWyrand);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(table->PutRecord(r.NextBelow(kNumKeys), &value));
+  }
+  state.SetBytesProcessed(state.iterations() * sizeof(T));
+}
+
+template <typename T>
+void BM_GetRecord(benchmark::State& state, TPCC::TPCCTable* table) {
+  T value;
+  memset(&value, 'v', sizeof(T));
+  for (uint32_t key = 0; key < kNumKeys; key++) {
+    table->PutRecord(key, &value);
+  }
+  FastRandom r(1, Utils::RandomKind::kWyrand);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(table->GetRecord(r.NextBelow(kNumKeys), &value));
+  }
+  state.SetBytesProcessed(state.iterations() * sizeof(T));
+}
+
+template <typename T>
+void RegisterRecordBenchmarks(const std::string& backend,
+                              TPCC::TPCCTable* table, const char* table_name) {
+  std::string suffix = "/" + backend + "/" + table_name + "/" +
+                       std::to_string(sizeof(T));
+  benchmark::RegisterBenchmark(("BM_PutRecord" + suffix).c_str(),
+                               BM_PutRecord<T>, table);
+  benchmark::RegisterBenchmark(("BM_GetRecord" + suffix).c_str(),
+                               BM_GetRecord<T>, table);
+}
+
+// ids of a warehouse, cycling so the encoders see changing input
+struct Ids {
+  int32_t w = 1, d = 1, c = 1, o = 1, i = 1;
+  void Next() {
+    d = d % NUM_DISTRICT_PER_WAREHOUSE + 1;
+    c = c % NUM_CUSTOMER_PER_DISTRICT + 1;
+    o = o % 3000 + 1;
+    i = i % NUM_ITEM + 1;
+  }
+};
+
+void BM_MakeDistrictKey(benchmark::State& state) {
+  TPCC::TPCCTable* table = EmptyTable(TPCC::DBType::memorydb, "memorydb");
+  Ids ids;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(table->MakeDistrictKey(ids.w, ids.d));
+    ids.Next();
+  }
+}
+
+void BM_MakeCustomerKey(benchmark::State& state) {
+  TPCC::TPCCTable* table = EmptyTable(TPCC::DBType::memorydb, "memorydb");
+  Ids ids;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(table->MakeCustomerKey(ids.w, ids.d, ids.c));
+    ids.Next();
+  }
+}
+
+void BM_MakeCustomerIndexKey(benchmark::State& state) {
+  TPCC::TPCCTable* table = EmptyTable(TPCC::DBType::memorydb, "memorydb");
+  FastRandom r(1, Utils::RandomKind::kWyrand);
+  std::string last = table->GetCustomerLastName(r, 123);
+  std::string first = table->RandomStr(r, 16);
+  Ids ids;
+  for (auto _ : state) {
+    uint64_t key = table->MakeCustomerIndexKey(ids.w, ids.d, last, first);
+    benchmark::DoNotOptimize(key);
+    // the key is the address of the encoded name, freed here so the
+    // benchmark does not grow
+    delete[] reinterpret_cast<uint64_t*>(key);
+    ids.Next();
+  }
+}
+
+void BM_MakeHistoryKey(benchmark::State& state) {
+  TPCC::TPCCTable* table = EmptyTable(TPCC::DBType::memorydb, "memorydb");
+  Ids ids;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        table->MakeHistoryKey(ids.w, ids.d, ids.w, ids.d, ids.c));
+    ids.Next();
+  }
+}
+
+void BM_MakeNewOrderKey(benchmark::State& state) {
+  TPCC::TPCCTable* table = EmptyTable(TPCC::DBType::memorydb, "memorydb");
+  Ids ids;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(table->MakeNewOrderKey(ids.w, ids.d, ids.o));
+    ids.Next();
+  }
+}
+
+void BM_MakeOrderKey(benchmark::State& state) {
+  TPCC::TPCCTable* table = EmptyTable(TPCC::DBType::memorydb, "memorydb");
+  Ids ids;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(table->MakeOrderKey(ids.w, ids.d, ids.o));
+    ids.Next();
+  }
+}
+
+void BM_MakeOrderIndexKey(benchmark::State& state) {
+  TPCC::TPCCTable* table = EmptyTable(TPCC::DBType::memorydb, "memorydb");
+  Ids ids;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        table->MakeOrderIndexKey(ids.w, ids.d, ids.c, ids.o));
+    ids.Next();
+  }
+}
+
+void BM_MakeOrderLineKey(benchmark::State& state) {
+  TPCC::TPCCTable* table = EmptyTable(TPCC::DBType::memorydb, "memorydb");
+  Ids ids;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        table->MakeOrderLineKey(ids.w, ids.d, ids.o, ids.d));
+    ids.Next();
+  }
+}
+
+void BM_MakeStockKey(benchmark::State& state) {
+  TPCC::TPCCTable* table = EmptyTable(TPCC::DBType::memorydb, "memorydb");
+  Ids ids;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(table->MakeStockKey(ids.w, ids.i));
+    ids.Next();
+  }
+}
+
+void BM_RandomStr(benchmark::State& state) {
+  TPCC::TPCCTable* table = EmptyTable(TPCC::DBType::memorydb, "memorydb");
+  FastRandom r(1, Utils::RandomKind::kWyrand);
+  std::vector<char> buf(state.range(0) + 1);
+  for (auto _ : state) {
+    table->RandomStr(r, buf.data(), state.range(0));
+    benchmark::ClobberMemory();
+  }
+  state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+
+void BM_RandomNStr(benchmark::State& state) {
+  TPCC::TPCCTable* table = EmptyTable(TPCC::DBType::memorydb, "memorydb");
+  FastRandom r(1, Utils::RandomKind::kWyrand);
+  std::vector<char> buf(state.range(0) + 1);
+  for (auto _ : state) {
+    table->RandomNStr(r, buf.data(), state.range(0));
+    benchmark::ClobberMemory();
+  }
+  state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+
+void BM_NonUniformRandom(benchmark::State& state) {
+  TPCC::TPCCTable* table = EmptyTable(TPCC::DBType::memorydb, "memorydb");
+  FastRandom r(1, Utils::RandomKind::kWyrand);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        table->NonUniformRandom(r, 1023, 259, 1, NUM_CUSTOMER_PER_DISTRICT));
+  }
+}
+
+void BM_GetItemId(benchmark::State& state) {
+  TPCC::TPCCTable* table = EmptyTable(TPCC::DBType::memorydb, "memorydb");
+  FastRandom r(1, Utils::RandomKind::kWyrand);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(table->GetItemId(r));
+  }
+}
+
+void BM_WorkgenLookup(benchmark::State& state) {
+  TPCC::TPCCTable* table = EmptyTable(TPCC::DBType::memorydb, "memorydb");
+  std::vector<TPCC::TPCCTxType> workgen = table->CreateWorkgenArray();
+  FastRandom r(1, Utils::RandomKind::kWyrand);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(workgen[r.NextBelow(workgen.size())]);
+  }
+}
+
+// The distinct count of StockLevel over range(0) item ids, a few of them
+// repeated the way order lines of popular items are. The id lists are made
+// up front and cycled through.
+std::vector<std::vector<int32_t>> StockLevelItemIds(size_t n) {
+  TPCC::TPCCTable* table = EmptyTable(TPCC::DBType::memorydb, "memorydb");
+  FastRandom r(1, Utils::RandomKind::kWyrand);
+  std::vector<std::vector<int32_t>> lists(64);
+  for (auto& ids : lists) {
+    for (size_t i = 0; i < n; i++) {
+      ids.push_back(table->GetItemId(r));
+    }
+  }
+  return lists;
+}
+
+void BM_DistinctSort(benchmark::State& state) {
+  std::vector<std::vector<int32_t>> lists = StockLevelItemIds(state.range(0));
+  std::vector<int32_t> ids;
+  size_t next = 0;
+  for (auto _ : state) {
+    ids = lists[next++ % lists.size()];
+    std::sort(ids.begin(), ids.end());
+    benchmark::DoNotOptimize(std::unique(ids.begin(), ids.end()) -
+                             ids.begin());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+void BM_DistinctItemSet(benchmark::State& state) {
+  std::vector<std::vector<int32_t>> lists = StockLevelItemIds(state.range(0));
+  TPCC::DistinctItemSet seen(NUM_ITEM);
+  std::vector<int32_t> ids;
+  size_t next = 0;
+  for (auto _ : state) {
+    // same copy as the sort, which has to work on its own
+    ids = lists[next++ % lists.size()];
+    benchmark::DoNotOptimize(seen.CountDistinct(ids.data(), ids.size()));
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// Deliveries of one run: each delivers an order of every district, and a
+// fresh load has 900 undelivered ones per district, so the run stops
+// before Delivery runs out of orders and times a no-op.
+const int64_t kDeliveryIterations = 800;
+
+// One transaction type on NUM_WAREHOUSE warehouses of memorydb, loaded
+// again for every run (each repetition and each iteration-count probe) so
+// that no run starts from what another one left. Drawing the input and
+// counting its allocations is not timed. The home warehouse is drawn here,
+// PickWarehouseId() needs two warehouses at least.
+void BM_Txn(benchmark::State& state, TPCC::TPCCTxType type) {
+  auto table = std::make_unique<TPCC::TPCCTable>(TPCC::DBType::memorydb);
+  table->LoadTables();
+  TPCC::TPCCTxn txn;
+  TPCC::TxnInput input;
+  TPCC::TxnHome home;
+  FastRandom r(1, Utils::RandomKind::kWyrand);
+  auto next_input = [&]() {
+    home.warehouse_id = r.NextBelow(table->GetNumWarehouse()) + 1;
+    TPCC::TPCCTxn::Generate(table.get(), r, type, &input, home);
+  };
+  next_input();
+  uint64_t committed = 0, allocations = 0;
+  TPCC::AllocCounts before = TPCC::ReadAllocCounts();
+  for (auto _ : state) {
+    committed += txn.Execute(table.get(), input);
+    // one pause per iteration: count this one, draw the next
+    state.PauseTiming();
+    allocations += TPCC::ReadAllocCounts().allocations - before.allocations;
+    next_input();
+    before = TPCC::ReadAllocCounts();
+    state.ResumeTiming();
+  }
+  state.counters["committed"] =
+      benchmark::Counter(committed, benchmark::Counter::kIsRate);
+  state.counters["allocs_per_txn"] = benchmark::Counter(
+      allocations, benchmark::Counter::kAvgIterations);
+}
+
+}  // namespace
+
+BENCHMARK(BM_MakeDistrictKey);
+BENCHMARK(BM_MakeCustomerKey);
+BENCHMARK(BM_MakeCustomerIndexKey);
+BENCHMARK(BM_MakeHistoryKey);
+BENCHMARK(BM_MakeNewOrderKey);
+BENCHMARK(BM_MakeOrderKey);
+BENCHMARK(BM_MakeOrderIndexKey);
+BENCHMARK(BM_MakeOrderLineKey);
+BENCHMARK(BM_MakeStockKey);
+// C_LAST-sized to C_DATA-sized
+BENCHMARK(BM_RandomStr)->Arg(16)->Arg(50)->Arg(500);
+BENCHMARK(BM_RandomNStr)->Arg(9)->Arg(16);
+BENCHMARK(BM_NonUniformRandom);
+BENCHMARK(BM_GetItemId);
+BENCHMARK(BM_WorkgenLookup);
+BENCHMARK(BM_DistinctSort)->Arg(50)->Arg(150)->Arg(300);
+BENCHMARK(BM_DistinctItemSet)->Arg(50)->Arg(150)->Arg(300);
+BENCHMARK_CAPTURE(BM_Txn, new_order, TPCC::TPCCTxType::kNewOrder);
+BENCHMARK_CAPTURE(BM_Txn, payment, TPCC::TPCCTxType::kPayment);
+BENCHMARK_CAPTURE(BM_Txn, order_status, TPCC::TPCCTxType::kOrderStatus);
+BENCHMARK_CAPTURE(BM_Txn, delivery, TPCC::TPCCTxType::kDelivery)
+    ->Iterations(kDeliveryIterations);
+BENCHMARK_CAPTURE(BM_Txn, stock_level, TPCC::TPCCTxType::kStockLevel);
+
+int main(int argc, char** argv) {
+  // benchmark takes its --benchmark_* flags out first
+  benchmark::Initialize(&argc, argv);
+  // a warehouse of memorydb by default, persistent backends below /tmp
+  const std::pair<const char*, const char*> defaults[] = {
+      {"DEBUG", "false"},
+      {"NUM_WAREHOUSE", "1"},
+      {"LOAD_THREADS", "2"},
+      {"DB_PATH", "/tmp/tpcc_microbench"}};
+  for (auto& [name, value] : defaults) {
+    google::SetCommandLineOptionWithMode(name, value,
+                                         google::SET_FLAGS_DEFAULT);
+  }
+  google::ParseCommandLineFlags(&argc, &argv, true);
+
+  std::stringstream backends(TPCC::FLAGS_MICROBENCH_BACKENDS);
+  std::string name;
+  while (std::getline(backends, name, ',')) {
+    TPCC::DBType db_type;
+    if (!TPCC::ParseDBType(name, &db_type)) {
+      printf("unknown backend: %s\n", name.c_str());
+      return 1;
+    }
+    TPCC::TPCCTable* table = EmptyTable(db_type, name);
+    RegisterRecordBenchmarks<TPCC::tpcc_new_order_val_t>(name, table,
+                                                         "new_order");
+    RegisterRecordBenchmarks<TPCC::tpcc_warehouse_val_t>(name, table,
+                                                         "warehouse");
+    RegisterRecordBenchmarks<TPCC::tpcc_stock_val_t>(name, table, "stock");
+    RegisterRecordBenchmarks<TPCC::tpcc_customer_val_t>(name, table,
+                                                        "customer");
+  }
+
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
@@ -5,52 +5,185 @@
 // Copyright (c) 2023 liuzhenm@mail.ustc.edu.cn.
 //
 #include "tpcc_tables.h"
+#include <algorithm>
 #include <array>
 #include <atomic>
 #include <cstdint>
 #include <set>
+#include <sstream>
 #include <string>
 #include <vector>
 #include "config.h"
-#include "listdb_impl.h"
-#include "rocksdb_impl.h"
+#include "kv_trace.h"
+#include "numa_kv.h"
 #include "schemas.h"
-#include "memorydb_impl.h"
 
 namespace TPCC {
-TPCCTable::TPCCTable(DBType dbtype) {
+TPCCTable::TPCCTable(DBType dbtype)
+    : op_latency_(FLAGS_RECORD_LATENCY_SAMPLE),
+      hot_cold_split_(FLAGS_HOT_COLD_SPLIT),
+      partial_updates_(FLAGS_PARTIAL_UPDATES),
+      item_sets_(new std::unique_ptr<DistinctItemSet>[Utils::kMaxThreads]) {
   num_warehouse_ = FLAGS_NUM_WAREHOUSE;
   num_district_per_warehouse_ = NUM_DISTRICT_PER_WAREHOUSE;
   num_customer_per_district_ = NUM_CUSTOMER_PER_DISTRICT;
   num_item_ = NUM_ITEM;
   num_stock_per_warehouse_ = NUM_STOCK_PER_WAREHOUSE;
-  switch (dbtype) {
-    case DBType::memorydb: 
-      kv_impl = new MemoryDBImpl();
-      break;
-    case DBType::rocksdb:
-      kv_impl = new RocksDBImpl(FLAGS_DB_PATH);
-      break;
-    case DBType::listdb:
-      kv_impl = new ListDBImpl(FLAGS_DB_PATH);
-      break;
+  customer_id_nurand_ =
+      NURandParams(1023, 259, 1, num_customer_per_district_);
+  item_id_nurand_ = NURandParams(8191, 7911, 1, num_item_);
+  last_name_load_nurand_ = NURandParams(255, 157, 0, 999);
+  last_name_run_nurand_ = NURandParams(255, 223, 0, 999);
+  if (FLAGS_NUMA_DB_PATHS.empty()) {
+    kv_impl = NewKV(dbtype);
+  } else {
+    std::vector<std::string> db_paths;
+    std::stringstream paths(FLAGS_NUMA_DB_PATHS);
+    std::string path;
+    while (std::getline(paths, path, ',')) {
+      db_paths.push_back(path);
+    }
+    kv_impl = new NumaKV(dbtype, db_paths, num_warehouse_,
+                         [this](uint64_t key) { return KeyToWarehouse(key); });
+  }
+  if (!FLAGS_KV_TRACE_FILE.empty()) {
+    kv_impl = new TracingKV(kv_impl, FLAGS_KV_TRACE_FILE);
+  }
+  if (FLAGS_STOCK_QUANTITY_COLUMN) {
+    stock_quantity_column_.Init(num_warehouse_, num_item_);
+  }
+  next_delivery_.reset(new std::atomic<int32_t>[num_warehouse_ *
+                                                num_district_per_warehouse_]);
+}
+// seeds of the populate steps, recorded in the load manifest
+static const uint64_t kWarehouseSeed = 9324;
+static const uint64_t kDistrictSeed = 129856349;
+static const uint64_t kCustomerSeed = 923587856425;
+static const uint64_t kOrderSeed = 2343352;
+static const uint64_t kItemSeed = 235443;
+static const uint64_t kStockSeed = 89785943;
+
+uint32_t TPCCTable::KeyToWarehouse(uint64_t table_key) {
+  int64_t key = int64_t(table_key & ((1ULL << 56) - 1));
+  switch (static_cast<TPCCTableType>(table_key >> 56)) {
+    case TPCCTableType::kWarehouseTable:
+      return uint32_t(key);
+    case TPCCTableType::kDistrictTable:
+      return DistrictKeyToWare(key);
+    case TPCCTableType::kCustomerTable:
+    case TPCCTableType::kCustomerHotTable:
+    case TPCCTableType::kCustomerColdTable:
+      return CustomerKeyToWare(key);
+    case TPCCTableType::kHistoryTable:
+      return HistoryKeyToWare(key);
+    case TPCCTableType::kNewOrderTable:
+    case TPCCTableType::kOrderTable:
+      return OrderKeyToWare(key);
+    case TPCCTableType::kOrderLineTable:
+      return OrderLineKeyToWare(key);
+    case TPCCTableType::kStockTable:
+    case TPCCTableType::kStockHotTable:
+    case TPCCTableType::kStockColdTable:
+      return StockKeyToWare(key);
+    case TPCCTableType::kOrderIndexTable:
+      return OrderIndexKeyToWare(key);
     default:
-      kv_impl = new MemoryDBImpl();
+      return 0;
   }
-
 }
+
 void TPCCTable::LoadTables() {
   LOG("num_warehouse_ = ", num_warehouse_,
       ", num_district_per_warehouse_ = ", num_district_per_warehouse_,
       ", num_customer_per_district_ = " , num_customer_per_district_, "\n");
 
-  PopulateWarehouseTable(9324);
-  PopulateDistrictTable(129856349);
-  PopulateCustomerAndHistoryTable(923587856425);
-  PopulateOrderNewOrderAndOrderLineTable(2343352);
-  PopulateStockTable(89785943);
-  PopulateItemTable(235443);
-  PopulateStockTable(89785943);
+  uint32_t load_threads = std::min<uint32_t>(
+      std::max(FLAGS_LOAD_THREADS, 1), num_warehouse_);
+  if (load_threads > 1) {
+    load_pool_.reset(new CW::ThreadPool(load_threads));
+  }
+
+  PopulateWarehouseTable(kWarehouseSeed);
+  PopulateDistrictTable(kDistrictSeed);
+  PopulateCustomerAndHistoryTable(kCustomerSeed);
+  PopulateOrderNewOrderAndOrderLineTable(kOrderSeed);
+  PopulateStockTable(kStockSeed);
+  PopulateItemTable(kItemSeed);
+  PopulateStockTable(kStockSeed);
+  load_pool_.reset();
+}
+
+KVBulkWriter* TPCCTable::NewLoadWriter(TPCCTableType table) {
+  if (!FLAGS_BULK_LOAD) {
+    return new KVPutWriter(kv_impl);
+  }
+  // the index keys are not generated in order
+  bool sorted = table != TPCCTableType::kCustomerIndexTable &&
+                table != TPCCTableType::kOrderIndexTable;
+  return kv_impl->NewBulkWriter(sorted);
+}
+
+int TPCCTable::FinishLoad(LoadBatch& batch) {
+  int ret = 1;
+  for (auto& writer : batch.writers) {
+    if (writer && writer->Finish() != 1) {
+      ret = -1;
+    }
+    writer.reset();
+  }
+  return ret;
+}
+
+void TPCCTable::ForEachWarehouse(const std::function<void(uint32_t)>& fn) {
+  if (!load_pool_) {
+    for (uint32_t w_id = 1; w_id <= num_warehouse_; w_id++) {
+      fn(w_id);
+    }
+    return;
+  }
+  for (uint32_t w_id = 1; w_id <= num_warehouse_; w_id++) {
+    load_pool_->push_task(fn, w_id);
+  }
+  load_pool_->wait_for_tasks();
+}
+
+LoadManifest TPCCTable::ExpectedLoad() {
+  LoadManifest manifest;
+  manifest.num_warehouse = FLAGS_NUM_WAREHOUSE;
+  manifest.num_district_per_warehouse = NUM_DISTRICT_PER_WAREHOUSE;
+  manifest.num_customer_per_district = NUM_CUSTOMER_PER_DISTRICT;
+  manifest.num_item = NUM_ITEM;
+  manifest.num_stock_per_warehouse = NUM_STOCK_PER_WAREHOUSE;
+  manifest.seeds = {kWarehouseSeed, kDistrictSeed, kCustomerSeed,
+                    kOrderSeed,     kItemSeed,     kStockSeed};
+  manifest.hot_cold_split = FLAGS_HOT_COLD_SPLIT;
+  return manifest;
+}
+
+LoadManifest TPCCTable::GetLoadManifest() {
+  LoadManifest manifest = ExpectedLoad();
+  TableRecordCounts counts = record_stats_.Collect();
+  for (size_t i = 0; i < counts.size(); i++) {
+    manifest.table_records[i] = counts[i].loads + counts[i].puts;
+    manifest.total_records += manifest.table_records[i];
+  }
+  return manifest;
+}
+
+uint64_t TPCCTable::GetLoadRecordCount() {
+  uint64_t records = 0;
+  for (const RecordCounts& c : record_stats_.Collect()) {
+    records += c.loads + c.puts;
+  }
+  return records;
+}
+
+uint64_t TPCCTable::GetReadRecordCount() {
+  uint64_t records = 0;
+  for (const RecordCounts& c : record_stats_.Collect()) {
+    records += c.gets;
+  }
+  return records;
 }
 std::vector<TPCCTxType> TPCCTable::CreateWorkgenArray() {
   std::vector<TPCCTxType> workgen_arr(100);
@@ -84,6 +217,7 @@ void TPCCTable::PopulateWarehouseTable(unsigned long seed) {
   int total_warehouse_records_inserted = 0,
       total_warehouse_records_examined = 0;
   FastRandom random_generator(seed);
+  LoadBatch batch;
   // populate warehouse table
   for (uint32_t w_id = 1; w_id <= num_warehouse_; w_id++) {
     tpcc_warehouse_key_t warehouse_key;
@@ -97,46 +231,42 @@ void TPCCTable::PopulateWarehouseTable(unsigned long seed) {
     //  W_YTD = sum(H_AMOUNT) where (W_ID = H_W_ID).
     warehouse_val.w_tax =
         (float)RandomNumber(random_generator, 0, 2000) / 10000.0;
-    strcpy(
-        warehouse_val.w_name,
-        RandomStr(random_generator,
-                  RandomNumber(random_generator, tpcc_warehouse_val_t::MIN_NAME,
-                               tpcc_warehouse_val_t::MAX_NAME))
-            .c_str());
-    strcpy(warehouse_val.w_street_1,
-           RandomStr(random_generator,
-                     RandomNumber(random_generator, Address::MIN_STREET,
-                                  Address::MAX_STREET))
-               .c_str());
-    strcpy(warehouse_val.w_street_2,
-           RandomStr(random_generator,
-                     RandomNumber(random_generator, Address::MIN_STREET,
-                                  Address::MAX_STREET))
-               .c_str());
-    strcpy(warehouse_val.w_city,
-           RandomStr(random_generator,
-                     RandomNumber(random_generator, Address::MIN_CITY,
-                                  Address::MAX_CITY))
-               .c_str());
-    strcpy(warehouse_val.w_state,
-           RandomStr(random_generator, Address::STATE).c_str());
+    RandomStr(random_generator, warehouse_val.w_name,
+              RandomNumber(random_generator, tpcc_warehouse_val_t::MIN_NAME,
+                           tpcc_warehouse_val_t::MAX_NAME));
+    RandomStr(random_generator, warehouse_val.w_street_1,
+              RandomNumber(random_generator, Address::MIN_STREET,
+                           Address::MAX_STREET));
+    RandomStr(random_generator, warehouse_val.w_street_2,
+              RandomNumber(random_generator, Address::MIN_STREET,
+                           Address::MAX_STREET));
+    RandomStr(random_generator, warehouse_val.w_city,
+              RandomNumber(random_generator, Address::MIN_CITY,
+                           Address::MAX_CITY));
+    RandomStr(random_generator, warehouse_val.w_state, Address::STATE);
     strcpy(warehouse_val.w_zip, "123456789");
 
     assert(warehouse_val.w_state[2] == '\0' &&
            strcmp(warehouse_val.w_zip, "123456789") == 0);
     total_warehouse_records_inserted +=
-        PutRecord(warehouse_key.item_key, &warehouse_val);
+        LoadRecord(batch, warehouse_key.item_key, &warehouse_val);
     total_warehouse_records_examined++;
   }
+  if (FinishLoad(batch) != 1) {
+    LOG("load warehouse table failed");
+    abort();
+  }
   LOG("total_warehouse_records_inserted = ", total_warehouse_records_inserted,
       ", total_warehouse_records_examined = ", total_warehouse_records_examined,
       "\n");
 }
 
 void TPCCTable::PopulateDistrictTable(unsigned long seed) {
-  int total_district_records_inserted = 0, total_district_records_examined = 0;
-  FastRandom random_generator(seed);
-  for (uint32_t w_id = 1; w_id <= num_warehouse_; w_id++) {
+  std::atomic<int> total_district_records_inserted(0),
+      total_district_records_examined(0);
+  ForEachWarehouse([&](uint32_t w_id) {
+    FastRandom random_generator(WarehouseSeed(seed, w_id));
+    LoadBatch batch;
     for (uint32_t d_id = 1; d_id <= num_district_per_warehouse_; d_id++) {
       tpcc_district_key_t district_key;
       district_key.d_id = MakeDistrictKey(w_id, d_id);
@@ -154,52 +284,50 @@ void TPCCTable::PopulateDistrictTable(unsigned long seed) {
       //  NOTICE:: scale should check consistency requirements.
       //  D_NEXT_O_ID - 1 = max(O_ID) = max(NO_O_ID)
 
-      strcpy(district_val.d_name,
-             RandomStr(
-                 random_generator,
-                 RandomNumber(random_generator, tpcc_district_val_t::MIN_NAME,
-                              tpcc_district_val_t::MAX_NAME))
-                 .c_str());
-      strcpy(district_val.d_street_1,
-             RandomStr(random_generator,
-                       RandomNumber(random_generator, Address::MIN_STREET,
-                                    Address::MAX_STREET))
-                 .c_str());
-      strcpy(district_val.d_street_2,
-             RandomStr(random_generator,
-                       RandomNumber(random_generator, Address::MIN_STREET,
-                                    Address::MAX_STREET))
-                 .c_str());
-      strcpy(district_val.d_city,
-             RandomStr(random_generator,
-                       RandomNumber(random_generator, Address::MIN_CITY,
-                                    Address::MAX_CITY))
-                 .c_str());
-      strcpy(district_val.d_state,
-             RandomStr(random_generator, Address::STATE).c_str());
+      RandomStr(random_generator, district_val.d_name,
+                RandomNumber(random_generator, tpcc_district_val_t::MIN_NAME,
+                             tpcc_district_val_t::MAX_NAME));
+      RandomStr(random_generator, district_val.d_street_1,
+                RandomNumber(random_generator, Address::MIN_STREET,
+                             Address::MAX_STREET));
+      RandomStr(random_generator, district_val.d_street_2,
+                RandomNumber(random_generator, Address::MIN_STREET,
+                             Address::MAX_STREET));
+      RandomStr(random_generator, district_val.d_city,
+                RandomNumber(random_generator, Address::MIN_CITY,
+                             Address::MAX_CITY));
+      RandomStr(random_generator, district_val.d_state, Address::STATE);
       strcpy(district_val.d_zip, "123456789");
 
       total_district_records_inserted +=
-          PutRecord(district_key.item_key, &district_val);
+          LoadRecord(batch, district_key.item_key, &district_val);
       total_district_records_examined++;
     }
-  }
-  LOG("total_district_records_inserted = ", total_district_records_inserted,
-      ", total_district_records_examined = ", total_district_records_examined,
+    if (FinishLoad(batch) != 1) {
+      LOG("load district table failed, w_id = ", w_id);
+      abort();
+    }
+  });
+  LOG("total_district_records_inserted = ",
+      total_district_records_inserted.load(),
+      ", total_district_records_examined = ",
+      total_district_records_examined.load(),
       "\n");
 }
 
 void TPCCTable::PopulateCustomerAndHistoryTable(unsigned long seed) {
-  int total_customer_records_inserted = 0, total_customer_records_examined = 0;
-  int total_customer_index_records_inserted = 0,
-      total_customer_index_records_examined = 0;
-  int total_history_records_inserted = 0, total_history_records_examined = 0;
+  std::atomic<int> total_customer_records_inserted(0),
+      total_customer_records_examined(0);
+  std::atomic<int> total_customer_index_records_inserted(0),
+      total_customer_index_records_examined(0);
+  std::atomic<int> total_history_records_inserted(0),
+      total_history_records_examined(0);
   // printf("total_customer_records_inserted = %d,
   // total_customer_records_examined = %d\n",
   //        total_customer_records_inserted, total_customer_records_examined);
-  FastRandom random_generator(seed);
-
-  for (uint32_t w_id = 1; w_id <= num_warehouse_; w_id++) {
+  ForEachWarehouse([&](uint32_t w_id) {
+    FastRandom random_generator(WarehouseSeed(seed, w_id));
+    LoadBatch batch;
     for (uint32_t d_id = 1; d_id <= num_district_per_warehouse_; d_id++) {
       for (uint32_t c_id = 1; c_id <= num_customer_per_district_; c_id++) {
         tpcc_customer_key_t customer_key;
@@ -233,37 +361,26 @@ void TPCCTable::PopulateCustomerAndHistoryTable(unsigned long seed) {
         customer_val.c_ytd_payment = 10;
         customer_val.c_payment_cnt = 1;
         customer_val.c_delivery_cnt = 0;
-        strcpy(customer_val.c_street_1,
-               RandomStr(random_generator,
-                         RandomNumber(random_generator, Address::MIN_STREET,
-                                      Address::MAX_STREET))
-                   .c_str());
-        strcpy(customer_val.c_street_2,
-               RandomStr(random_generator,
-                         RandomNumber(random_generator, Address::MIN_STREET,
-                                      Address::MAX_STREET))
-                   .c_str());
-        strcpy(customer_val.c_city,
-               RandomStr(random_generator,
-                         RandomNumber(random_generator, Address::MIN_CITY,
-                                      Address::MAX_CITY))
-                   .c_str());
-        strcpy(customer_val.c_state,
-               RandomStr(random_generator, Address::STATE).c_str());
-        strcpy(customer_val.c_zip,
-               (RandomNStr(random_generator, 4) + "11111").c_str());
-
-        strcpy(
-            customer_val.c_phone,
-            RandomNStr(random_generator, tpcc_customer_val_t::PHONE).c_str());
-        customer_val.c_since = GetCurrentTimeMillis();
+        RandomStr(random_generator, customer_val.c_street_1,
+                  RandomNumber(random_generator, Address::MIN_STREET,
+                               Address::MAX_STREET));
+        RandomStr(random_generator, customer_val.c_street_2,
+                  RandomNumber(random_generator, Address::MIN_STREET,
+                               Address::MAX_STREET));
+        RandomStr(random_generator, customer_val.c_city,
+                  RandomNumber(random_generator, Address::MIN_CITY,
+                               Address::MAX_CITY));
+        RandomStr(random_generator, customer_val.c_state, Address::STATE);
+        RandomNStr(random_generator, customer_val.c_zip, 4);
+        strcpy(customer_val.c_zip + 4, "11111");
+
+        RandomNStr(random_generator, customer_val.c_phone,
+                   tpcc_customer_val_t::PHONE);
+        customer_val.c_since = LoadTimestamp(w_id, d_id, c_id);
         strcpy(customer_val.c_middle, "OE");
-        strcpy(customer_val.c_data,
-               RandomStr(
-                   random_generator,
-                   RandomNumber(random_generator, tpcc_customer_val_t::MIN_DATA,
-                                tpcc_customer_val_t::MAX_DATA))
-                   .c_str());
+        RandomStr(random_generator, customer_val.c_data,
+                  RandomNumber(random_generator, tpcc_customer_val_t::MIN_DATA,
+                               tpcc_customer_val_t::MAX_DATA));
 
         assert(!strcmp(customer_val.c_credit, "BC") ||
                !strcmp(customer_val.c_credit, "GC"));
@@ -271,7 +388,7 @@ void TPCCTable::PopulateCustomerAndHistoryTable(unsigned long seed) {
         // printf("before insert customer record\n");
 
         total_customer_records_inserted +=
-            PutRecord(customer_key.item_key, &customer_val);
+            LoadSplitRecord(batch, customer_key.item_key, &customer_val);
         total_customer_records_examined++;
 
         // printf("total_customer_records_inserted = %d,
@@ -291,56 +408,64 @@ void TPCCTable::PopulateCustomerAndHistoryTable(unsigned long seed) {
         if (r == -1) {
           customer_index_val.c_id = customer_key.c_id;
           total_customer_index_records_inserted +=
-              PutRecord(customer_index_key.item_key, &customer_index_val);
+              LoadRecord(batch, customer_index_key.item_key,
+                         &customer_index_val);
           total_customer_index_records_examined++;
         }
 
         tpcc_history_key_t history_key;
         history_key.h_id = MakeHistoryKey(w_id, d_id, w_id, d_id, c_id);
         tpcc_history_val_t history_val;
-        history_val.h_date = GetCurrentTimeMillis();
+        history_val.h_date = LoadTimestamp(w_id, d_id, c_id);
         history_val.h_amount = 10;
-        strcpy(history_val.h_data,
-               RandomStr(
-                   random_generator,
-                   RandomNumber(random_generator, tpcc_history_val_t::MIN_DATA,
-                                tpcc_history_val_t::MAX_DATA))
-                   .c_str());
+        RandomStr(random_generator, history_val.h_data,
+                  RandomNumber(random_generator, tpcc_history_val_t::MIN_DATA,
+                               tpcc_history_val_t::MAX_DATA));
 
         total_history_records_inserted +=
-            PutRecord(history_key.item_key, &history_val);
+            LoadRecord(batch, history_key.item_key, &history_val);
         total_history_records_examined++;
         // printf("total_history_records_inserted = %d,
         // total_history_records_examined = %d\n",
         // total_history_records_inserted, total_history_records_examined);
       }
     }
-  }
-  LOG("total_customer_records_inserted = ", total_customer_records_inserted,
-      ", total_customer_records_examined = ", total_customer_records_examined,
+    if (FinishLoad(batch) != 1) {
+      LOG("load customer and history table failed, w_id = ", w_id);
+      abort();
+    }
+  });
+  LOG("total_customer_records_inserted = ",
+      total_customer_records_inserted.load(),
+      ", total_customer_records_examined = ",
+      total_customer_records_examined.load(),
       "\n");
   LOG("total_customer_index_records_inserted = ",
-      total_customer_index_records_inserted,
+      total_customer_index_records_inserted.load(),
       ", total_customer_index_records_examined = ",
-      total_customer_index_records_examined, "\n");
+      total_customer_index_records_examined.load(), "\n");
 
-  LOG("total_history_records_inserted = ", total_history_records_inserted,
-      ", total_history_records_examined = ", total_history_records_examined,
+  LOG("total_history_records_inserted = ",
+      total_history_records_inserted.load(),
+      ", total_history_records_examined = ",
+      total_history_records_examined.load(),
       "\n");
 }
 
 void TPCCTable::PopulateOrderNewOrderAndOrderLineTable(unsigned long seed) {
-  uint64_t total_order_records_inserted = 0, total_order_records_examined = 0;
-  uint64_t total_order_index_records_inserted = 0,
-           total_order_index_records_examined = 0;
-  uint64_t total_new_order_records_inserted = 0,
-           total_new_order_records_examined = 0;
-  uint64_t total_order_line_records_inserted = 0,
-           total_order_line_records_examined = 0;
-  FastRandom random_generator(seed);
+  std::atomic<uint64_t> total_order_records_inserted(0),
+      total_order_records_examined(0);
+  std::atomic<uint64_t> total_order_index_records_inserted(0),
+      total_order_index_records_examined(0);
+  std::atomic<uint64_t> total_new_order_records_inserted(0),
+      total_new_order_records_examined(0);
+  std::atomic<uint64_t> total_order_line_records_inserted(0),
+      total_order_line_records_examined(0);
   // printf("total_order_records_inserted = %d, total_order_records_examined =
   // %d\n", total_order_records_inserted, total_order_records_examined);
-  for (uint32_t w_id = 1; w_id <= num_warehouse_; w_id++) {
+  ForEachWarehouse([&](uint32_t w_id) {
+    FastRandom random_generator(WarehouseSeed(seed, w_id));
+    LoadBatch batch;
     for (uint32_t d_id = 1; d_id <= num_district_per_warehouse_; d_id++) {
       std::set<uint32_t> c_ids_s;
       std::vector<uint32_t> c_ids;
@@ -352,6 +477,8 @@ void TPCCTable::PopulateOrderNewOrderAndOrderLineTable(unsigned long seed) {
         c_ids_s.insert(x);
         c_ids.emplace_back(x);
       }
+      // delivered next, the first order with a NEW-ORDER row
+      int32_t next_delivery = int32_t(num_customer_per_district_) + 1;
       for (uint32_t c = 1; c <= num_customer_per_district_; c++) {
         tpcc_order_key_t order_key;
         order_key.o_id = MakeOrderKey(w_id, d_id, c);
@@ -369,10 +496,10 @@ void TPCCTable::PopulateOrderNewOrderAndOrderLineTable(unsigned long seed) {
                          tpcc_order_line_val_t::MAX_OL_CNT);
 
         order_val.o_all_local = 1;
-        order_val.o_entry_d = GetCurrentTimeMillis();
+        order_val.o_entry_d = LoadTimestamp(w_id, d_id, c);
 
         total_order_records_inserted +=
-            PutRecord(order_key.item_key, &order_val);
+            LoadRecord(batch, order_key.item_key, &order_val);
         total_order_records_examined++;
         // printf("total_order_records_inserted = %d,
         // total_order_records_examined = %d\n", total_order_records_inserted,
@@ -390,7 +517,7 @@ void TPCCTable::PopulateOrderNewOrderAndOrderLineTable(unsigned long seed) {
           order_index_val.o_id = order_key.o_id;
           order_index_val.debug_magic = tpcc_add_magic;
           total_order_index_records_inserted +=
-              PutRecord(order_index_key.item_key, &order_index_val);
+              LoadRecord(batch, order_index_key.item_key, &order_index_val);
           total_order_index_records_examined++;
         }
 
@@ -406,8 +533,9 @@ void TPCCTable::PopulateOrderNewOrderAndOrderLineTable(unsigned long seed) {
           tpcc_new_order_val_t new_order_val;
           new_order_val.debug_magic = tpcc_add_magic;
           total_new_order_records_inserted +=
-              PutRecord(new_order_key.item_key, &new_order_val);
+              LoadRecord(batch, new_order_key.item_key, &new_order_val);
           total_new_order_records_examined++;
+          next_delivery = std::min(next_delivery, int32_t(c));
         }
         for (uint32_t l = 1; l <= uint32_t(order_val.o_ol_cnt); l++) {
           tpcc_order_line_key_t order_line_key;
@@ -434,30 +562,40 @@ void TPCCTable::PopulateOrderNewOrderAndOrderLineTable(unsigned long seed) {
           assert(order_line_val.ol_i_id >= 1 &&
                  static_cast<size_t>(order_line_val.ol_i_id) <= num_item_);
           total_order_line_records_inserted +=
-              PutRecord(order_line_key.item_key, &order_line_val);
+              LoadRecord(batch, order_line_key.item_key, &order_line_val);
           total_order_line_records_examined++;
         }
       }
+      next_delivery_[DistrictIndex(w_id, d_id)].store(next_delivery);
     }
-  }
-  LOG("total_order_records_inserted = ", total_order_records_inserted,
-      ", total_order_records_examined = ", total_order_records_examined);
+    if (FinishLoad(batch) != 1) {
+      LOG("load order table failed, w_id = ", w_id);
+      abort();
+    }
+  });
+  next_delivery_loaded_ = true;
+  LOG("total_order_records_inserted = ", total_order_records_inserted.load(),
+      ", total_order_records_examined = ",
+      total_order_records_examined.load());
   LOG("total_order_index_records_inserted = ",
-      total_order_index_records_inserted,
+      total_order_index_records_inserted.load(),
       ", total_order_index_records_examined = ",
-      total_order_index_records_examined);
-  LOG("total_new_order_records_inserted = ", total_new_order_records_inserted,
+      total_order_index_records_examined.load());
+  LOG("total_new_order_records_inserted = ",
+      total_new_order_records_inserted.load(),
       ", total_new_order_records_examined = ",
-      total_new_order_records_examined);
-  LOG("total_order_line_records_inserted = ", total_order_line_records_inserted,
+      total_new_order_records_examined.load());
+  LOG("total_order_line_records_inserted = ",
+      total_order_line_records_inserted.load(),
       ", total_order_line_records_examined = ",
-      total_order_line_records_examined);
+      total_order_line_records_examined.load());
 }
 
 void TPCCTable::PopulateItemTable(unsigned long seed) {
   int total_item_records_inserted = 0, total_item_records_examined = 0;
 
   FastRandom random_generator(seed);
+  LoadBatch batch;
   for (int64_t i_id = 1; i_id <= num_item_; i_id++) {
     tpcc_item_key_t item_key;
     item_key.i_id = i_id;
@@ -465,23 +603,19 @@ void TPCCTable::PopulateItemTable(unsigned long seed) {
     /* Initialize the item payload */
     tpcc_item_val_t item_val;
 
-    strcpy(item_val.i_name,
-           RandomStr(random_generator,
-                     RandomNumber(random_generator, tpcc_item_val_t::MIN_NAME,
-                                  tpcc_item_val_t::MAX_NAME))
-               .c_str());
+    RandomStr(random_generator, item_val.i_name,
+              RandomNumber(random_generator, tpcc_item_val_t::MIN_NAME,
+                           tpcc_item_val_t::MAX_NAME));
     item_val.i_price =
         (float)(RandomNumber(random_generator, 100, 10000) / 100.0);
     const int len = RandomNumber(random_generator, tpcc_item_val_t::MIN_DATA,
                                  tpcc_item_val_t::MAX_DATA);
     if (RandomNumber(random_generator, 1, 100) > 10) {
-      strcpy(item_val.i_data, RandomStr(random_generator, len).c_str());
+      RandomStr(random_generator, item_val.i_data, len);
     } else {
       const int startOriginal = RandomNumber(random_generator, 2, (len - 8));
-      const std::string i_data =
-          RandomStr(random_generator, startOriginal) + "ORIGINAL" +
-          RandomStr(random_generator, len - startOriginal - 8);
-      strcpy(item_val.i_data, i_data.c_str());
+      RandomStr(random_generator, item_val.i_data, len);
+      memcpy(item_val.i_data + startOriginal, "ORIGINAL", 8);
     }
     item_val.i_im_id = RandomNumber(random_generator, tpcc_item_val_t::MIN_IM,
                                     tpcc_item_val_t::MAX_IM);
@@ -489,23 +623,30 @@ void TPCCTable::PopulateItemTable(unsigned long seed) {
     // check item price
     assert(item_val.i_price >= 1.0 && item_val.i_price <= 100.0);
 
-    total_item_records_inserted += PutRecord(item_key.item_key, &item_val);
+    total_item_records_inserted +=
+        LoadRecord(batch, item_key.item_key, &item_val);
     total_item_records_examined++;
   }
+  if (FinishLoad(batch) != 1) {
+    LOG("load item table failed");
+    abort();
+  }
   printf("total_item_records_inserted = %d, total_item_records_examined = %d\n",
          total_item_records_inserted, total_item_records_examined);
 }
 
 void TPCCTable::PopulateStockTable(unsigned long seed) {
-  int total_stock_records_inserted = 0, total_stock_records_examined = 0;
-  for (uint32_t w_id = 1; w_id <= num_warehouse_; w_id++) {
+  std::atomic<int> total_stock_records_inserted(0),
+      total_stock_records_examined(0);
+  ForEachWarehouse([&](uint32_t w_id) {
+    FastRandom random_generator(WarehouseSeed(seed, w_id));
+    LoadBatch batch;
     for (uint32_t i_id = 1; i_id <= num_item_; i_id++) {
       tpcc_stock_key_t stock_key;
       stock_key.s_id = MakeStockKey(w_id, i_id);
 
       /* Initialize the stock payload */
       tpcc_stock_val_t stock_val;
-      FastRandom random_generator(seed);
       stock_val.s_quantity = RandomNumber(random_generator, 10, 100);
       stock_val.s_ytd = 0;
       stock_val.s_order_cnt = 0;
@@ -514,23 +655,93 @@ void TPCCTable::PopulateStockTable(unsigned long seed) {
       const int len = RandomNumber(random_generator, tpcc_stock_val_t::MIN_DATA,
                                    tpcc_stock_val_t::MAX_DATA);
       if (RandomNumber(random_generator, 1, 100) > 10) {
-        const std::string s_data = RandomStr(random_generator, len);
-        strcpy(stock_val.s_data, s_data.c_str());
+        RandomStr(random_generator, stock_val.s_data, len);
       } else {
         const int startOriginal = RandomNumber(random_generator, 2, (len - 8));
-        const std::string s_data =
-            RandomStr(random_generator, startOriginal) + "ORIGINAL" +
-            RandomStr(random_generator, len - startOriginal - 8);
-        strcpy(stock_val.s_data, s_data.c_str());
+        RandomStr(random_generator, stock_val.s_data, len);
+        memcpy(stock_val.s_data + startOriginal, "ORIGINAL", 8);
       }
 
       stock_val.debug_magic = tpcc_add_magic;
-      total_stock_records_inserted += PutRecord(stock_key.item_key, &stock_val);
+      total_stock_records_inserted +=
+          LoadSplitRecord(batch, stock_key.item_key, &stock_val);
+      if (stock_quantity_column_.Enabled()) {
+        stock_quantity_column_.Set(w_id, i_id, stock_val.s_quantity);
+      }
       total_stock_records_examined++;
     }
+    if (FinishLoad(batch) != 1) {
+      LOG("load stock table failed, w_id = ", w_id);
+      abort();
+    }
+  });
+  LOG("total_stock_records_inserted = ", total_stock_records_inserted.load(),
+      " total_stock_records_examined = ", total_stock_records_examined.load(),
+      "\n");
+  stock_quantity_column_loaded_ = true;
+}
+
+void TPCCTable::FillStockQuantityColumn() {
+  if (!stock_quantity_column_.Enabled() || stock_quantity_column_loaded_) {
+    return;
+  }
+  // straight from the kv, these reads are not part of the run
+  std::string value;
+  for (uint32_t w_id = 1; w_id <= num_warehouse_; w_id++) {
+    for (uint32_t i_id = 1; i_id <= num_item_; i_id++) {
+      tpcc_stock_key_t stock_key;
+      stock_key.s_id = MakeStockKey(w_id, i_id);
+      // s_quantity is the first field of both layouts
+      itemkey_t key =
+          hot_cold_split_
+              ? TableKey<tpcc_stock_hot_val_t>(stock_key.item_key)
+              : TableKey<tpcc_stock_val_t>(stock_key.item_key);
+      if (kv_impl->Get(key, value) != 1 || value.size() < sizeof(int32_t)) {
+        LOG("fill stock quantity column failed, w_id = ", w_id,
+            ", i_id = ", i_id);
+        abort();
+      }
+      int32_t s_quantity;
+      memcpy(&s_quantity, value.data(), sizeof(s_quantity));
+      stock_quantity_column_.Set(w_id, i_id, s_quantity);
+    }
+  }
+  stock_quantity_column_loaded_ = true;
+}
+
+void TPCCTable::FindNextDeliveries() {
+  if (next_delivery_loaded_) {
+    return;
+  }
+  // the first NEW-ORDER row below D_NEXT_O_ID, probed straight from the kv
+  std::string value;
+  for (uint32_t w_id = 1; w_id <= num_warehouse_; w_id++) {
+    for (uint32_t d_id = 1; d_id <= num_district_per_warehouse_; d_id++) {
+      tpcc_district_key_t dist_key;
+      dist_key.d_id = MakeDistrictKey(w_id, d_id);
+      if (kv_impl->Get(TableKey<tpcc_district_val_t>(dist_key.item_key),
+                       value) != 1 ||
+          value.size() < sizeof(tpcc_district_val_t)) {
+        LOG("find next delivery failed, w_id = ", w_id, ", d_id = ", d_id);
+        abort();
+      }
+      tpcc_district_val_t dist_val;
+      memcpy(&dist_val, value.data(), sizeof(dist_val));
+      int32_t o_id = 1;
+      for (; o_id < dist_val.d_next_o_id; o_id++) {
+        tpcc_new_order_key_t norder_key;
+        norder_key.no_id = MakeNewOrderKey(w_id, d_id, o_id);
+        if (kv_impl->Get(
+                TableKey<tpcc_new_order_val_t>(norder_key.item_key), value) ==
+                1 &&
+            value.size() >= sizeof(tpcc_new_order_val_t)) {
+          break;
+        }
+      }
+      next_delivery_[DistrictIndex(w_id, d_id)].store(o_id);
+    }
   }
-  LOG("total_stock_records_inserted = ", total_stock_records_inserted,
-      " total_stock_records_examined = ", total_stock_records_examined, "\n");
+  next_delivery_loaded_ = true;
 }
 
-}  // namespace TPCC
\ No newline at end of file
+}  // namespace TPCC
@@ -9,20 +9,23 @@
 #include <array>
 #include <atomic>
 #include <cstring>
+#include <functional>
+#include <memory>
+#include "coroutine.h"
+#include "distinct_items.h"
+#include "kv_factory.h"
 #include "kv_interface.h"
+#include "op_latency.h"
+#include "record_stats.h"
 #include "schemas.h"
 #include "config.h"
+#include "snapshot.h"
+#include "stock_quantity_column.h"
+#include "thread_pool.h"
+#include "txn_arena.h"
 
 namespace TPCC {
 
-enum class DBType: uint8_t{
-  memorydb = 0,
-  rocksdb,
-  listdb,
-  neopmkv,
-};
-
-
 class TPCCTable {
  private:
   // Pre-defined constants, which will be modified for tests
@@ -34,8 +37,57 @@ class TPCCTable {
 
   KVInterface* kv_impl = nullptr;
 
-  std::atomic_uint64_t write_record_count_ = 0;
-  std::atomic_uint64_t read_record_count_ = 0;
+  // NURand(A, x, y) with C and the range fixed for the run, see
+  // NonUniformRandom()
+  struct NURandParams {
+    int A = 0, C = 0, min = 0, max = 0;
+    Utils::FastMod range;
+    NURandParams() {}
+    NURandParams(int a, int c, int x, int y)
+        : A(a), C(c), min(x), max(y), range(uint32_t(y - x + 1)) {}
+  };
+  NURandParams customer_id_nurand_;
+  NURandParams item_id_nurand_;
+  NURandParams last_name_load_nurand_;
+  NURandParams last_name_run_nurand_;
+
+  KVBulkWriter* NewLoadWriter(TPCCTableType table);
+  size_t DistrictIndex(uint32_t w_id, uint32_t d_id) const {
+    return size_t(w_id - 1) * num_district_per_warehouse_ + (d_id - 1);
+  }
+  // Date of the n-th customer or order a district is loaded with. Taken
+  // from the key rather than a clock, so the loaded rows do not depend on
+  // LOAD_THREADS or on how the loaders were scheduled.
+  uint32_t LoadTimestamp(uint32_t w_id, uint32_t d_id, uint32_t n) const {
+    return uint32_t(DistrictIndex(w_id, d_id) * num_customer_per_district_ + n);
+  }
+  // Run fn for every warehouse on the load pool and wait for all of them.
+  void ForEachWarehouse(const std::function<void(uint32_t)>& fn);
+
+  RecordStats record_stats_;
+  // RECORD_LATENCY_SAMPLE
+  OpLatencySampler op_latency_;
+  // HOT_COLD_SPLIT
+  bool hot_cold_split_ = false;
+  // PARTIAL_UPDATES
+  bool partial_updates_ = false;
+  // STOCK_QUANTITY_COLUMN, not Enabled() when off
+  StockQuantityColumn stock_quantity_column_;
+  // filled by PopulateStockTable() of this table
+  bool stock_quantity_column_loaded_ = false;
+  // NextDeliveryOrder() per district, by DistrictIndex()
+  std::unique_ptr<std::atomic<int32_t>[]> next_delivery_;
+  // set by PopulateOrderNewOrderAndOrderLineTable() of this table
+  bool next_delivery_loaded_ = false;
+  // ThreadItemSet(), by Utils::ThreadIndex()
+  std::unique_ptr<std::unique_ptr<DistinctItemSet>[]> item_sets_;
+
+  // workers of LoadTables(), LOAD_THREADS of them
+  std::unique_ptr<CW::ThreadPool> load_pool_;
+
+  // arrays made by MakeCustomerIndexKey(), of every table of the process
+  static const size_t kCustomerIndexKeyWords = 5;
+  inline static std::atomic<uint64_t> customer_index_key_arrays_{0};
 
  public:
   TPCCTable(DBType db_type = DBType::memorydb);
@@ -47,13 +99,75 @@ class TPCCTable {
   uint32_t GetNumCustomerPerDistrict() { return num_customer_per_district_; }
   uint32_t GetNumItem() { return num_item_; }
   uint32_t GetNumStockPerWarehouse() { return num_stock_per_warehouse_; }
+  // CUSTOMER and STOCK rows are stored as hot and cold records
+  bool HotColdSplit() { return hot_cold_split_; }
+  // STOCK_QUANTITY_COLUMN, nullptr when off
+  StockQuantityColumn* GetStockQuantityColumn() {
+    return stock_quantity_column_.Enabled() ? &stock_quantity_column_
+                                            : nullptr;
+  }
+  // Read the column back from the stock rows when this table did not load
+  // them itself (REUSE_DB, SNAPSHOT_PATH); nothing to do otherwise.
+  void FillStockQuantityColumn();
+  // Order Delivery takes next in a district: the lowest one that may still
+  // have a NEW-ORDER row. The kv has no scans to find the lowest NO_O_ID,
+  // so the table keeps it; a Delivery that committed moves it on with
+  // OrderDelivered().
+  int32_t NextDeliveryOrder(uint32_t w_id, uint32_t d_id) {
+    return next_delivery_[DistrictIndex(w_id, d_id)].load(
+        std::memory_order_relaxed);
+  }
+  void OrderDelivered(uint32_t w_id, uint32_t d_id, int32_t o_id) {
+    next_delivery_[DistrictIndex(w_id, d_id)].compare_exchange_strong(
+        o_id, o_id + 1, std::memory_order_relaxed);
+  }
+  // Probe the NEW-ORDER rows for NextDeliveryOrder() when this table did not
+  // load them itself (REUSE_DB, SNAPSHOT_PATH); nothing to do otherwise.
+  void FindNextDeliveries();
+  // DistinctItemSet of the calling thread. The transactions in flight on a
+  // thread share it, a count must not span a co_await.
+  DistinctItemSet* ThreadItemSet() {
+    std::unique_ptr<DistinctItemSet>& set = item_sets_[Utils::ThreadIndex()];
+    if (!set) {
+      set.reset(new DistinctItemSet(num_item_));
+    }
+    return set.get();
+  }
 
   // For server-side usage
-  uint64_t GetLoadRecordCount() { return write_record_count_.load(); }
-  uint64_t GetReadRecordCount() { return read_record_count_.load(); }
+  // records written (loaded or put) and read so far
+  uint64_t GetLoadRecordCount();
+  uint64_t GetReadRecordCount();
+  TableRecordCounts CollectRecordStats() { return record_stats_.Collect(); }
+  // kv latency per table and op, empty unless RECORD_LATENCY_SAMPLE is set
+  std::string DumpOpLatency() { return op_latency_.Summary(); }
+  std::string DumpKVOptions() { return kv_impl->DumpOptions(); }
+  std::string DumpKVStats() { return kv_impl->DumpStats(); }
+  int FlushKV() { return kv_impl->Flush(); }
+  bool PersistentKV() { return kv_impl->Persistent(); }
+  KVInterface* GetKV() { return kv_impl; }
+  // Arrays MakeCustomerIndexKey() left on the heap so far, and their size
+  static uint64_t CustomerIndexKeyArrays() {
+    return customer_index_key_arrays_.load(std::memory_order_relaxed);
+  }
+  static size_t CustomerIndexKeyArrayBytes() {
+    return kCustomerIndexKeyWords * sizeof(uint64_t);
+  }
+
+  // All tables share one key space; the table id lives in the top byte so
+  // that rows of different tables never collide.
+  template <typename T>
+  static itemkey_t TableKey(itemkey_t item_key) {
+    return (static_cast<itemkey_t>(TableOf<T>::type) << 56) | item_key;
+  }
 
   void LoadTables();
 
+  // Scale and seeds LoadTables() runs with; the record counts are only
+  // known after loading, see GetLoadManifest().
+  static LoadManifest ExpectedLoad();
+  LoadManifest GetLoadManifest();
+
   std::vector<TPCCTxType> CreateWorkgenArray();
 
   void PopulateWarehouseTable(unsigned long seed);
@@ -68,29 +182,189 @@ class TPCCTable {
 
   void PopulateStockTable(unsigned long seed);
 
-  // -1 means fail, else means success
+  // Records written by one load task, one writer per table so that every
+  // bulk file holds a single key range.
+  struct LoadBatch {
+    std::array<std::unique_ptr<KVBulkWriter>, TPCC_TABLE_TYPES> writers;
+  };
+
+  // -1 means fail, else means success. The record may only be visible after
+  // FinishLoad(batch).
   template <typename T>
-  int PutRecord(itemkey_t item_key, T* val_ptr) {
-    write_record_count_ += 1;
+  int LoadRecord(LoadBatch& batch, itemkey_t item_key, T* val_ptr) {
+    record_stats_.Load(TableOf<T>::type, sizeof(T));
+    auto& writer = batch.writers[static_cast<size_t>(TableOf<T>::type)];
+    if (!writer) {
+      writer.reset(NewLoadWriter(TableOf<T>::type));
+    }
     std::string value;
     value.resize(sizeof(T));
     memcpy(value.data(), val_ptr, sizeof(T));
-    return kv_impl->Put(item_key, value);
+    return writer->Add(TableKey<T>(item_key), value);
+  }
+
+  // LoadRecord() of a CUSTOMER or STOCK row, as its hot and cold records
+  // under HOT_COLD_SPLIT.
+  template <typename T>
+  int LoadSplitRecord(LoadBatch& batch, itemkey_t item_key, T* val_ptr) {
+    if (!hot_cold_split_) {
+      return LoadRecord(batch, item_key, val_ptr);
+    }
+    typename HotColdOf<T>::Hot hot;
+    typename HotColdOf<T>::Cold cold;
+    SplitRecord(*val_ptr, &hot, &cold);
+    if (LoadRecord(batch, item_key, &hot) != 1 ||
+        LoadRecord(batch, item_key, &cold) != 1) {
+      return -1;
+    }
+    return 1;
+  }
+
+  // -1 if any writer of the batch failed
+  int FinishLoad(LoadBatch& batch);
+
+  // Seed of the generator populating warehouse w_id, so that the data does
+  // not depend on how the warehouses are spread over the load threads.
+  // Warehouse 1 keeps the seed of the table.
+  static uint64_t WarehouseSeed(uint64_t seed, uint32_t w_id) {
+    return seed + uint64_t(w_id - 1) * 0x9E3779B97F4A7C15ULL;
+  }
+
+  // -1 means fail, else means success
+  template <typename T>
+  int PutRecord(itemkey_t item_key, T* val_ptr) {
+    record_stats_.Put(TableOf<T>::type, sizeof(T));
+    ScopedBuffer value;
+    value->assign(reinterpret_cast<const char*>(val_ptr), sizeof(T));
+    return op_latency_.Time(TableOf<T>::type, RecordOp::kPut, [&]() {
+      return kv_impl->Put(TableKey<T>(item_key), *value);
+    });
+  }
+
+  // -1 means fail, else means success. Changes the stored T by delta, whose
+  // offsets are those of T's fields.
+  template <typename T>
+  int MergeRecord(itemkey_t item_key, const RecordDelta& delta) {
+    record_stats_.Merge(TableOf<T>::type, delta.Encoded().size());
+    return op_latency_.Time(TableOf<T>::type, RecordOp::kMerge, [&]() {
+      return kv_impl->Merge(TableKey<T>(item_key), delta.Encoded());
+    });
+  }
+
+  // -1 means fail, else means success
+  template <typename T>
+  int DeleteRecord(itemkey_t item_key) {
+    record_stats_.Delete(TableOf<T>::type);
+    return op_latency_.Time(TableOf<T>::type, RecordOp::kDelete, [&]() {
+      return kv_impl->Delete(TableKey<T>(item_key));
+    });
+  }
+
+  // Write back a record read for update and changed in place: only delta,
+  // the same change, under PARTIAL_UPDATES, else the whole record.
+  template <typename T>
+  int UpdateRecord(itemkey_t item_key, T* val_ptr, const RecordDelta& delta) {
+    if (partial_updates_) {
+      return MergeRecord<T>(item_key, delta);
+    }
+    return PutRecord(item_key, val_ptr);
+  }
+
+  // Engine transaction bracket around one TPCC transaction, -1 on commit
+  // means the engine aborted it (lock timeout, deadlock, validation failure)
+  int BeginTxn() { return kv_impl->Begin(); }
+  int CommitTxn() { return kv_impl->Commit(); }
+  int RollbackTxn() { return kv_impl->Rollback(); }
+
+  // -1 means fail, else means success
+  template <typename T>
+  int GetRecordForUpdate(itemkey_t item_key, T* val_ptr) {
+    ScopedBuffer value;
+    auto s = op_latency_.Time(TableOf<T>::type, RecordOp::kGetForUpdate, [&]() {
+      return kv_impl->GetForUpdate(TableKey<T>(item_key), *value);
+    });
+    if( s != 1 || value->size() < sizeof(T)){
+      record_stats_.Get(TableOf<T>::type, false, 0);
+      return -1;
+    }
+    record_stats_.Get(TableOf<T>::type, true, value->size());
+    memcpy((char*)val_ptr, value->data(), sizeof(T));
+    return 1;
   }
 
   // -1 means fail, else means success
   template <typename T>
   int GetRecord(itemkey_t item_key, T* val_ptr) {
-    read_record_count_ += 1;
-    std::string value;
-    auto s = kv_impl->Get(item_key, value);
-    if( s != 1){
+    ScopedBuffer value;
+    auto s = op_latency_.Time(TableOf<T>::type, RecordOp::kGet, [&]() {
+      return kv_impl->Get(TableKey<T>(item_key), *value);
+    });
+    if( s != 1 || value->size() < sizeof(T)){
+      record_stats_.Get(TableOf<T>::type, false, 0);
       return -1;
     }
-    memcpy((char*)val_ptr, value.data(), sizeof(T));
+    record_stats_.Get(TableOf<T>::type, true, value->size());
+    memcpy((char*)val_ptr, value->data(), sizeof(T));
     return 1;
   }
 
+  // GetRecord() for transactions running as coroutines:
+  // co_await ReadRecord(key, &val) gives -1 or 1. The read suspends the
+  // transaction when the thread runs a TxnScheduler, otherwise it is done in
+  // place. Only reads done in place are timed for RECORD_LATENCY_SAMPLE, a
+  // deferred one waits for the whole batch.
+  template <typename T>
+  struct RecordRead {
+    KVInterface* kv;
+    RecordStats* stats;
+    OpLatencySampler* latency;
+    T* val_ptr;
+    KVRead read;
+
+    bool await_ready() {
+      if (TxnScheduler::Current() != nullptr) {
+        return false;
+      }
+      RecordOp op = read.for_update ? RecordOp::kGetForUpdate : RecordOp::kGet;
+      read.status = latency->Time(TableOf<T>::type, op, [&]() {
+        return read.for_update ? kv->GetForUpdate(read.key, read.value)
+                               : kv->Get(read.key, read.value);
+      });
+      return true;
+    }
+    void await_suspend(std::coroutine_handle<> handle) {
+      TxnScheduler::Current()->Defer(handle, &read);
+    }
+    int await_resume() {
+      int status = -1;
+      if (read.status != 1 || read.value.size() < sizeof(T)) {
+        stats->Get(TableOf<T>::type, false, 0);
+      } else {
+        stats->Get(TableOf<T>::type, true, read.value.size());
+        memcpy((char*)val_ptr, read.value.data(), sizeof(T));
+        status = 1;
+      }
+      TxnArena::ThreadArena().ReturnBuffer(std::move(read.value));
+      return status;
+    }
+  };
+
+  template <typename T>
+  RecordRead<T> ReadRecord(itemkey_t item_key, T* val_ptr) {
+    RecordRead<T> r{kv_impl, &record_stats_, &op_latency_, val_ptr, {}};
+    r.read.key = TableKey<T>(item_key);
+    // given back by await_resume()
+    r.read.value = TxnArena::ThreadArena().TakeBuffer();
+    return r;
+  }
+
+  template <typename T>
+  RecordRead<T> ReadRecordForUpdate(itemkey_t item_key, T* val_ptr) {
+    RecordRead<T> r = ReadRecord(item_key, val_ptr);
+    r.read.for_update = true;
+    return r;
+  }
+
  public:
   /* Followng pieces of codes mainly comes from Silo */
   inline uint32_t GetCurrentTimeMillis() {
@@ -108,8 +382,7 @@ class TPCCTable {
   }
 
   inline int RandomNumber(FastRandom& r, int min, int max) {
-    return CheckBetweenInclusive((int)(r.NextUniform() * (max - min + 1) + min),
-                                 min, max);
+    return CheckBetweenInclusive((int)r.NextInt(min, max), min, max);
   }
 
   inline int NonUniformRandom(FastRandom& r, int A, int C, int min, int max) {
@@ -118,17 +391,23 @@ class TPCCTable {
            min;
   }
 
+  inline int NonUniformRandom(FastRandom& r, const NURandParams& p) {
+    return p.range.Mod(uint32_t(
+               (RandomNumber(r, 0, p.A) | RandomNumber(r, p.min, p.max)) +
+               p.C)) +
+           p.min;
+  }
+
   inline int64_t GetItemId(FastRandom& r) {
     return CheckBetweenInclusive(
         g_uniform_item_dist ? RandomNumber(r, 1, num_item_)
-                            : NonUniformRandom(r, 8191, 7911, 1, num_item_),
+                            : NonUniformRandom(r, item_id_nurand_),
         1, num_item_);
   }
 
   inline int GetCustomerId(FastRandom& r) {
-    return CheckBetweenInclusive(
-        NonUniformRandom(r, 1023, 259, 1, num_customer_per_district_), 1,
-        num_customer_per_district_);
+    return CheckBetweenInclusive(NonUniformRandom(r, customer_id_nurand_), 1,
+                                 num_customer_per_district_);
   }
 
   // pick a number between [start, end)
@@ -137,6 +416,9 @@ class TPCCTable {
     const unsigned diff = end - start;
     if (diff == 1)
       return start;
+    if (r.Kind() != Utils::RandomKind::kJavaLcg) {
+      return r.NextBelow(diff) + start;
+    }
     return (r.Next() % diff) + start;
   }
 
@@ -169,11 +451,12 @@ class TPCCTable {
   }
 
   inline std::string GetNonUniformCustomerLastNameLoad(FastRandom& r) {
-    return GetCustomerLastName(r, NonUniformRandom(r, 255, 157, 0, 999));
+    return GetCustomerLastName(r, NonUniformRandom(r, last_name_load_nurand_));
   }
 
   inline size_t GetNonUniformCustomerLastNameRun(uint8_t* buf, FastRandom& r) {
-    return GetCustomerLastName(buf, r, NonUniformRandom(r, 255, 223, 0, 999));
+    return GetCustomerLastName(buf, r,
+                               NonUniformRandom(r, last_name_run_nurand_));
   }
 
   inline size_t GetNonUniformCustomerLastNameRun(char* buf, FastRandom& r) {
@@ -181,33 +464,61 @@ class TPCCTable {
   }
 
   inline std::string GetNonUniformCustomerLastNameRun(FastRandom& r) {
-    return GetCustomerLastName(r, NonUniformRandom(r, 255, 223, 0, 999));
+    return GetCustomerLastName(r, NonUniformRandom(r, last_name_run_nurand_));
   }
 
-  inline std::string RandomStr(FastRandom& r, uint64_t len) {
-    // this is a property of the oltpbench implementation...
-    if (!len)
-      return "";
+  // Fill dst with len values in [0, n), n <= 256, with no rejection: each
+  // value is the high 64 bits of word * n and the low 64 bits carry on to
+  // the next. A word yields the k values with n^k < 2^32, which keeps the
+  // last of them within 2^-32 of uniform.
+  inline void RandomBelow(FastRandom& r, uint8_t* dst, uint64_t len,
+                          uint32_t n) {
+    uint64_t per_word = 0;
+    for (uint64_t span = n; span < (uint64_t(1) << 32); span *= n) {
+      per_word++;
+    }
+    for (uint64_t i = 0; i < len; i += per_word) {
+      uint64_t word = r.Next();
+      uint64_t end = i + per_word < len ? i + per_word : len;
+      for (uint64_t j = i; j < end; j++) {
+        unsigned __int128 product = (unsigned __int128)word * n;
+        dst[j] = uint8_t(product >> 64);
+        word = uint64_t(product);
+      }
+    }
+  }
 
-    uint64_t i = 0;
-    std::string buf(len, 0);
-    while (i < (len)) {
-      const char c = (char)r.NextChar();
-      // XXX(stephentu): oltpbench uses java's Character.isLetter(), which
-      // is a less restrictive filter than isalnum()
-      if (!isalnum(c))
-        continue;
-      buf[i++] = c;
+  // Write len alphanumeric chars and a '\0' to dst (len + 1 bytes).
+  inline void RandomStr(FastRandom& r, char* dst, uint64_t len) {
+    uint8_t* buf = reinterpret_cast<uint8_t*>(dst);
+    RandomBelow(r, buf, len, 62);
+    for (uint64_t i = 0; i < len; i++) {
+      uint8_t v = buf[i];
+      // 0-9 -> '0'-'9', 10-35 -> 'A'-'Z', 36-61 -> 'a'-'z'
+      buf[i] = uint8_t('0' + v + (v >= 10) * 7 + (v >= 36) * 6);
     }
+    dst[len] = '\0';
+  }
+
+  inline std::string RandomStr(FastRandom& r, uint64_t len) {
+    std::string buf(len, 0);
+    RandomStr(r, buf.data(), len);  // the '\0' goes to the terminator
     return buf;
   }
 
   // RandomNStr() actually produces a string of length len
+  inline void RandomNStr(FastRandom& r, char* dst, uint64_t len) {
+    uint8_t* buf = reinterpret_cast<uint8_t*>(dst);
+    RandomBelow(r, buf, len, 10);
+    for (uint64_t i = 0; i < len; i++) {
+      buf[i] = uint8_t('0' + buf[i]);
+    }
+    dst[len] = '\0';
+  }
+
   inline std::string RandomNStr(FastRandom& r, uint64_t len) {
-    const char base = '0';
     std::string buf(len, 0);
-    for (uint64_t i = 0; i < len; i++)
-      buf[i] = (char)(base + (r.Next() % 10));
+    RandomNStr(r, buf.data(), len);
     return buf;
   }
 
@@ -241,10 +552,14 @@ class TPCCTable {
         newstring[23 - i] = '\0';
   }
 
+  // The key is the address of a new array, which is never freed: a freed
+  // one could come back as the key of another customer. Counted by
+  // CustomerIndexKeyArrays() to tell this memory from the engine's.
   inline uint64_t MakeCustomerIndexKey(int32_t w_id, int32_t d_id,
                                        std::string s_last,
                                        std::string s_first) {
-    uint64_t* seckey = new uint64_t[5];
+    customer_index_key_arrays_.fetch_add(1, std::memory_order_relaxed);
+    uint64_t* seckey = new uint64_t[kCustomerIndexKeyWords];
     int32_t did = d_id + (w_id * num_district_per_warehouse_);
     seckey[0] = did;
     ConvertString((char*)(&seckey[1]), s_last.data(), s_last.size());
@@ -306,5 +621,40 @@ class TPCCTable {
     // assert(stockKeyToWare(id) == w_id);
     return s_id;
   }
+
+  // Inverses of the Make*Key functions: the warehouse a row belongs to.
+  // Every id inside a warehouse starts at 1.
+  inline uint32_t DistrictKeyToWare(int64_t key) {
+    return uint32_t((key - 1) / num_district_per_warehouse_);
+  }
+
+  inline uint32_t CustomerKeyToWare(int64_t key) {
+    return DistrictKeyToWare(key >> 32);
+  }
+
+  inline uint32_t HistoryKeyToWare(int64_t key) {
+    return DistrictKeyToWare(key & ((1 << 20) - 1));
+  }
+
+  inline uint32_t OrderKeyToWare(int64_t key) {
+    return DistrictKeyToWare(key >> 32);
+  }
+
+  inline uint32_t OrderIndexKeyToWare(int64_t key) {
+    return DistrictKeyToWare(((key >> 32) - 1) / num_customer_per_district_);
+  }
+
+  inline uint32_t OrderLineKeyToWare(int64_t key) {
+    return DistrictKeyToWare((key - 1) / 15 / 10000000);
+  }
+
+  inline uint32_t StockKeyToWare(int64_t key) {
+    return uint32_t((key - 1) / num_stock_per_warehouse_);
+  }
+
+  // Warehouse of a row by its kv key (see TableKey()), 0 for the rows of
+  // no particular warehouse: items, and customer index entries whose key
+  // is the address of the index tuple.
+  uint32_t KeyToWarehouse(uint64_t table_key);
 };
 }  // end of namespace TPCC
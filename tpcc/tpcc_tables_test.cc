@@ -5,26 +5,24 @@
 // Copyright (c) 2023 liuzhenm@mail.ustc.edu.cn.
 //
 
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstring>
+#include <filesystem>
 #include <iostream>
+#include <set>
+#include <thread>
 #include <typeinfo>
 #include <gflags/gflags.h>
 #include <gtest/gtest.h>
+#include "consistency.h"
+#include "coroutine.h"
+#include "histogram.h"
 #include "schemas.h"
+#include "terminal.h"
 #include "tpcc_tables.h"
-
-namespace TPCC{
-DEFINE_bool(DEBUG, true, "Set if output log message.");
-DEFINE_int32(NUM_WAREHOUSE, 1, "Set the num of warehouse.");
-DEFINE_int32(FREQUENCY_NEW_ORDER, 45, "Default percentage of new-order txn.");
-DEFINE_int32(FREQUENCY_PAYMENT, 43, "Default percentage of payment txn.");
-DEFINE_int32(FREQUENCY_ORDER_STATUS, 4,
-             "Default percentage of order-status txn.");
-DEFINE_int32(FREQUENCY_DELIVERY, 4, "Default percentage of delivery txn.");
-DEFINE_int32(FREQUENCY_STOCK_LEVEL, 4,
-             "Default percentage of stock-level txn.");
-DEFINE_string(DB_PATH, "/tmp", "PATH of DB files stored");
-}
-
+#include "tpcc_txn.h"
 
 class TPCC_TABLE: public testing::Test {
   public:
@@ -32,6 +30,7 @@ class TPCC_TABLE: public testing::Test {
     tpcc_table.LoadTables();
     return tpcc_table.GetLoadRecordCount();
   }
+  TPCC::LoadManifest GetLoadManifest() { return tpcc_table.GetLoadManifest(); }
 
 
   private:
@@ -55,11 +54,478 @@ TEST_F(TPCC_TABLE, TABLE_CREATION){
   EXPECT_EQ(GenerateAllTables(), 758571);
 }
 
+TEST_F(TPCC_TABLE, LOAD_MANIFEST){
+  GenerateAllTables();
+  TPCC::LoadManifest written = GetLoadManifest();
+  std::string path = TPCC::LoadManifest::PathOf(TPCC::FLAGS_DB_PATH);
+  ASSERT_TRUE(written.Write(path));
+
+  TPCC::LoadManifest read;
+  ASSERT_TRUE(read.Read(path));
+  EXPECT_TRUE(TPCC::TPCCTable::ExpectedLoad().SameLoad(read, nullptr));
+  EXPECT_EQ(read.total_records, 758571);
+  EXPECT_EQ(read.table_records, written.table_records);
+
+  read.num_warehouse++;
+  EXPECT_FALSE(written.SameLoad(read, nullptr));
+  std::remove(path.c_str());
+}
+
+TEST(SNAPSHOT, CLONE_KEEPS_HOLES){
+  std::string src = "/tmp/tpcc_clone_src", dst = "/tmp/tpcc_clone_dst";
+  mkdir(src.c_str(), 0755);
+  int fd = open((src + "/sparse").c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  ASSERT_GE(fd, 0);
+  const off_t kSize = 8 << 20;
+  ASSERT_EQ(pwrite(fd, "head", 4, 0), 4);
+  ASSERT_EQ(pwrite(fd, "tail", 4, kSize - 4), 4);
+  close(fd);
+
+  ASSERT_TRUE(TPCC::CloneDirectory(src, dst));
+  struct stat st;
+  ASSERT_EQ(stat((dst + "/sparse").c_str(), &st), 0);
+  EXPECT_EQ(st.st_size, kSize);
+  EXPECT_LT(st.st_blocks * 512, kSize / 2);
+  char buf[4];
+  fd = open((dst + "/sparse").c_str(), O_RDONLY);
+  ASSERT_EQ(pread(fd, buf, 4, 0), 4);
+  EXPECT_EQ(memcmp(buf, "head", 4), 0);
+  ASSERT_EQ(pread(fd, buf, 4, kSize / 2), 4);
+  EXPECT_EQ(memcmp(buf, "\0\0\0\0", 4), 0);
+  ASSERT_EQ(pread(fd, buf, 4, kSize - 4), 4);
+  EXPECT_EQ(memcmp(buf, "tail", 4), 0);
+  close(fd);
+  std::filesystem::remove_all(src);
+  std::filesystem::remove_all(dst);
+}
+
+TEST(TPCC_KEYS, KEY_TO_WAREHOUSE){
+  TPCC::TPCCTable table;
+  for (int32_t w = 1; w <= 2; w++) {
+    for (int32_t d : {1, NUM_DISTRICT_PER_WAREHOUSE}) {
+      EXPECT_EQ(table.KeyToWarehouse(
+                    table.TableKey<TPCC::tpcc_district_val_t>(
+                        table.MakeDistrictKey(w, d))), w);
+      EXPECT_EQ(table.KeyToWarehouse(
+                    table.TableKey<TPCC::tpcc_customer_val_t>(
+                        table.MakeCustomerKey(w, d, NUM_CUSTOMER_PER_DISTRICT))), w);
+      EXPECT_EQ(table.KeyToWarehouse(
+                    table.TableKey<TPCC::tpcc_history_val_t>(
+                        table.MakeHistoryKey(w, d, 3 - w, d, 1))), w);
+      EXPECT_EQ(table.KeyToWarehouse(
+                    table.TableKey<TPCC::tpcc_order_index_val_t>(
+                        table.MakeOrderIndexKey(w, d, NUM_CUSTOMER_PER_DISTRICT, 7))), w);
+      EXPECT_EQ(table.KeyToWarehouse(
+                    table.TableKey<TPCC::tpcc_order_line_val_t>(
+                        table.MakeOrderLineKey(w, d, 3001, 15))), w);
+    }
+    EXPECT_EQ(table.KeyToWarehouse(table.TableKey<TPCC::tpcc_stock_val_t>(
+                  table.MakeStockKey(w, NUM_ITEM))), w);
+    EXPECT_EQ(table.KeyToWarehouse(table.TableKey<TPCC::tpcc_stock_cold_val_t>(
+                  table.MakeStockKey(w, NUM_ITEM))), w);
+    EXPECT_EQ(table.KeyToWarehouse(
+                  table.TableKey<TPCC::tpcc_customer_hot_val_t>(
+                      table.MakeCustomerKey(w, 1, 1))), w);
+  }
+  EXPECT_EQ(table.KeyToWarehouse(table.TableKey<TPCC::tpcc_item_val_t>(5)), 0);
+}
+
+TEST(THREAD_INDEX, REUSED_AFTER_EXIT){
+  // more threads than kMaxThreads over time, never more than one at once
+  std::set<uint32_t> indexes;
+  for (uint32_t i = 0; i < 2 * Utils::kMaxThreads; i++) {
+    std::thread thread([&indexes]() { indexes.insert(Utils::ThreadIndex()); });
+    thread.join();
+  }
+  EXPECT_LE(indexes.size(), 2u);
+}
+
+TEST(TIMER_WHEEL, EXPIRY){
+  // 100ns ticks on 8 slots, the last timer is a lap ahead
+  TPCC::TimerWheel wheel(100, 8, 0);
+  wheel.Schedule(0, 0);
+  wheel.Schedule(50, 1);
+  wheel.Schedule(250, 2);
+  wheel.Schedule(1000, 3);
+  EXPECT_EQ(wheel.Size(), 4u);
+  std::vector<uint32_t> expired;
+  wheel.Advance(99, &expired);
+  EXPECT_EQ(expired, std::vector<uint32_t>({0}));
+  expired.clear();
+  wheel.Advance(100, &expired);
+  EXPECT_EQ(expired, std::vector<uint32_t>({1}));
+  expired.clear();
+  // never early, and slot 2 keeps the timer of the next lap
+  wheel.Advance(299, &expired);
+  EXPECT_TRUE(expired.empty());
+  wheel.Advance(300, &expired);
+  EXPECT_EQ(expired, std::vector<uint32_t>({2}));
+  expired.clear();
+  wheel.Advance(999, &expired);
+  EXPECT_TRUE(expired.empty());
+  EXPECT_EQ(wheel.NextTickNs(), 1000u);
+  wheel.Advance(1000, &expired);
+  EXPECT_EQ(expired, std::vector<uint32_t>({3}));
+  expired.clear();
+  // a timer in the past fires on the next Advance()
+  wheel.Schedule(5, 4);
+  wheel.Advance(1000, &expired);
+  EXPECT_EQ(expired, std::vector<uint32_t>({4}));
+  EXPECT_EQ(wheel.Size(), 0u);
+}
+
+TEST(LATENCY_HISTOGRAM, PERCENTILE){
+  TPCC::LatencyHistogram histogram;
+  for (uint64_t ns = 1; ns <= 100000; ns++) {
+    histogram.Add(ns * 100);
+  }
+  EXPECT_EQ(histogram.Count(), 100000);
+  EXPECT_EQ(histogram.Max(), 10000000);
+  EXPECT_NEAR(histogram.Percentile(50), 5000000, 5000000 * 0.04);
+  EXPECT_NEAR(histogram.Percentile(99), 9900000, 9900000 * 0.04);
+  EXPECT_EQ(histogram.Percentile(100), 10000000);
+}
+
+TEST(OP_LATENCY, PER_TABLE_AND_OP){
+  TPCC::OpLatencySampler sampler(2);
+  // every other call of a thread is timed, into that thread's histograms
+  std::thread stock_reader([&sampler]() {
+    for (int i = 0; i < 6; i++) {
+      sampler.Time(TPCC::TPCCTableType::kStockTable, TPCC::RecordOp::kGet,
+                   []() { return 1; });
+    }
+  });
+  stock_reader.join();
+  std::thread order_line_writer([&sampler]() {
+    for (int i = 0; i < 4; i++) {
+      EXPECT_EQ(sampler.Time(TPCC::TPCCTableType::kOrderLineTable,
+                             TPCC::RecordOp::kPut, []() { return -1; }),
+                -1);
+    }
+    sampler.Record(TPCC::TPCCTableType::kStockTable, TPCC::RecordOp::kGet, 0);
+  });
+  order_line_writer.join();
+  std::string summary = sampler.Summary();
+  EXPECT_EQ(summary.find("order_line.put: count=2;"), 0u) << summary;
+  EXPECT_NE(summary.find(" | stock.get: count=4;"), std::string::npos)
+      << summary;
+  EXPECT_EQ(summary.find("get_for_update"), std::string::npos) << summary;
+  EXPECT_EQ(TPCC::OpLatencySampler(0).Summary(), "");
+}
+
+TEST(OP_LATENCY, SAMPLERS_COUNT_APART){
+  // interleaved on one thread, each keeps its own rate
+  TPCC::OpLatencySampler every_2(2), every_3(3);
+  int sampled_2 = 0, sampled_3 = 0;
+  for (int i = 0; i < 12; i++) {
+    sampled_2 += every_2.Sample();
+    sampled_3 += every_3.Sample();
+  }
+  EXPECT_EQ(sampled_2, 6);
+  EXPECT_EQ(sampled_3, 4);
+}
+
+TEST(RECORD_DELTA, APPLY){
+  TPCC::tpcc_stock_val_t stock{};
+  stock.s_quantity = 50;
+  stock.s_ytd = 7;
+  std::string value((const char*)&stock, sizeof(stock));
+  int32_t quantity = 41;
+  RecordDelta delta;
+  delta.Set(offsetof(TPCC::tpcc_stock_val_t, s_quantity), &quantity, sizeof(quantity))
+      .AddInt32(offsetof(TPCC::tpcc_stock_val_t, s_ytd), 9)
+      .AddInt32(offsetof(TPCC::tpcc_stock_val_t, s_order_cnt), 1);
+  ASSERT_TRUE(RecordDelta::Apply(delta.Encoded(), &value));
+  memcpy(&stock, value.data(), sizeof(stock));
+  EXPECT_EQ(stock.s_quantity, 41);
+  EXPECT_EQ(stock.s_ytd, 16);
+  EXPECT_EQ(stock.s_order_cnt, 1);
+
+  // out of bounds: rejected as a whole
+  std::string before = value;
+  delta.AddInt32(sizeof(stock) - 2, 1);
+  EXPECT_FALSE(RecordDelta::Apply(delta.Encoded(), &value));
+  EXPECT_EQ(value, before);
+}
+
+TEST(STOCK_QUANTITY_COLUMN, COUNT_DISTINCT_BELOW){
+  TPCC::StockQuantityColumn column;
+  TPCC::DistinctItemSet seen(1000);
+  column.Init(2, 1000);
+  for (int32_t i_id = 1; i_id <= 1000; i_id++) {
+    column.Set(1, i_id, i_id % 30);
+    column.Set(2, i_id, 100);
+  }
+  // 17 ids with repeats, more than one gather of 8
+  std::vector<int32_t> ids = {1, 2, 2, 45, 29, 30, 31, 1000, 999,
+                              15, 15, 14, 1, 600, 601, 602, 45};
+  std::set<int32_t> expected;
+  for (int32_t id : ids) {
+    if (id % 30 < 15) {
+      expected.insert(id);
+    }
+  }
+  EXPECT_EQ(column.CountDistinctBelow(1, ids.data(), ids.size(), 15, &seen),
+            expected.size());
+  // the bitmap is clean for the next call
+  EXPECT_EQ(column.CountDistinctBelow(1, ids.data(), ids.size(), 15, &seen),
+            expected.size());
+  EXPECT_EQ(column.CountDistinctBelow(2, ids.data(), ids.size(), 15, &seen),
+            0u);
+  EXPECT_EQ(seen.CountDistinct(ids.data(), ids.size()),
+            std::set<int32_t>(ids.begin(), ids.end()).size());
+}
+
+// Logs every call with the transaction context it ran under
+class ContextLogKV : public KVInterface {
+ public:
+  int Put(uint64_t key, const std::string& value) override { return 1; }
+  int Get(uint64_t key, std::string& value) override {
+    Log("get " + std::to_string(key));
+    value = std::to_string(key);
+    return 1;
+  }
+  int Begin() override { Log("begin"); return 1; }
+  int Commit() override { Log("commit"); return 1; }
+  void SwitchTxnContext(void* txn_context) override {
+    context_ = static_cast<const char*>(txn_context);
+  }
+  void MultiGet(KVRead* const* reads, size_t n) override {
+    Log("multiget " + std::to_string(n));
+    KVInterface::MultiGet(reads, n);
+  }
+  void Log(const std::string& call) {
+    log.push_back(call + "@" + (context_ ? context_ : "-"));
+  }
+
+  std::vector<std::string> log;
+
+ private:
+  const char* context_ = nullptr;
+};
+
+struct DeferredRead {
+  KVRead read;
+  bool await_ready() { return false; }
+  void await_suspend(std::coroutine_handle<> handle) {
+    TPCC::TxnScheduler::Current()->Defer(handle, &read);
+  }
+  int await_resume() { return read.status; }
+};
+
+TPCC::TxnTask TwoReads(ContextLogKV* kv, uint64_t key) {
+  kv->Begin();
+  DeferredRead first;
+  first.read.key = key;
+  co_await first;
+  kv->Log("read " + first.read.value);
+  DeferredRead second;
+  second.read.key = key + 1;
+  co_await second;
+  kv->Log("read " + second.read.value);
+  kv->Commit();
+  co_return true;
+}
+
+TEST(TXN_SCHEDULER, INTERLEAVE){
+  ContextLogKV kv;
+  char a[] = "a", b[] = "b";
+  TPCC::TxnTask ta = TwoReads(&kv, 10);
+  TPCC::TxnTask tb = TwoReads(&kv, 20);
+  {
+    TPCC::TxnScheduler scheduler(&kv);
+    EXPECT_EQ(TPCC::TxnScheduler::Current(), &scheduler);
+    scheduler.Start(ta, a);
+    scheduler.Start(tb, b);
+    EXPECT_EQ(scheduler.Pending(), 2u);
+    while (scheduler.Pending() > 0) {
+      scheduler.Flush();
+    }
+  }
+  EXPECT_TRUE(TPCC::TxnScheduler::Current() == nullptr);
+  ASSERT_TRUE(ta.Done() && tb.Done());
+  EXPECT_TRUE(ta.Committed() && tb.Committed());
+  // both first reads in one batch, each transaction resumed in its context
+  std::vector<std::string> expected = {
+      "begin@a",  "begin@b",  "multiget 2@-", "get 10@a",  "get 20@b",
+      "read 10@a", "read 20@b", "multiget 2@-", "get 11@a", "get 21@b",
+      "read 11@a", "commit@a", "read 21@b",   "commit@b"};
+  EXPECT_EQ(kv.log, expected);
+}
+
+TEST(STOCK_QUANTITY_COLUMN, MATCHES_STOCK_ROWS){
+  TPCC::FLAGS_STOCK_QUANTITY_COLUMN = true;
+  TPCC::TPCCTable table;
+  TPCC::FLAGS_STOCK_QUANTITY_COLUMN = false;
+  table.LoadTables();
+  TPCC::TPCCTxn txn;
+  TPCC::TxnInput input;
+  TPCC::TxnHome home;
+  home.warehouse_id = 1;
+  FastRandom random_generator(7);
+  for (int i = 0; i < 200; i++) {
+    TPCC::TPCCTxn::Generate(&table, random_generator,
+                            TPCC::TPCCTxType::kNewOrder, &input, home);
+    EXPECT_TRUE(txn.Execute(&table, input));
+  }
+  TPCC::StockQuantityColumn* column = table.GetStockQuantityColumn();
+  ASSERT_NE(column, nullptr);
+  for (int32_t i_id = 1; i_id <= NUM_ITEM; i_id++) {
+    TPCC::tpcc_stock_key_t stock_key;
+    stock_key.s_id = table.MakeStockKey(1, i_id);
+    TPCC::tpcc_stock_val_t stock_val;
+    ASSERT_EQ(table.GetRecord(stock_key.item_key, &stock_val), 1);
+    ASSERT_EQ(column->Get(1, i_id), stock_val.s_quantity) << "i_id=" << i_id;
+  }
+}
+
+TEST(HOT_COLD_SPLIT, SPLIT_RECORD_ROUND_TRIP){
+  TPCC::FLAGS_HOT_COLD_SPLIT = true;
+  TPCC::TPCCTable table;
+  TPCC::FLAGS_HOT_COLD_SPLIT = false;
+  // every byte distinct enough that a field copied from the wrong place shows
+  TPCC::tpcc_customer_val_t cust;
+  TPCC::tpcc_stock_val_t stock;
+  for (size_t i = 0; i < sizeof(cust); i++) {
+    reinterpret_cast<uint8_t*>(&cust)[i] = uint8_t(i * 7 + 1);
+  }
+  for (size_t i = 0; i < sizeof(stock); i++) {
+    reinterpret_cast<uint8_t*>(&stock)[i] = uint8_t(i * 13 + 5);
+  }
+  TPCC::tpcc_customer_hot_val_t cust_hot;
+  TPCC::tpcc_customer_cold_val_t cust_cold;
+  TPCC::SplitRecord(cust, &cust_hot, &cust_cold);
+  TPCC::tpcc_stock_hot_val_t stock_hot;
+  TPCC::tpcc_stock_cold_val_t stock_cold;
+  TPCC::SplitRecord(stock, &stock_hot, &stock_cold);
+
+  // through the kv and back, the hot and cold records under one key
+  uint64_t cust_key = table.MakeCustomerKey(1, 2, 3);
+  uint64_t stock_key = table.MakeStockKey(1, 4);
+  ASSERT_EQ(table.PutRecord(cust_key, &cust_hot), 1);
+  ASSERT_EQ(table.PutRecord(cust_key, &cust_cold), 1);
+  ASSERT_EQ(table.PutRecord(stock_key, &stock_hot), 1);
+  ASSERT_EQ(table.PutRecord(stock_key, &stock_cold), 1);
+  memset(&cust_hot, 0, sizeof(cust_hot));
+  memset(&cust_cold, 0, sizeof(cust_cold));
+  memset(&stock_hot, 0, sizeof(stock_hot));
+  memset(&stock_cold, 0, sizeof(stock_cold));
+  ASSERT_EQ(table.GetRecord(cust_key, &cust_hot), 1);
+  ASSERT_EQ(table.GetRecord(cust_key, &cust_cold), 1);
+  ASSERT_EQ(table.GetRecord(stock_key, &stock_hot), 1);
+  ASSERT_EQ(table.GetRecord(stock_key, &stock_cold), 1);
+
+#define EXPECT_SAME_FIELD(part, full, field) \
+  EXPECT_EQ(memcmp(&part.field, &full.field, sizeof(part.field)), 0) << #field
+  EXPECT_SAME_FIELD(cust_hot, cust, c_credit_lim);
+  EXPECT_SAME_FIELD(cust_hot, cust, c_discount);
+  EXPECT_SAME_FIELD(cust_hot, cust, c_balance);
+  EXPECT_SAME_FIELD(cust_hot, cust, c_ytd_payment);
+  EXPECT_SAME_FIELD(cust_hot, cust, c_payment_cnt);
+  EXPECT_SAME_FIELD(cust_hot, cust, c_delivery_cnt);
+  EXPECT_SAME_FIELD(cust_hot, cust, c_since);
+  EXPECT_SAME_FIELD(cust_hot, cust, c_credit);
+  EXPECT_SAME_FIELD(cust_cold, cust, c_first);
+  EXPECT_SAME_FIELD(cust_cold, cust, c_middle);
+  EXPECT_SAME_FIELD(cust_cold, cust, c_last);
+  EXPECT_SAME_FIELD(cust_cold, cust, c_street_1);
+  EXPECT_SAME_FIELD(cust_cold, cust, c_street_2);
+  EXPECT_SAME_FIELD(cust_cold, cust, c_city);
+  EXPECT_SAME_FIELD(cust_cold, cust, c_state);
+  EXPECT_SAME_FIELD(cust_cold, cust, c_zip);
+  EXPECT_SAME_FIELD(cust_cold, cust, c_phone);
+  EXPECT_SAME_FIELD(cust_cold, cust, c_data);
+  EXPECT_SAME_FIELD(stock_hot, stock, s_quantity);
+  EXPECT_SAME_FIELD(stock_hot, stock, s_ytd);
+  EXPECT_SAME_FIELD(stock_hot, stock, s_order_cnt);
+  EXPECT_SAME_FIELD(stock_hot, stock, s_remote_cnt);
+  EXPECT_SAME_FIELD(stock_hot, stock, debug_magic);
+  EXPECT_SAME_FIELD(stock_cold, stock, s_dist);
+  EXPECT_SAME_FIELD(stock_cold, stock, s_data);
+#undef EXPECT_SAME_FIELD
+}
+
+TEST(PARTIAL_UPDATES, PAYMENT_MERGE_MATCHES_PUT){
+  // the same payments, written as deltas and as whole records
+  TPCC::FLAGS_PARTIAL_UPDATES = true;
+  TPCC::TPCCTable merged;
+  TPCC::FLAGS_PARTIAL_UPDATES = false;
+  TPCC::TPCCTable put;
+  merged.LoadTables();
+  put.LoadTables();
+  TPCC::TPCCTxn txn;
+  TPCC::TxnInput input;
+  TPCC::TxnHome home;
+  home.warehouse_id = 1;
+  FastRandom merged_random(11), put_random(11);
+  for (int i = 0; i < 100; i++) {
+    TPCC::TPCCTxn::Generate(&merged, merged_random,
+                            TPCC::TPCCTxType::kPayment, &input, home);
+    ASSERT_TRUE(txn.Execute(&merged, input));
+    TPCC::TPCCTxn::Generate(&put, put_random, TPCC::TPCCTxType::kPayment,
+                            &input, home);
+    ASSERT_TRUE(txn.Execute(&put, input));
+  }
+
+  TPCC::tpcc_warehouse_key_t ware_key;
+  ware_key.w_id = 1;
+  TPCC::tpcc_warehouse_val_t merged_ware, put_ware;
+  ASSERT_EQ(merged.GetRecord(ware_key.item_key, &merged_ware), 1);
+  ASSERT_EQ(put.GetRecord(ware_key.item_key, &put_ware), 1);
+  EXPECT_EQ(merged_ware.w_ytd, put_ware.w_ytd);
+  for (int32_t d = 1; d <= NUM_DISTRICT_PER_WAREHOUSE; d++) {
+    TPCC::tpcc_district_val_t merged_dist, put_dist;
+    ASSERT_EQ(merged.GetRecord(merged.MakeDistrictKey(1, d), &merged_dist), 1);
+    ASSERT_EQ(put.GetRecord(put.MakeDistrictKey(1, d), &put_dist), 1);
+    EXPECT_EQ(merged_dist.d_ytd, put_dist.d_ytd) << "d=" << d;
+    for (int32_t c = 1; c <= NUM_CUSTOMER_PER_DISTRICT; c++) {
+      TPCC::tpcc_customer_val_t merged_cust, put_cust;
+      ASSERT_EQ(merged.GetRecord(merged.MakeCustomerKey(1, d, c),
+                                 &merged_cust), 1);
+      ASSERT_EQ(put.GetRecord(put.MakeCustomerKey(1, d, c), &put_cust), 1);
+      EXPECT_EQ(merged_cust.c_balance, put_cust.c_balance);
+      EXPECT_EQ(merged_cust.c_ytd_payment, put_cust.c_ytd_payment);
+      EXPECT_EQ(merged_cust.c_payment_cnt, put_cust.c_payment_cnt);
+      EXPECT_STREQ(merged_cust.c_data, put_cust.c_data);
+    }
+  }
+}
+
+TEST(CONSISTENCY, CLEAN_AFTER_RUN){
+  TPCC::TPCCTable table;
+  table.LoadTables();
+  TPCC::TPCCTxn txn;
+  TPCC::TxnInput input;
+  TPCC::TxnHome home;  // PickWarehouseId() needs two warehouses
+  home.warehouse_id = 1;
+  FastRandom random_generator(42);
+  for (int i = 0; i < 300; i++) {
+    TPCC::TPCCTxType type = i % 10 == 9   ? TPCC::TPCCTxType::kDelivery
+                            : i % 10 == 8 ? TPCC::TPCCTxType::kOrderStatus
+                            : i % 10 == 7 ? TPCC::TPCCTxType::kStockLevel
+                            : i % 2 == 0  ? TPCC::TPCCTxType::kNewOrder
+                                          : TPCC::TPCCTxType::kPayment;
+    TPCC::TPCCTxn::Generate(&table, random_generator, type, &input, home);
+    EXPECT_TRUE(txn.Execute(&table, input));
+  }
+  TPCC::ConsistencyResult result = TPCC::ConsistencyChecker(&table).Run(1);
+  for (const std::string& example : result.examples) {
+    ADD_FAILURE() << example;
+  }
+  EXPECT_EQ(result.TotalViolations(), 0u);
+  EXPECT_GT(result.checked[size_t(TPCC::ConsistencyCondition::kCarrierNewOrder)],
+            0u);
+}
+
  TEST_F(TPCC_TABLE, TBALE_DEFINITION){
   EXPECT_EQ(TPCC::typeName(&TPCC::tpcc_customer_val_t::c_balance), TPCC::typeName(&TPCC::tpcc_customer_val_t::c_discount));
  }
 
 int main(int argc, char **argv) {
+  // one warehouse, manifests below /tmp
+  TPCC::FLAGS_NUM_WAREHOUSE = 1;
+  TPCC::FLAGS_DB_PATH = "/tmp";
+  TPCC::FLAGS_LOAD_THREADS = 2;
   testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
 }
@@ -10,12 +10,129 @@
 
 namespace TPCC {
 
+// Inputs of one transaction, drawn before it runs (GenerateXXX) so that
+// generation can be moved off the measured path or replayed. Plain data, a
+// TxnInput can be copied around and written to a file as is.
+struct NewOrderParams {
+  struct Line {
+    int32_t item_id;
+    uint32_t supply_warehouse_id;
+    uint32_t quantity;
+  };
+  uint32_t warehouse_id;
+  uint32_t district_id;
+  uint32_t customer_id;
+  int32_t num_items;
+  int32_t num_local_items;  // lines[0, num_local_items) are home stocks
+  int32_t all_local;
+  Line lines[tpcc_order_line_val_t::MAX_OL_CNT];
+};
+
+struct PaymentParams {
+  uint32_t warehouse_id;
+  uint32_t district_id;
+  int32_t customer_warehouse_id;
+  int32_t customer_district_id;
+  uint32_t customer_id;
+  float h_amount;
+  bool by_last_name;
+  char c_last[tpcc_customer_val_t::MAX_LAST + 1];
+};
+
+struct OrderStatusParams {
+  uint32_t warehouse_id;
+  uint32_t district_id;
+  uint32_t customer_id;
+  int32_t order_id;
+  bool by_last_name;
+};
+
+struct DeliveryParams {
+  uint32_t warehouse_id;
+  int32_t o_carrier_id;
+  uint32_t current_ts;
+};
+
+struct StockLevelParams {
+  uint32_t warehouse_id;
+  uint32_t district_id;
+  int32_t threshold;
+};
+
+// Terminal a transaction is generated for: the warehouse it is bound to and
+// the district of its stock-level reports. 0 means drawn at random.
+struct TxnHome {
+  uint32_t warehouse_id = 0;
+  uint32_t district_id = 0;
+};
+
+struct TxnInput {
+  TPCCTxType type;
+  union {
+    NewOrderParams new_order;
+    PaymentParams payment;
+    OrderStatusParams order_status;
+    DeliveryParams delivery;
+    StockLevelParams stock_level;
+  };
+};
+
+inline const char* TxTypeName(TPCCTxType type) {
+  switch (type) {
+    case TPCCTxType::kNewOrder:
+      return "new_order";
+    case TPCCTxType::kPayment:
+      return "payment";
+    case TPCCTxType::kDelivery:
+      return "delivery";
+    case TPCCTxType::kOrderStatus:
+      return "order_status";
+    case TPCCTxType::kStockLevel:
+      return "stock_level";
+    default:
+      return "unknown";
+  }
+}
+
 class TPCCTxn {
 
 public:
   TPCCTxn() = default;
   ~TPCCTxn() = default;
 
+  static void GenerateNewOrder(TPCCTable *tpcc_client,
+                               FastRandom &random_generator,
+                               NewOrderParams *params,
+                               const TxnHome &home = TxnHome());
+  static void GeneratePayment(TPCCTable *tpcc_client,
+                              FastRandom &random_generator,
+                              PaymentParams *params,
+                              const TxnHome &home = TxnHome());
+  static void GenerateOrderStatus(TPCCTable *tpcc_client,
+                                  FastRandom &random_generator,
+                                  OrderStatusParams *params,
+                                  const TxnHome &home = TxnHome());
+  static void GenerateDelivery(TPCCTable *tpcc_client,
+                               FastRandom &random_generator,
+                               DeliveryParams *params,
+                               const TxnHome &home = TxnHome());
+  static void GenerateStockLevel(TPCCTable *tpcc_client,
+                                 FastRandom &random_generator,
+                                 StockLevelParams *params,
+                                 const TxnHome &home = TxnHome());
+  static void Generate(TPCCTable *tpcc_client, FastRandom &random_generator,
+                       TPCCTxType type, TxnInput *input,
+                       const TxnHome &home = TxnHome());
+
+  // Run a generated transaction, true if it committed
+  bool Execute(TPCCTable *tpcc_client, const TxnInput &input);
+  // The transaction of input as a coroutine, for a TxnScheduler to run.
+  // It refers to input, which has to stay until the task is done.
+  TxnTask Start(TPCCTable *tpcc_client, const TxnInput &input);
+
+  // The transactions draw their inputs from random_generator, or run the
+  // given ones as coroutines that suspend on every read (see TxnTask).
+
  
 //   "New Order"
 //   "getWarehouseTaxRate": "SELECT W_TAX FROM WAREHOUSE WHERE W_ID = ?", # w_id
@@ -29,6 +146,7 @@ public:
 //   "updateStock": "UPDATE STOCK SET S_QUANTITY = ?, S_YTD = ?, S_ORDER_CNT = ?, S_REMOTE_CNT = ? WHERE S_I_ID = ? AND S_W_ID = ?", # s_quantity, s_order_cnt, s_remote_cnt, ol_i_id, ol_supply_w_id
 //   "createOrderLine": "INSERT INTO ORDER_LINE (OL_O_ID, OL_D_ID, OL_W_ID, OL_NUMBER, OL_I_ID, OL_SUPPLY_W_ID, OL_DELIVERY_D, OL_QUANTITY, OL_AMOUNT, OL_DIST_INFO) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?)", # o_id, d_id, w_id, ol_number, ol_i_id, ol_supply_w_id, ol_quantity, ol_amount, ol_dist_info
   bool NewOrder(TPCCTable *tpcc_client, FastRandom &random_generator);
+  TxnTask NewOrder(TPCCTable *tpcc_client, const NewOrderParams &params);
 
 //    "Payment"
 //    "getWarehouse": "SELECT W_NAME, W_STREET_1, W_STREET_2, W_CITY, W_STATE, W_ZIP FROM WAREHOUSE WHERE W_ID = ?", # w_id
@@ -41,6 +159,7 @@ public:
 //    "updateGCCustomer": "UPDATE CUSTOMER SET C_BALANCE = ?, C_YTD_PAYMENT = ?, C_PAYMENT_CNT = ? WHERE C_W_ID = ? AND C_D_ID = ? AND C_ID = ?", # c_balance, c_ytd_payment, c_payment_cnt, c_w_id, c_d_id, c_id
 //    "insertHistory": "INSERT INTO HISTORY VALUES (?, ?, ?, ?, ?, ?, ?, ?)",
   bool Payment(TPCCTable *tpcc_client, FastRandom &random_generator);
+  TxnTask Payment(TPCCTable *tpcc_client, const PaymentParams &params);
 
 //   "Delivery"
 //   "getNewOrder": "SELECT NO_O_ID FROM NEW_ORDER WHERE NO_D_ID = ? AND NO_W_ID = ? AND NO_O_ID > -1 LIMIT 1", #
@@ -51,6 +170,7 @@ public:
 //   "sumOLAmount": "SELECT SUM(OL_AMOUNT) FROM ORDER_LINE WHERE OL_O_ID = ? AND OL_D_ID = ? AND OL_W_ID = ?", # no_o_id, d_id, w_id
 //   "updateCustomer": "UPDATE CUSTOMER SET C_BALANCE = C_BALANCE + ? WHERE C_ID = ? AND C_D_ID = ? AND C_W_ID = ?", # ol_total, c_id, d_id, w_id
   bool Delivery(TPCCTable *tpcc_client, FastRandom &random_generator);
+  TxnTask Delivery(TPCCTable *tpcc_client, const DeliveryParams &params);
 
 //   "Order status"
 //   "getCustomerByCustomerId": "SELECT C_ID, C_FIRST, C_MIDDLE, C_LAST, C_BALANCE FROM CUSTOMER WHERE C_W_ID = ? AND C_D_ID = ? AND C_ID = ?", # w_id, d_id, c_id
@@ -59,12 +179,14 @@ public:
 //   "getOrderLines": "SELECT OL_SUPPLY_W_ID, OL_I_ID, OL_QUANTITY, OL_AMOUNT, OL_DELIVERY_D FROM ORDER_LINE WHERE OL_W_ID = ? AND OL_D_ID = ? AND OL_O_ID = ?", # w_id, d_id, o_id
   
   bool OrderStatus(TPCCTable *tpcc_client, FastRandom &random_generator);
+  TxnTask OrderStatus(TPCCTable *tpcc_client, const OrderStatusParams &params);
 
 //   "Stock level"
 //   "getOId": "SELECT D_NEXT_O_ID FROM DISTRICT WHERE D_W_ID = ? AND D_ID = ?",
 //   "getStockCount": "SELECT COUNT(DISTINCT(OL_I_ID)) FROM ORDER_LINE, STOCK  WHERE OL_W_ID = ? AND OL_D_ID = ? AND OL_O_ID < ? AND OL_O_ID >= ? AND S_W_ID = ? AND S_I_ID = OL_I_ID AND S_QUANTITY < ?
  
   bool StockLevel(TPCCTable *tpcc_client, FastRandom &random_generator);
+  TxnTask StockLevel(TPCCTable *tpcc_client, const StockLevelParams &params);
 
 private:
 };
@@ -0,0 +1,84 @@
+//
+// txn_arena.cc
+//
+// Created by Zacharyliu-CS on 06/29/2024.
+// Copyright (c) 2024 liuzhenm@mail.ustc.edu.cn.
+//
+#include "txn_arena.h"
+#include <new>
+
+namespace TPCC {
+
+namespace {
+
+const size_t kAlign = 16;
+
+size_t RoundUp(size_t size) { return (size + kAlign - 1) & ~(kAlign - 1); }
+
+}  // namespace
+
+TxnArena::~TxnArena() {
+  for (char* chunk : chunks_) {
+    ::operator delete(chunk);
+  }
+}
+
+void* TxnArena::Allocate(size_t size) {
+  size = RoundUp(size);
+  if (chunk_ < chunks_.size() && kChunkSize - used_ < size) {
+    chunk_++;
+    used_ = 0;
+  }
+  if (chunk_ == chunks_.size()) {
+    chunks_.push_back(static_cast<char*>(::operator new(kChunkSize)));
+    used_ = 0;
+  }
+  void* p = chunks_[chunk_] + used_;
+  used_ += size;
+  return p;
+}
+
+void TxnArena::Rewind() {
+  chunk_ = 0;
+  used_ = 0;
+  free_frames_.clear();
+}
+
+void* TxnArena::AllocateFrame(size_t size) {
+  if (size > kChunkSize) {
+    return ::operator new(size);
+  }
+  live_frames_++;
+  size = RoundUp(size);
+  for (FreeFrames& list : free_frames_) {
+    if (list.size == size && list.head != nullptr) {
+      void* frame = list.head;
+      list.head = *static_cast<void**>(frame);
+      return frame;
+    }
+  }
+  return Allocate(size);
+}
+
+void TxnArena::FreeFrame(void* frame, size_t size) {
+  if (size > kChunkSize) {
+    ::operator delete(frame);
+    return;
+  }
+  if (--live_frames_ == 0) {
+    Rewind();
+    return;
+  }
+  size = RoundUp(size);
+  for (FreeFrames& list : free_frames_) {
+    if (list.size == size) {
+      *static_cast<void**>(frame) = list.head;
+      list.head = frame;
+      return;
+    }
+  }
+  *static_cast<void**>(frame) = nullptr;
+  free_frames_.push_back({size, frame});
+}
+
+}  // end of namespace TPCC
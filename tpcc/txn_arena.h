@@ -0,0 +1,96 @@
+//
+// txn_arena.h
+//
+// Created by Zacharyliu-CS on 06/29/2024.
+// Copyright (c) 2024 liuzhenm@mail.ustc.edu.cn.
+//
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace TPCC {
+
+// Memory of the transactions one thread runs, so that a steady run stops
+// calling malloc:
+// - Coroutine frames are bumped from chunks that are kept, and go back to a
+//   free list of their size; every transaction type has a frame of fixed
+//   size. The arena rewinds to its first chunk whenever the last
+//   transaction of the thread ends.
+// - Buffers are strings of the record path (kv values, deltas) kept with
+//   their capacity, since the kv interface takes std::string.
+class TxnArena {
+ public:
+  static const size_t kChunkSize = 64 << 10;
+
+  TxnArena() {}
+  TxnArena(const TxnArena&) = delete;
+  TxnArena& operator=(const TxnArena&) = delete;
+  ~TxnArena();
+
+  // Arena of the calling thread
+  static TxnArena& ThreadArena() {
+    static thread_local TxnArena arena;
+    return arena;
+  }
+
+  // Frame of a transaction, the arena rewinds when the last one is freed
+  void* AllocateFrame(size_t size);
+  void FreeFrame(void* frame, size_t size);
+
+  // An empty string, with the capacity of an earlier one when there is
+  std::string TakeBuffer() {
+    if (buffers_.empty()) {
+      return std::string();
+    }
+    std::string buffer = std::move(buffers_.back());
+    buffers_.pop_back();
+    buffer.clear();
+    return buffer;
+  }
+  // Keep buffer for a later TakeBuffer(); moved-from and short ones have no
+  // heap capacity worth keeping.
+  void ReturnBuffer(std::string&& buffer) {
+    if (buffer.capacity() > kShortString && buffers_.size() < kMaxBuffers) {
+      buffers_.push_back(std::move(buffer));
+    }
+  }
+
+ private:
+  static const size_t kShortString = 15;  // libstdc++ keeps these inline
+  static const size_t kMaxBuffers = 256;
+
+  struct FreeFrames {
+    size_t size;
+    void* head;  // next frame in the first word
+  };
+
+  // 16-aligned, valid until the arena rewinds
+  void* Allocate(size_t size);
+  void Rewind();
+
+  std::vector<char*> chunks_;
+  size_t chunk_ = 0;  // chunks_[chunk_] is bumped
+  size_t used_ = 0;   // bytes of it handed out
+  std::vector<FreeFrames> free_frames_;
+  uint64_t live_frames_ = 0;
+  std::vector<std::string> buffers_;
+};
+
+// A buffer of the thread's arena for the scope of a record operation
+class ScopedBuffer {
+ public:
+  ScopedBuffer() : buffer_(TxnArena::ThreadArena().TakeBuffer()) {}
+  ScopedBuffer(const ScopedBuffer&) = delete;
+  ScopedBuffer& operator=(const ScopedBuffer&) = delete;
+  ~ScopedBuffer() { TxnArena::ThreadArena().ReturnBuffer(std::move(buffer_)); }
+
+  std::string& operator*() { return buffer_; }
+  std::string* operator->() { return &buffer_; }
+
+ private:
+  std::string buffer_;
+};
+
+}  // end of namespace TPCC
@@ -7,40 +7,72 @@
 
 #include <iostream>
 #include <memory>
-#include <set>
 #include "schemas.h"
 #include "tpcc_txn.h"
 
 namespace TPCC {
 
-bool TPCCTxn::Delivery(TPCCTable* tpcc_client, FastRandom& random_generator) {
+namespace {
+
+// What a delivery changes in the customer's full or hot record
+template <typename CustomerVal>
+RecordDelta CustomerDeliveryDelta(float sum_ol_amount) {
+  RecordDelta delta;
+  delta.AddFloat(offsetof(CustomerVal, c_balance), sum_ol_amount)
+      .AddInt32(offsetof(CustomerVal, c_delivery_cnt), 1);
+  return delta;
+}
 
-  // Generate parameters
+}  // namespace
 
+void TPCCTxn::GenerateDelivery(TPCCTable* tpcc_client,
+                               FastRandom& random_generator,
+                               DeliveryParams* params, const TxnHome& home) {
   int warehouse_id_start_ = 1;
   int warehouse_id_end_ = tpcc_client->GetNumWarehouse();
-  const uint32_t warehouse_id = tpcc_client->PickWarehouseId(
-      random_generator, warehouse_id_start_, warehouse_id_end_);
-  const int o_carrier_id = tpcc_client->RandomNumber(
+  params->warehouse_id =
+      home.warehouse_id != 0
+          ? home.warehouse_id
+          : tpcc_client->PickWarehouseId(random_generator, warehouse_id_start_,
+                                         warehouse_id_end_);
+  params->o_carrier_id = tpcc_client->RandomNumber(
       random_generator, tpcc_order_val_t::MIN_CARRIER_ID,
       tpcc_order_val_t::MAX_CARRIER_ID);
-  const uint32_t current_ts = tpcc_client->GetCurrentTimeMillis();
+  params->current_ts = tpcc_client->GetCurrentTimeMillis();
+}
+
+bool TPCCTxn::Delivery(TPCCTable* tpcc_client, FastRandom& random_generator) {
+  DeliveryParams params;
+  GenerateDelivery(tpcc_client, random_generator, &params);
+  return Delivery(tpcc_client, params).Run();
+}
+
+TxnTask TPCCTxn::Delivery(TPCCTable* tpcc_client,
+                          const DeliveryParams& params) {
+  const uint32_t warehouse_id = params.warehouse_id;
+  const int o_carrier_id = params.o_carrier_id;
+  const uint32_t current_ts = params.current_ts;
+
+  // order delivered per district, 0 when the district was skipped
+  int32_t delivered[NUM_DISTRICT_PER_WAREHOUSE] = {};
+
+  tpcc_client->BeginTxn();
 
   for (int d_id = 1; d_id <= tpcc_client->GetNumDistrictPerWareHouse();
        d_id++) {
-    // FIXME: select the lowest NO_O_ID with matching NO_W_ID (equals W_ID) and NO_D_ID (equals D_ID) in the NEW-ORDER table
-    int min_o_id =
-        tpcc_client->GetNumCustomerPerDistrict() *
-            tpcc_new_order_val_t::SCALE_CONSTANT_BETWEEN_NEWORDER_ORDER +
-        1;
-    int max_o_id = tpcc_client->GetNumCustomerPerDistrict();
-    int o_id = tpcc_client->RandomNumber(random_generator, min_o_id, max_o_id);
+    // the lowest NO_O_ID with matching NO_W_ID (equals W_ID) and NO_D_ID
+    // (equals D_ID) in the NEW-ORDER table
+    const int o_id = tpcc_client->NextDeliveryOrder(warehouse_id, d_id);
 
     int64_t no_key = tpcc_client->MakeNewOrderKey(warehouse_id, d_id, o_id);
     tpcc_new_order_key_t norder_key;
     tpcc_new_order_val_t norder_val;
     norder_key.no_id = no_key;
-    tpcc_client->GetRecord(norder_key.item_key, &norder_val);
+    if (co_await tpcc_client->ReadRecordForUpdate(norder_key.item_key,
+                                                  &norder_val) != 1) {
+      // no outstanding order in this district, its delivery is skipped
+      continue;
+    }
     // auto norder_obj = std::make_shared<DataItem>((table_id_t)TPCCTableType::kNewOrderTable, norder_key.item_key);
     // dtx->AddToReadOnlySet(norder_obj);
 
@@ -60,7 +92,7 @@ bool TPCCTxn::Delivery(TPCCTable* tpcc_client, FastRandom& random_generator) {
     tpcc_order_key_t order_key;
     tpcc_order_val_t order_val;
     order_key.o_id = o_key;
-    tpcc_client->GetRecord(order_key.item_key, &order_val);
+    co_await tpcc_client->ReadRecordForUpdate(order_key.item_key, &order_val);
     // auto order_obj = std::make_shared<DataItem>((table_id_t)TPCCTableType::kOrderTable, order_key.item_key);
     // dtx->AddToReadWriteSet(order_obj);
 
@@ -73,6 +105,8 @@ bool TPCCTxn::Delivery(TPCCTable* tpcc_client, FastRandom& random_generator) {
     // }
 
     // norder_obj->valid = 0;  // deleteNewOrder
+    tpcc_client->DeleteRecord<tpcc_new_order_val_t>(norder_key.item_key);
+    delivered[d_id - 1] = o_id;
 
     // o_entry_d never be 0
     // tpcc_order_val_t* order_val = (tpcc_order_val_t*)order_obj->value;
@@ -91,14 +125,15 @@ bool TPCCTxn::Delivery(TPCCTable* tpcc_client, FastRandom& random_generator) {
     // All OL_DELIVERY_D, the delivery dates, are updated to the current system time
     // The sum of all OL_AMOUNT is retrieved
     float sum_ol_amount = 0;
-    for (int line_number = 1; line_number <= tpcc_order_line_val_t::MAX_OL_CNT;
+    for (int line_number = 1; line_number <= order_val.o_ol_cnt;
          ++line_number) {
       int64_t ol_key =
           tpcc_client->MakeOrderLineKey(warehouse_id, d_id, o_id, line_number);
       tpcc_order_line_key_t order_line_key;
       tpcc_order_line_val_t order_line_val;
       order_line_key.ol_id = ol_key;
-      tpcc_client->GetRecord(order_line_key.item_key, &order_line_val);
+      co_await tpcc_client->ReadRecordForUpdate(order_line_key.item_key,
+                                                &order_line_val);
       order_line_val.ol_delivery_d = current_ts;
       tpcc_client->PutRecord(order_line_key.item_key, &order_line_val);
       sum_ol_amount += order_line_val.ol_amount;
@@ -106,17 +141,38 @@ bool TPCCTxn::Delivery(TPCCTable* tpcc_client, FastRandom& random_generator) {
 
     // The row in the CUSTOMER table with matching C_W_ID (equals W_ID), C_D_ID (equals D_ID), and C_ID (equals O_C_ID) is selected
     tpcc_customer_key_t cust_key;
-    tpcc_customer_val_t cust_val;
     cust_key.c_id =
         tpcc_client->MakeCustomerKey(warehouse_id, d_id, customer_id);
-    tpcc_client->GetRecord(cust_key.item_key, &cust_val);
-    // C_BALANCE is increased by the sum of all order-line amounts (OL_AMOUNT) previously retrieved
-    cust_val.c_balance += sum_ol_amount;
-    // C_DELIVERY_CNT is incremented by 1
-    cust_val.c_delivery_cnt += 1;
-    tpcc_client->PutRecord(cust_key.item_key, &cust_val);
+    if (tpcc_client->HotColdSplit()) {
+      tpcc_customer_hot_val_t cust_val;
+      co_await tpcc_client->ReadRecordForUpdate(cust_key.item_key, &cust_val);
+      cust_val.c_balance += sum_ol_amount;
+      cust_val.c_delivery_cnt += 1;
+      tpcc_client->UpdateRecord(
+          cust_key.item_key, &cust_val,
+          CustomerDeliveryDelta<tpcc_customer_hot_val_t>(sum_ol_amount));
+    } else {
+      tpcc_customer_val_t cust_val;
+      co_await tpcc_client->ReadRecordForUpdate(cust_key.item_key, &cust_val);
+      // C_BALANCE is increased by the sum of all order-line amounts (OL_AMOUNT) previously retrieved
+      cust_val.c_balance += sum_ol_amount;
+      // C_DELIVERY_CNT is incremented by 1
+      cust_val.c_delivery_cnt += 1;
+      tpcc_client->UpdateRecord(
+          cust_key.item_key, &cust_val,
+          CustomerDeliveryDelta<tpcc_customer_val_t>(sum_ol_amount));
+    }
+  }
+  if (tpcc_client->CommitTxn() != 1) {
+    co_return false;
+  }
+  for (int d_id = 1; d_id <= tpcc_client->GetNumDistrictPerWareHouse();
+       d_id++) {
+    if (delivered[d_id - 1] != 0) {
+      tpcc_client->OrderDelivered(warehouse_id, d_id, delivered[d_id - 1]);
+    }
   }
-  return true;
+  co_return true;
 }
 
 }  // end of namespace TPCC
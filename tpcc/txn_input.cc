@@ -0,0 +1,160 @@
+//
+// txn_input.cc
+//
+// Created by Zacharyliu-CS on 03/16/2024.
+// Copyright (c) 2024 liuzhenm@mail.ustc.edu.cn.
+//
+#include "txn_input.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstdio>
+#include "logging.h"
+
+namespace TPCC {
+
+void TPCCTxn::Generate(TPCCTable* tpcc_client, FastRandom& random_generator,
+                       TPCCTxType type, TxnInput* input,
+                       const TxnHome& home) {
+  input->type = type;
+  switch (type) {
+    case TPCCTxType::kDelivery:
+      GenerateDelivery(tpcc_client, random_generator, &input->delivery, home);
+      break;
+    case TPCCTxType::kNewOrder:
+      GenerateNewOrder(tpcc_client, random_generator, &input->new_order, home);
+      break;
+    case TPCCTxType::kOrderStatus:
+      GenerateOrderStatus(tpcc_client, random_generator, &input->order_status,
+                          home);
+      break;
+    case TPCCTxType::kPayment:
+      GeneratePayment(tpcc_client, random_generator, &input->payment, home);
+      break;
+    case TPCCTxType::kStockLevel:
+      GenerateStockLevel(tpcc_client, random_generator, &input->stock_level,
+                         home);
+      break;
+    default:
+      LOG("unexpected transaction type ", static_cast<int>(type));
+      abort();
+  }
+}
+
+bool TPCCTxn::Execute(TPCCTable* tpcc_client, const TxnInput& input) {
+  return Start(tpcc_client, input).Run();
+}
+
+TxnTask TPCCTxn::Start(TPCCTable* tpcc_client, const TxnInput& input) {
+  switch (input.type) {
+    case TPCCTxType::kDelivery:
+      return Delivery(tpcc_client, input.delivery);
+    case TPCCTxType::kNewOrder:
+      return NewOrder(tpcc_client, input.new_order);
+    case TPCCTxType::kOrderStatus:
+      return OrderStatus(tpcc_client, input.order_status);
+    case TPCCTxType::kPayment:
+      return Payment(tpcc_client, input.payment);
+    case TPCCTxType::kStockLevel:
+      return StockLevel(tpcc_client, input.stock_level);
+    default:
+      LOG("unexpected transaction type ", static_cast<int>(input.type));
+      abort();
+  }
+}
+
+TxnInputQueue::TxnInputQueue(uint32_t capacity) {
+  uint64_t size = 1;
+  while (size < capacity) {
+    size <<= 1;
+  }
+  slots_.reset(new TxnInput[size]);
+  mask_ = size - 1;
+}
+
+uint64_t TxnMixHash(const std::vector<TPCCTxType>& workgen_arr) {
+  uint64_t hash = 0xcbf29ce484222325;  // FNV-1a
+  for (TPCCTxType type : workgen_arr) {
+    hash = (hash ^ static_cast<uint64_t>(type)) * 0x100000001b3;
+  }
+  return hash;
+}
+
+bool WriteTxnInputFile(const std::string& path, TPCCTable* tpcc_client,
+                       const std::vector<TPCCTxType>& workgen_arr,
+                       uint64_t count, uint32_t num_streams, uint64_t seed,
+                       Utils::RandomKind rng) {
+  // write aside and rename, a torn file must never be executed
+  std::string tmp_path = path + ".tmp";
+  FILE* out = fopen(tmp_path.c_str(), "wb");
+  if (out == nullptr) {
+    return false;
+  }
+  TxnInputFileHeader header;
+  header.num_warehouse = tpcc_client->GetNumWarehouse();
+  header.rng = static_cast<uint32_t>(rng);
+  header.seed = seed;
+  header.count = count;
+  header.mix_hash = TxnMixHash(workgen_arr);
+  header.num_streams = num_streams;
+  bool ok = fwrite(&header, sizeof(header), 1, out) == 1;
+
+  TxnInput input;
+  for (uint32_t t = 0; ok && t < num_streams; t++) {
+    TxnInputGenerator generator(tpcc_client, workgen_arr, seed + t, rng);
+    uint64_t stream_count = StreamInputCount(count, num_streams, t);
+    for (uint64_t i = 0; ok && i < stream_count; i++) {
+      generator.Next(&input);
+      ok = fwrite(&input, sizeof(input), 1, out) == 1;
+    }
+  }
+  ok = (fclose(out) == 0) && ok;
+  return ok && rename(tmp_path.c_str(), path.c_str()) == 0;
+}
+
+TxnInputFile::~TxnInputFile() { Close(); }
+
+void TxnInputFile::Close() {
+  if (map_ != nullptr) {
+    munmap(map_, map_size_);
+  }
+  map_ = nullptr;
+  map_size_ = 0;
+  header_ = nullptr;
+  records_ = nullptr;
+}
+
+bool TxnInputFile::Open(const std::string& path) {
+  Close();
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(TxnInputFileHeader)) {
+    close(fd);
+    return false;
+  }
+  map_size_ = st.st_size;
+  map_ = mmap(nullptr, map_size_, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+  close(fd);
+  if (map_ == MAP_FAILED) {
+    map_ = nullptr;
+    return false;
+  }
+  header_ = static_cast<const TxnInputFileHeader*>(map_);
+  if (header_->magic != TxnInputFileHeader::kMagic ||
+      header_->format_version != TxnInputFileHeader::kFormatVersion ||
+      header_->record_size != sizeof(TxnInput) ||
+      map_size_ != sizeof(TxnInputFileHeader) +
+                       header_->count * sizeof(TxnInput)) {
+    Close();
+    return false;
+  }
+  records_ = reinterpret_cast<const TxnInput*>(
+      static_cast<const char*>(map_) + sizeof(TxnInputFileHeader));
+  return true;
+}
+
+}  // end of namespace TPCC
@@ -0,0 +1,166 @@
+//
+// txn_input.h
+//
+// Created by Zacharyliu-CS on 03/16/2024.
+// Copyright (c) 2024 liuzhenm@mail.ustc.edu.cn.
+//
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "tpcc_txn.h"
+#include "utils.h"
+
+namespace TPCC {
+
+// Draws the transaction mix and the inputs of one stream, the same sequence
+// for the same seed.
+class TxnInputGenerator {
+ public:
+  TxnInputGenerator(TPCCTable* tpcc_client,
+                    const std::vector<TPCCTxType>& workgen_arr, uint64_t seed,
+                    Utils::RandomKind rng)
+      : tpcc_client_(tpcc_client),
+        workgen_arr_(workgen_arr),
+        seed_(seed),
+        random_generator_(seed, rng) {}
+
+  void Next(TxnInput* input, const TxnHome& home = TxnHome()) {
+    TPCCTxType type = workgen_arr_[Utils::FastRand(&seed_) % 100];
+    if (home.warehouse_id == 0 && !warehouses_.empty()) {
+      TxnHome local = home;
+      local.warehouse_id = warehouses_[tpcc_client_->RandomNumber(
+          random_generator_, 0, int(warehouses_.size()) - 1)];
+      TPCCTxn::Generate(tpcc_client_, random_generator_, type, input, local);
+      return;
+    }
+    TPCCTxn::Generate(tpcc_client_, random_generator_, type, input, home);
+  }
+
+  // Draw the home warehouses uniformly from warehouses only (warehouse
+  // affinity); remote stocks and customers still come from all of them.
+  void RestrictWarehouses(std::vector<uint32_t> warehouses) {
+    warehouses_ = std::move(warehouses);
+  }
+
+ private:
+  TPCCTable* tpcc_client_;
+  const std::vector<TPCCTxType>& workgen_arr_;
+  uint64_t seed_;
+  FastRandom random_generator_;
+  std::vector<uint32_t> warehouses_;
+};
+
+// Single producer, single consumer ring of inputs. The producer fills slots
+// in place and the consumer runs them from the slot, nothing is copied.
+class TxnInputQueue {
+ public:
+  // capacity is rounded up to a power of two
+  explicit TxnInputQueue(uint32_t capacity);
+
+  // Slot to fill, nullptr when the ring is full; Push() publishes it.
+  TxnInput* Back() {
+    uint64_t tail = tail_.value.load(std::memory_order_relaxed);
+    if (tail - cached_head_ > mask_) {
+      cached_head_ = head_.value.load(std::memory_order_acquire);
+      if (tail - cached_head_ > mask_) {
+        return nullptr;
+      }
+    }
+    return &slots_[tail & mask_];
+  }
+  void Push() {
+    tail_.value.store(tail_.value.load(std::memory_order_relaxed) + 1,
+                      std::memory_order_release);
+  }
+
+  // Oldest published input, nullptr when the ring is empty; Pop() frees it.
+  const TxnInput* Front() {
+    uint64_t head = head_.value.load(std::memory_order_relaxed);
+    if (head == cached_tail_) {
+      cached_tail_ = tail_.value.load(std::memory_order_acquire);
+      if (head == cached_tail_) {
+        return nullptr;
+      }
+    }
+    return &slots_[head & mask_];
+  }
+  void Pop() {
+    head_.value.store(head_.value.load(std::memory_order_relaxed) + 1,
+                      std::memory_order_release);
+  }
+
+ private:
+  struct alignas(64) Index {
+    std::atomic<uint64_t> value{0};
+  };
+
+  std::unique_ptr<TxnInput[]> slots_;
+  uint64_t mask_;
+  Index head_;  // written by the consumer
+  Index tail_;  // written by the producer
+  alignas(64) uint64_t cached_head_ = 0;  // producer side
+  alignas(64) uint64_t cached_tail_ = 0;  // consumer side
+};
+
+// Inputs of stream t when count of them are spread over num_streams, the
+// remainder over the first streams.
+inline uint64_t StreamInputCount(uint64_t count, uint32_t num_streams,
+                                 uint32_t t) {
+  return count / num_streams + (t < count % num_streams ? 1 : 0);
+}
+
+// Fingerprint of a transaction mix, the array CreateWorkgenArray() made.
+uint64_t TxnMixHash(const std::vector<TPCCTxType>& workgen_arr);
+
+// A file of pre-generated inputs: the header, then count TxnInput records.
+// The records are mapped read only and executed in place.
+struct TxnInputFileHeader {
+  static const uint64_t kMagic = 0x545043434e505554;  // "TPCCNPUT"
+  static const uint32_t kFormatVersion = 3;
+
+  uint64_t magic = kMagic;
+  uint32_t format_version = kFormatVersion;
+  uint32_t record_size = sizeof(TxnInput);
+  uint32_t num_warehouse = 0;
+  uint32_t rng = 0;  // Utils::RandomKind
+  uint64_t seed = 0;
+  uint64_t count = 0;
+  uint64_t mix_hash = 0;     // TxnMixHash()
+  uint32_t num_streams = 0;  // contiguous slices, one per worker
+  uint32_t reserved = 0;
+};
+
+// Write count inputs to path as num_streams slices of StreamInputCount()
+// inputs, slice t drawn by a TxnInputGenerator seeded with seed + t: the
+// inputs the workers of INPUT_MODE=inline would draw.
+bool WriteTxnInputFile(const std::string& path, TPCCTable* tpcc_client,
+                       const std::vector<TPCCTxType>& workgen_arr,
+                       uint64_t count, uint32_t num_streams, uint64_t seed,
+                       Utils::RandomKind rng);
+
+class TxnInputFile {
+ public:
+  TxnInputFile() = default;
+  TxnInputFile(const TxnInputFile&) = delete;
+  TxnInputFile& operator=(const TxnInputFile&) = delete;
+  ~TxnInputFile();
+
+  // false when the file is missing, malformed or of another format; a file
+  // opened before is closed first
+  bool Open(const std::string& path);
+  const TxnInputFileHeader& header() const { return *header_; }
+  const TxnInput* records() const { return records_; }
+
+ private:
+  void Close();
+
+  void* map_ = nullptr;
+  size_t map_size_ = 0;
+  const TxnInputFileHeader* header_ = nullptr;
+  const TxnInput* records_ = nullptr;
+};
+
+}  // end of namespace TPCC
@@ -7,107 +7,166 @@
 
 #include <iostream>
 #include <memory>
-#include <set>
 #include "schemas.h"
 #include "tpcc_txn.h"
 
 namespace TPCC {
 
-bool TPCCTxn::NewOrder(TPCCTable* tpcc_client, FastRandom& random_generator) {
+namespace {
+
+// The counters of an ordered stock row, which the full row and its
+// HOT_COLD_SPLIT hot record both carry. Returns the change as a delta.
+template <typename StockVal>
+RecordDelta UpdateStock(StockVal* stock_val, uint32_t ol_quantity,
+                        bool remote) {
+  if (stock_val->s_quantity - ol_quantity >= 10) {
+    stock_val->s_quantity -= ol_quantity;
+  } else {
+    stock_val->s_quantity += (-int32_t(ol_quantity) + 91);
+  }
+  stock_val->s_ytd += ol_quantity;
+  stock_val->s_order_cnt += 1;
+  stock_val->s_remote_cnt += remote ? 1 : 0;
+
+  RecordDelta delta;
+  delta.Set(offsetof(StockVal, s_quantity), &stock_val->s_quantity,
+            sizeof(stock_val->s_quantity))
+      .AddInt32(offsetof(StockVal, s_ytd), int32_t(ol_quantity))
+      .AddInt32(offsetof(StockVal, s_order_cnt), 1);
+  if (remote) {
+    delta.AddInt32(offsetof(StockVal, s_remote_cnt), 1);
+  }
+  return delta;
+}
 
-  // Generate parameters
+}  // namespace
 
+void TPCCTxn::GenerateNewOrder(TPCCTable* tpcc_client,
+                               FastRandom& random_generator,
+                               NewOrderParams* params, const TxnHome& home) {
   int warehouse_id_start_ = 1;
   int warehouse_id_end_ = tpcc_client->GetNumWarehouse();
 
   int district_id_start = 1;
   int district_id_end_ = tpcc_client->GetNumDistrictPerWareHouse();
 
-  const uint32_t warehouse_id = tpcc_client->PickWarehouseId(
-      random_generator, warehouse_id_start_, warehouse_id_end_);
-  const uint32_t district_id = tpcc_client->RandomNumber(
+  const uint32_t warehouse_id =
+      home.warehouse_id != 0
+          ? home.warehouse_id
+          : tpcc_client->PickWarehouseId(random_generator, warehouse_id_start_,
+                                         warehouse_id_end_);
+  params->warehouse_id = warehouse_id;
+  params->district_id = tpcc_client->RandomNumber(
       random_generator, district_id_start, district_id_end_);
-  const uint32_t customer_id = tpcc_client->GetCustomerId(random_generator);
-  int64_t c_key =
-      tpcc_client->MakeCustomerKey(warehouse_id, district_id, customer_id);
-
-  int32_t all_local = 1;
-  std::set<uint64_t> stock_set;  // remove identity stock ids;
-
-  // local buffer used store stocks
-  int64_t remote_stocks[tpcc_order_line_val_t::MAX_OL_CNT],
-      local_stocks[tpcc_order_line_val_t::MAX_OL_CNT];
-  int64_t remote_item_ids[tpcc_order_line_val_t::MAX_OL_CNT],
-      local_item_ids[tpcc_order_line_val_t::MAX_OL_CNT];
-  uint32_t local_supplies[tpcc_order_line_val_t::MAX_OL_CNT],
-      remote_supplies[tpcc_order_line_val_t::MAX_OL_CNT];
+  params->customer_id = tpcc_client->GetCustomerId(random_generator);
+  params->all_local = 1;
 
+  // local buffer used store remote stocks, they go after the local ones
+  NewOrderParams::Line remote_lines[tpcc_order_line_val_t::MAX_OL_CNT];
   int num_remote_stocks(0), num_local_stocks(0);
 
+  // remove identity stock ids, at most MAX_OL_CNT of them
+  auto seen = [&](uint32_t supply_warehouse_id, int64_t item_id) {
+    for (int i = 0; i < num_local_stocks; i++) {
+      if (params->lines[i].supply_warehouse_id == supply_warehouse_id &&
+          params->lines[i].item_id == item_id) {
+        return true;
+      }
+    }
+    for (int i = 0; i < num_remote_stocks; i++) {
+      if (remote_lines[i].supply_warehouse_id == supply_warehouse_id &&
+          remote_lines[i].item_id == item_id) {
+        return true;
+      }
+    }
+    return false;
+  };
+
   const int num_items = tpcc_client->RandomNumber(
       random_generator, tpcc_order_line_val_t::MIN_OL_CNT,
       tpcc_order_line_val_t::MAX_OL_CNT);
 
   for (int i = 0; i < num_items; i++) {
     int64_t item_id = tpcc_client->GetItemId(random_generator);
+    uint32_t supplier_warehouse_id = warehouse_id;
     if (tpcc_client->GetNumWarehouse() == 1 ||
         tpcc_client->RandomNumber(random_generator, 1, 100) >
             g_new_order_remote_item_pct) {
       // local stock case
-      uint32_t supplier_warehouse_id = warehouse_id;
-      int64_t s_key = tpcc_client->MakeStockKey(supplier_warehouse_id, item_id);
-      if (stock_set.find(s_key) != stock_set.end()) {
+      if (seen(supplier_warehouse_id, item_id)) {
         i--;
         continue;
-      } else {
-        stock_set.insert(s_key);
       }
-      local_supplies[num_local_stocks] = supplier_warehouse_id;
-      local_item_ids[num_local_stocks] = item_id;
-      local_stocks[num_local_stocks++] = s_key;
+      params->lines[num_local_stocks++] = {
+          int32_t(item_id), supplier_warehouse_id,
+          uint32_t(tpcc_client->RandomNumber(random_generator, 1, 10))};
     } else {
       // remote stock case
-      int64_t s_key;
-      uint32_t supplier_warehouse_id;
       do {
         supplier_warehouse_id = tpcc_client->RandomNumber(
             random_generator, 1, tpcc_client->GetNumWarehouse());
       } while (supplier_warehouse_id == warehouse_id);
 
-      all_local = 0;
+      params->all_local = 0;
 
-      s_key = tpcc_client->MakeStockKey(supplier_warehouse_id, item_id);
-      if (stock_set.find(s_key) != stock_set.end()) {
+      if (seen(supplier_warehouse_id, item_id)) {
         i--;
         continue;
-      } else {
-        stock_set.insert(s_key);
       }
-      remote_stocks[num_remote_stocks] = s_key;
-      remote_supplies[num_remote_stocks] = supplier_warehouse_id;
-      remote_item_ids[num_remote_stocks++] = item_id;
+      remote_lines[num_remote_stocks++] = {
+          int32_t(item_id), supplier_warehouse_id,
+          uint32_t(tpcc_client->RandomNumber(random_generator, 1, 10))};
     }
   }
+  memcpy(params->lines + num_local_stocks, remote_lines,
+         num_remote_stocks * sizeof(NewOrderParams::Line));
+  params->num_items = num_items;
+  params->num_local_items = num_local_stocks;
+}
+
+bool TPCCTxn::NewOrder(TPCCTable* tpcc_client, FastRandom& random_generator) {
+  NewOrderParams params;
+  GenerateNewOrder(tpcc_client, random_generator, &params);
+  return NewOrder(tpcc_client, params).Run();
+}
+
+TxnTask TPCCTxn::NewOrder(TPCCTable* tpcc_client,
+                          const NewOrderParams& params) {
+  const uint32_t warehouse_id = params.warehouse_id;
+  const uint32_t district_id = params.district_id;
+  const uint32_t customer_id = params.customer_id;
+  const int num_items = params.num_items;
+  const int32_t all_local = params.all_local;
+  int64_t c_key =
+      tpcc_client->MakeCustomerKey(warehouse_id, district_id, customer_id);
 
   // Run
 
+  tpcc_client->BeginTxn();
+
   tpcc_warehouse_key_t ware_key;
   tpcc_warehouse_val_t ware_val;
   ware_key.w_id = warehouse_id;
-  tpcc_client->GetRecord(ware_key.item_key, &ware_val);
+  co_await tpcc_client->ReadRecord(ware_key.item_key, &ware_val);
   ;
 
   tpcc_customer_key_t cust_key;
-  tpcc_customer_val_t cust_val;
   cust_key.c_id = c_key;
-  tpcc_client->GetRecord(cust_key.item_key, &cust_val);
+  if (tpcc_client->HotColdSplit()) {
+    // C_DISCOUNT and C_CREDIT
+    tpcc_customer_hot_val_t cust_val;
+    co_await tpcc_client->ReadRecord(cust_key.item_key, &cust_val);
+  } else {
+    tpcc_customer_val_t cust_val;
+    co_await tpcc_client->ReadRecord(cust_key.item_key, &cust_val);
+  }
 
   // read and update district value
   uint64_t d_key = tpcc_client->MakeDistrictKey(warehouse_id, district_id);
   tpcc_district_key_t dist_key;
   tpcc_district_val_t dist_val;
   dist_key.d_id = d_key;
-  tpcc_client->GetRecord(dist_key.item_key, &dist_val);
+  co_await tpcc_client->ReadRecordForUpdate(dist_key.item_key, &dist_val);
 
   std::string check(ware_val.w_zip);
 
@@ -150,34 +209,47 @@ bool TPCCTxn::NewOrder(TPCCTable* tpcc_client, FastRandom& random_generator) {
   oidx_val.debug_magic = tpcc_add_magic;
   tpcc_client->PutRecord(oidx_key.item_key, &oidx_val);
 
+  // STOCK_QUANTITY_COLUMN gets what every line changed S_QUANTITY by once
+  // the transaction committed
+  StockQuantityColumn* quantity_column = tpcc_client->GetStockQuantityColumn();
+  int32_t quantity_deltas[tpcc_order_line_val_t::MAX_OL_CNT];
+
   // -----------------------------------------------------------------------------
-  for (int ol_number = 1; ol_number <= num_local_stocks; ol_number++) {
-    const int64_t ol_i_id = local_item_ids[ol_number - 1];
-    const uint32_t ol_quantity =
-        tpcc_client->RandomNumber(random_generator, 1, 10);
+  for (int ol_number = 1; ol_number <= params.num_local_items; ol_number++) {
+    const NewOrderParams::Line& line = params.lines[ol_number - 1];
+    const int64_t ol_i_id = line.item_id;
+    const uint32_t ol_quantity = line.quantity;
     // read item info
     tpcc_item_key_t tpcc_item_key;
     tpcc_item_val_t tpcc_item_val;
     tpcc_item_key.i_id = ol_i_id;
-    tpcc_client->GetRecord(tpcc_item_key.item_key, &tpcc_item_val);
+    co_await tpcc_client->ReadRecord(tpcc_item_key.item_key, &tpcc_item_val);
 
-    int64_t s_key = local_stocks[ol_number - 1];
+    int64_t s_key =
+        tpcc_client->MakeStockKey(line.supply_warehouse_id, ol_i_id);
     // read and update stock info
     tpcc_stock_key_t stock_key;
-    tpcc_stock_val_t stock_val;
     stock_key.s_id = s_key;
-    tpcc_client->GetRecord(stock_key.item_key, &stock_val);
-
-    if (stock_val.s_quantity - ol_quantity >= 10) {
-      stock_val.s_quantity -= ol_quantity;
+    const bool remote = line.supply_warehouse_id != warehouse_id;
+    int32_t s_quantity_delta;
+    if (tpcc_client->HotColdSplit()) {
+      tpcc_stock_hot_val_t stock_val;
+      co_await tpcc_client->ReadRecordForUpdate(stock_key.item_key,
+                                                &stock_val);
+      const int32_t s_quantity = stock_val.s_quantity;
+      tpcc_client->UpdateRecord(stock_key.item_key, &stock_val,
+                                UpdateStock(&stock_val, ol_quantity, remote));
+      s_quantity_delta = stock_val.s_quantity - s_quantity;
     } else {
-      stock_val.s_quantity += (-int32_t(ol_quantity) + 91);
+      tpcc_stock_val_t stock_val;
+      co_await tpcc_client->ReadRecordForUpdate(stock_key.item_key,
+                                                &stock_val);
+      const int32_t s_quantity = stock_val.s_quantity;
+      tpcc_client->UpdateRecord(stock_key.item_key, &stock_val,
+                                UpdateStock(&stock_val, ol_quantity, remote));
+      s_quantity_delta = stock_val.s_quantity - s_quantity;
     }
-
-    stock_val.s_ytd += ol_quantity;
-    stock_val.s_remote_cnt +=
-        (local_supplies[ol_number - 1] == warehouse_id) ? 0 : 1;
-    tpcc_client->PutRecord(stock_key.item_key, &stock_val);
+    quantity_deltas[ol_number - 1] = s_quantity_delta;
 
     // insert order line record
     int64_t ol_key = tpcc_client->MakeOrderLineKey(warehouse_id, district_id,
@@ -188,38 +260,49 @@ bool TPCCTxn::NewOrder(TPCCTable* tpcc_client, FastRandom& random_generator) {
     order_line_val.ol_i_id = int32_t(ol_i_id);
     order_line_val.ol_delivery_d = 0;  // not delivered yet
     order_line_val.ol_amount = float(ol_quantity) * tpcc_item_val.i_price;
-    order_line_val.ol_supply_w_id = int32_t(local_supplies[ol_number - 1]);
+    order_line_val.ol_supply_w_id = int32_t(line.supply_warehouse_id);
     order_line_val.ol_quantity = int8_t(ol_quantity);
     order_line_val.debug_magic = tpcc_add_magic;
-    tpcc_client->PutRecord(order_key.item_key, &order_line_val);
+    tpcc_client->PutRecord(order_line_key.item_key, &order_line_val);
   }
 
+  const int num_local_stocks = params.num_local_items;
+  const int num_remote_stocks = num_items - num_local_stocks;
   for (int ol_number = 1; ol_number <= num_remote_stocks; ol_number++) {
-    const int64_t ol_i_id = remote_item_ids[ol_number - 1];
-    const uint32_t ol_quantity =
-        tpcc_client->RandomNumber(random_generator, 1, 10);
+    const NewOrderParams::Line& line =
+        params.lines[num_local_stocks + ol_number - 1];
+    const int64_t ol_i_id = line.item_id;
+    const uint32_t ol_quantity = line.quantity;
     // read item info
     tpcc_item_key_t tpcc_item_key;
     tpcc_item_val_t tpcc_item_val;
     tpcc_item_key.i_id = ol_i_id;
-    tpcc_client->GetRecord(tpcc_item_key.item_key, &tpcc_item_val);
-    int64_t s_key = remote_stocks[ol_number - 1];
+    co_await tpcc_client->ReadRecord(tpcc_item_key.item_key, &tpcc_item_val);
+    int64_t s_key =
+        tpcc_client->MakeStockKey(line.supply_warehouse_id, ol_i_id);
     // read and update stock info
     tpcc_stock_key_t stock_key;
-    tpcc_stock_val_t stock_val;
     stock_key.s_id = s_key;
-    tpcc_client->GetRecord(stock_key.item_key, &stock_val);
-
-    if (stock_val.s_quantity - ol_quantity >= 10) {
-      stock_val.s_quantity -= ol_quantity;
+    const bool remote = line.supply_warehouse_id != warehouse_id;
+    int32_t s_quantity_delta;
+    if (tpcc_client->HotColdSplit()) {
+      tpcc_stock_hot_val_t stock_val;
+      co_await tpcc_client->ReadRecordForUpdate(stock_key.item_key,
+                                                &stock_val);
+      const int32_t s_quantity = stock_val.s_quantity;
+      tpcc_client->UpdateRecord(stock_key.item_key, &stock_val,
+                                UpdateStock(&stock_val, ol_quantity, remote));
+      s_quantity_delta = stock_val.s_quantity - s_quantity;
     } else {
-      stock_val.s_quantity += (-int32_t(ol_quantity) + 91);
+      tpcc_stock_val_t stock_val;
+      co_await tpcc_client->ReadRecordForUpdate(stock_key.item_key,
+                                                &stock_val);
+      const int32_t s_quantity = stock_val.s_quantity;
+      tpcc_client->UpdateRecord(stock_key.item_key, &stock_val,
+                                UpdateStock(&stock_val, ol_quantity, remote));
+      s_quantity_delta = stock_val.s_quantity - s_quantity;
     }
-
-    stock_val.s_ytd += ol_quantity;
-    stock_val.s_remote_cnt +=
-        (remote_supplies[ol_number - 1] == warehouse_id) ? 0 : 1;
-    tpcc_client->PutRecord(stock_key.item_key, &stock_val);
+    quantity_deltas[num_local_stocks + ol_number - 1] = s_quantity_delta;
 
     // insert order line record
     int64_t ol_key = tpcc_client->MakeOrderLineKey(
@@ -231,13 +314,24 @@ bool TPCCTxn::NewOrder(TPCCTable* tpcc_client, FastRandom& random_generator) {
     order_line_val.ol_i_id = int32_t(ol_i_id);
     order_line_val.ol_delivery_d = 0;  // not delivered yet
     order_line_val.ol_amount = float(ol_quantity) * tpcc_item_val.i_price;
-    order_line_val.ol_supply_w_id = int32_t(remote_supplies[ol_number - 1]);
+    order_line_val.ol_supply_w_id = int32_t(line.supply_warehouse_id);
     order_line_val.ol_quantity = int8_t(ol_quantity);
     order_line_val.debug_magic = tpcc_add_magic;
     tpcc_client->PutRecord(order_line_key.item_key, &order_line_val);
   }
 
-  return true;
+  if (tpcc_client->CommitTxn() != 1) {
+    co_return false;
+  }
+  // Deltas, not the values: they commute, so the column ends up with the
+  // committed quantity whatever order the committers get here in.
+  if (quantity_column != nullptr) {
+    for (int i = 0; i < num_items; i++) {
+      quantity_column->Add(params.lines[i].supply_warehouse_id,
+                           params.lines[i].item_id, quantity_deltas[i]);
+    }
+  }
+  co_return true;
 }
 
 }  // end of namespace TPCC
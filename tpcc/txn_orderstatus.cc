@@ -7,13 +7,14 @@
 
 #include <iostream>
 #include <memory>
-#include <set>
 #include "tpcc_txn.h"
 
 namespace TPCC {
 
-bool TPCCTxn::OrderStatus(TPCCTable* tpcc_client,
-                          FastRandom& random_generator) {
+void TPCCTxn::GenerateOrderStatus(TPCCTable* tpcc_client,
+                                  FastRandom& random_generator,
+                                  OrderStatusParams* params,
+                                  const TxnHome& home) {
 
   int y = tpcc_client->RandomNumber(random_generator, 1, 100);
 
@@ -23,37 +24,66 @@ bool TPCCTxn::OrderStatus(TPCCTable* tpcc_client,
   int district_id_start = 1;
   int district_id_end_ = tpcc_client->GetNumDistrictPerWareHouse();
 
-  const uint32_t warehouse_id = tpcc_client->PickWarehouseId(
-      random_generator, warehouse_id_start_, warehouse_id_end_);
-  const uint32_t district_id = tpcc_client->RandomNumber(
+  params->warehouse_id =
+      home.warehouse_id != 0
+          ? home.warehouse_id
+          : tpcc_client->PickWarehouseId(random_generator, warehouse_id_start_,
+                                         warehouse_id_end_);
+  params->district_id = tpcc_client->RandomNumber(
       random_generator, district_id_start, district_id_end_);
-  uint32_t customer_id = 0;
+  params->by_last_name = y <= 60;
 
-  if (y <= 60) {
+  if (params->by_last_name) {
     // FIXME:: Find customer by the last name
-    customer_id = tpcc_client->GetCustomerId(random_generator);
+    params->customer_id = tpcc_client->GetCustomerId(random_generator);
   } else {
-    customer_id = tpcc_client->GetCustomerId(random_generator);
+    params->customer_id = tpcc_client->GetCustomerId(random_generator);
   }
 
+  // FIXME: Currently, we use a random order_id to maintain the distributed transaction payload,
+  // but need to search the largest o_id by o_w_id, o_d_id and o_c_id from the order table
+  params->order_id = tpcc_client->RandomNumber(
+      random_generator, 1, tpcc_client->GetNumCustomerPerDistrict());
+}
+
+bool TPCCTxn::OrderStatus(TPCCTable* tpcc_client,
+                          FastRandom& random_generator) {
+  OrderStatusParams params;
+  GenerateOrderStatus(tpcc_client, random_generator, &params);
+  return OrderStatus(tpcc_client, params).Run();
+}
+
+TxnTask TPCCTxn::OrderStatus(TPCCTable* tpcc_client,
+                             const OrderStatusParams& params) {
+  const uint32_t warehouse_id = params.warehouse_id;
+  const uint32_t district_id = params.district_id;
+  const uint32_t customer_id = params.customer_id;
+
+  tpcc_client->BeginTxn();
+
   tpcc_customer_key_t cust_key;
-  tpcc_customer_val_t cust_val;
   cust_key.c_id =
       tpcc_client->MakeCustomerKey(warehouse_id, district_id, customer_id);
-  tpcc_client->GetRecord(cust_key.item_key, &cust_val);
+  if (tpcc_client->HotColdSplit()) {
+    // C_BALANCE, and the name from the cold record
+    tpcc_customer_hot_val_t cust_val;
+    tpcc_customer_cold_val_t cust_cold_val;
+    co_await tpcc_client->ReadRecord(cust_key.item_key, &cust_val);
+    co_await tpcc_client->ReadRecord(cust_key.item_key, &cust_cold_val);
+  } else {
+    tpcc_customer_val_t cust_val;
+    co_await tpcc_client->ReadRecord(cust_key.item_key, &cust_val);
+  }
   //   auto cust_obj = std::make_shared<DataItem>((table_id_t)TPCCTableType::kCustomerTable, cust_key.item_key);
   //   dtx->AddToReadOnlySet(cust_obj);
 
-  // FIXME: Currently, we use a random order_id to maintain the distributed transaction payload,
-  // but need to search the largest o_id by o_w_id, o_d_id and o_c_id from the order table
-  int32_t order_id = tpcc_client->RandomNumber(
-      random_generator, 1, tpcc_client->GetNumCustomerPerDistrict());
+  const int32_t order_id = params.order_id;
   uint64_t o_key =
       tpcc_client->MakeOrderKey(warehouse_id, district_id, order_id);
   tpcc_order_key_t order_key;
   tpcc_order_val_t order_val;
   order_key.o_id = o_key;
-  tpcc_client->GetRecord(order_key.item_key, &order_val);
+  co_await tpcc_client->ReadRecord(order_key.item_key, &order_val);
 
   // o_entry_d never be 0
 
@@ -63,10 +93,10 @@ bool TPCCTxn::OrderStatus(TPCCTable* tpcc_client,
     tpcc_order_line_key_t order_line_key;
     tpcc_order_line_val_t order_line_val;
     order_line_key.ol_id = ol_key;
-    tpcc_client->GetRecord(order_line_key.item_key, &order_line_val);
+    co_await tpcc_client->ReadRecord(order_line_key.item_key, &order_line_val);
   }
 
-  return true;
+  co_return tpcc_client->CommitTxn() == 1;
 }
 
 }  // end of namespace TPCC
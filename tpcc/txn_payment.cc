@@ -15,11 +15,45 @@
 
 namespace TPCC {
 
-bool TPCCTxn::Payment(TPCCTable *tpcc_client, FastRandom &random_generator) {
+namespace {
+
+// Bad credit: insert the payment in front of C_DATA
+void PrependPaymentHistory(char* c_data, uint32_t customer_id, int32_t c_d_id,
+                           int32_t c_w_id, uint32_t district_id,
+                           uint32_t warehouse_id, float h_amount) {
+  static const int HISTORY_SIZE = tpcc_customer_val_t::MAX_DATA + 1;
+  char history[HISTORY_SIZE];
+  int characters = snprintf(history, HISTORY_SIZE, "(%d, %d, %d, %d, %d, %.2f)\n",
+                            customer_id, c_d_id, c_w_id, district_id, warehouse_id, h_amount);
+  assert(characters < HISTORY_SIZE);
+
+  // Perform the insert with a move and copy
+  int current_keep = static_cast<int>(strlen(c_data));
+  if (current_keep + characters > tpcc_customer_val_t::MAX_DATA) {
+    current_keep = tpcc_customer_val_t::MAX_DATA - characters;
+  }
+  assert(current_keep + characters <= tpcc_customer_val_t::MAX_DATA);
+  memmove(c_data + characters, c_data, current_keep);
+  memcpy(c_data, history, characters);
+  c_data[characters + current_keep] = '\0';
+  assert(strlen(c_data) == characters + current_keep);
+}
 
+// What a payment changes in the customer's full or hot record
+template <typename CustomerVal>
+RecordDelta CustomerPaymentDelta(float h_amount) {
+  RecordDelta delta;
+  delta.AddFloat(offsetof(CustomerVal, c_balance), -h_amount)
+      .AddFloat(offsetof(CustomerVal, c_ytd_payment), h_amount)
+      .AddInt32(offsetof(CustomerVal, c_payment_cnt), 1);
+  return delta;
+}
 
-  // Generate parameters
+}  // namespace
 
+void TPCCTxn::GeneratePayment(TPCCTable *tpcc_client,
+                              FastRandom &random_generator,
+                              PaymentParams *params, const TxnHome &home) {
   int x = tpcc_client->RandomNumber(random_generator, 1, 100);
   int y = tpcc_client->RandomNumber(random_generator, 1, 100);
 
@@ -29,8 +63,10 @@ bool TPCCTxn::Payment(TPCCTable *tpcc_client, FastRandom &random_generator) {
   int district_id_start = 1;
   int district_id_end_ = tpcc_client->GetNumDistrictPerWareHouse();
 
-  const uint32_t warehouse_id = tpcc_client->PickWarehouseId(random_generator, warehouse_id_start_, warehouse_id_end_);
+  const uint32_t warehouse_id = home.warehouse_id != 0 ? home.warehouse_id : tpcc_client->PickWarehouseId(random_generator, warehouse_id_start_, warehouse_id_end_);
   const uint32_t district_id = tpcc_client->RandomNumber(random_generator, district_id_start, district_id_end_);
+  params->warehouse_id = warehouse_id;
+  params->district_id = district_id;
 
   int32_t c_w_id;
   int32_t c_d_id;
@@ -46,36 +82,58 @@ bool TPCCTxn::Payment(TPCCTable *tpcc_client, FastRandom &random_generator) {
     } while (c_w_id == warehouse_id);
     c_d_id = tpcc_client->RandomNumber(random_generator, district_id_start, district_id_end_);
   }
-  uint32_t customer_id = 0;
+  params->customer_warehouse_id = c_w_id;
+  params->customer_district_id = c_d_id;
   // The payment amount (H_AMOUNT) is randomly selected within [1.00 .. 5,000.00].
-  float h_amount = (float)tpcc_client->RandomNumber(random_generator, 100, 500000) / 100.0;
-  if (y <= 60) {
+  params->h_amount = (float)tpcc_client->RandomNumber(random_generator, 100, 500000) / 100.0;
+  params->by_last_name = y <= 60;
+  params->c_last[0] = '\0';
+  if (params->by_last_name) {
     // 60%: payment by last name
-    char last_name[tpcc_customer_val_t::MAX_LAST + 1];
-    size_t size = (tpcc_client->GetNonUniformCustomerLastNameLoad(random_generator)).size();
-    assert(tpcc_customer_val_t::MAX_LAST - size >= 0);
-    strcpy(last_name, tpcc_client->GetNonUniformCustomerLastNameLoad(random_generator).c_str());
+    size_t size = tpcc_client->GetNonUniformCustomerLastNameRun(
+        params->c_last, random_generator);
+    assert(size <= tpcc_customer_val_t::MAX_LAST);
+    params->c_last[size] = '\0';
     // FIXME:: Find customer by the last name
     // All rows in the CUSTOMER table with matching C_W_ID, C_D_ID and C_LAST are selected sorted by C_FIRST in ascending order.
     // Let n be the number of rows selected.
     // C_ID, C_FIRST, C_MIDDLE, C_STREET_1, C_STREET_2, C_CITY, C_STATE, C_ZIP, C_PHONE, C_SINCE, C_CREDIT, C_CREDIT_LIM, C_DISCOUNT,
     // and C_BALANCE are retrieved from the row at position (n/ 2 rounded up to the next integer) in the sorted set of selected rows from the CUSTOMER table.
-    customer_id = tpcc_client->GetCustomerId(random_generator);
+    params->customer_id = tpcc_client->GetCustomerId(random_generator);
   } else {
     // 40%: payment by id
     assert(y > 60);
-    customer_id = tpcc_client->GetCustomerId(random_generator);
+    params->customer_id = tpcc_client->GetCustomerId(random_generator);
   }
+}
+
+bool TPCCTxn::Payment(TPCCTable *tpcc_client, FastRandom &random_generator) {
+  PaymentParams params;
+  GeneratePayment(tpcc_client, random_generator, &params);
+  return Payment(tpcc_client, params).Run();
+}
+
+TxnTask TPCCTxn::Payment(TPCCTable *tpcc_client, const PaymentParams &params) {
+  const uint32_t warehouse_id = params.warehouse_id;
+  const uint32_t district_id = params.district_id;
+  const int32_t c_w_id = params.customer_warehouse_id;
+  const int32_t c_d_id = params.customer_district_id;
+  const uint32_t customer_id = params.customer_id;
+  const float h_amount = params.h_amount;
 
   // Run
 
+  tpcc_client->BeginTxn();
+
   tpcc_warehouse_key_t ware_key;
   tpcc_warehouse_val_t ware_val;
   ware_key.w_id = warehouse_id;
-  tpcc_client->GetRecord(ware_key.item_key, &ware_val);
+  co_await tpcc_client->ReadRecordForUpdate(ware_key.item_key, &ware_val);
 
   ware_val.w_ytd += h_amount;
-  tpcc_client->PutRecord(ware_key.item_key, &ware_val);
+  tpcc_client->UpdateRecord(
+      ware_key.item_key, &ware_val,
+      RecordDelta().AddFloat(offsetof(tpcc_warehouse_val_t, w_ytd), h_amount));
 
 //   auto ware_obj = std::make_shared<DataItem>((table_id_t)TPCCTableType::kWarehouseTable, ware_key.item_key);
 //   dtx->AddToReadWriteSet(ware_obj);
@@ -84,42 +142,55 @@ bool TPCCTxn::Payment(TPCCTable *tpcc_client, FastRandom &random_generator) {
   tpcc_district_key_t dist_key;
   tpcc_district_val_t dist_val;
   dist_key.d_id = d_key;
-  tpcc_client->GetRecord(dist_key.item_key, &dist_val);
+  co_await tpcc_client->ReadRecordForUpdate(dist_key.item_key, &dist_val);
 
   dist_val.d_ytd += h_amount;
-  tpcc_client->PutRecord(dist_key.item_key, &dist_val);
+  tpcc_client->UpdateRecord(
+      dist_key.item_key, &dist_val,
+      RecordDelta().AddFloat(offsetof(tpcc_district_val_t, d_ytd), h_amount));
 //   auto dist_obj = std::make_shared<DataItem>((table_id_t)TPCCTableType::kDistrictTable, dist_key.item_key);
 //   dtx->AddToReadWriteSet(dist_obj);
 
   tpcc_customer_key_t cust_key;
-  tpcc_customer_val_t cust_val;
   cust_key.c_id = tpcc_client->MakeCustomerKey(c_w_id, c_d_id, customer_id);
-  tpcc_client->GetRecord(cust_key.item_key, &cust_val);
-
 // update customer data
-  cust_val.c_balance -= h_amount;
-  cust_val.c_ytd_payment += h_amount;
-  cust_val.c_payment_cnt += 1;
-  if (strcmp(cust_val.c_credit, BAD_CREDIT) == 0) {
-    // Bad credit: insert history into c_data
-    static const int HISTORY_SIZE = tpcc_customer_val_t::MAX_DATA + 1;
-    char history[HISTORY_SIZE];
-    int characters = snprintf(history, HISTORY_SIZE, "(%d, %d, %d, %d, %d, %.2f)\n",
-                              customer_id, c_d_id, c_w_id, district_id, warehouse_id, h_amount);
-    assert(characters < HISTORY_SIZE);
-
-    // Perform the insert with a move and copy
-    int current_keep = static_cast<int>(strlen(cust_val.c_data));
-    if (current_keep + characters > tpcc_customer_val_t::MAX_DATA) {
-      current_keep = tpcc_customer_val_t::MAX_DATA - characters;
+  if (tpcc_client->HotColdSplit()) {
+    tpcc_customer_hot_val_t cust_val;
+    co_await tpcc_client->ReadRecordForUpdate(cust_key.item_key, &cust_val);
+    cust_val.c_balance -= h_amount;
+    cust_val.c_ytd_payment += h_amount;
+    cust_val.c_payment_cnt += 1;
+    if (strcmp(cust_val.c_credit, BAD_CREDIT) == 0) {
+      // the only write of the cold record
+      tpcc_customer_cold_val_t cust_cold_val;
+      co_await tpcc_client->ReadRecordForUpdate(cust_key.item_key,
+                                                &cust_cold_val);
+      PrependPaymentHistory(cust_cold_val.c_data, customer_id, c_d_id, c_w_id,
+                            district_id, warehouse_id, h_amount);
+      tpcc_client->UpdateRecord(
+          cust_key.item_key, &cust_cold_val,
+          RecordDelta().Set(offsetof(tpcc_customer_cold_val_t, c_data),
+                            cust_cold_val.c_data,
+                            strlen(cust_cold_val.c_data) + 1));
+    }
+    tpcc_client->UpdateRecord(
+        cust_key.item_key, &cust_val,
+        CustomerPaymentDelta<tpcc_customer_hot_val_t>(h_amount));
+  } else {
+    tpcc_customer_val_t cust_val;
+    co_await tpcc_client->ReadRecordForUpdate(cust_key.item_key, &cust_val);
+    cust_val.c_balance -= h_amount;
+    cust_val.c_ytd_payment += h_amount;
+    cust_val.c_payment_cnt += 1;
+    RecordDelta delta = CustomerPaymentDelta<tpcc_customer_val_t>(h_amount);
+    if (strcmp(cust_val.c_credit, BAD_CREDIT) == 0) {
+      PrependPaymentHistory(cust_val.c_data, customer_id, c_d_id, c_w_id,
+                            district_id, warehouse_id, h_amount);
+      delta.Set(offsetof(tpcc_customer_val_t, c_data), cust_val.c_data,
+                strlen(cust_val.c_data) + 1);
     }
-    assert(current_keep + characters <= tpcc_customer_val_t::MAX_DATA);
-    memmove(cust_val.c_data + characters, cust_val.c_data, current_keep);
-    memcpy(cust_val.c_data, history, characters);
-    cust_val.c_data[characters + current_keep] = '\0';
-    assert(strlen(cust_val.c_data) == characters + current_keep);
+    tpcc_client->UpdateRecord(cust_key.item_key, &cust_val, delta);
   }
-  tpcc_client->PutRecord(cust_key.item_key, &cust_val);
 
 // insert history data
   tpcc_history_key_t hist_key;
@@ -128,11 +199,10 @@ bool TPCCTxn::Payment(TPCCTable *tpcc_client, FastRandom &random_generator) {
 
   hist_val.h_date = tpcc_client->GetCurrentTimeMillis();  // different time at server and client cause errors?
   hist_val.h_amount = h_amount;
-  strcpy(hist_val.h_data, ware_val.w_name);
-  strcat(hist_val.h_data, "  ");
-  strcat(hist_val.h_data, dist_val.d_name);
+  snprintf(hist_val.h_data, sizeof(hist_val.h_data), "%s  %s",
+           ware_val.w_name, dist_val.d_name);
   tpcc_client->PutRecord(hist_key.item_key, &hist_val);
-  return true;
+  co_return tpcc_client->CommitTxn() == 1;
 }
 } // end of namespace TPCC
 
@@ -8,16 +8,17 @@
 #include <cassert>
 #include <iostream>
 #include <memory>
-#include <set>
-#include <algorithm>
 #include "schemas.h"
 #include "tpcc_txn.h"
 
 namespace TPCC {
 
-bool TPCCTxn::StockLevel(TPCCTable* tpcc_client, FastRandom& random_generator) {
+void TPCCTxn::GenerateStockLevel(TPCCTable* tpcc_client,
+                                 FastRandom& random_generator,
+                                 StockLevelParams* params,
+                                 const TxnHome& home) {
 
-  int32_t threshold = tpcc_client->RandomNumber(
+  params->threshold = tpcc_client->RandomNumber(
       random_generator, tpcc_stock_val_t::MIN_STOCK_LEVEL_THRESHOLD,
       tpcc_stock_val_t::MAX_STOCK_LEVEL_THRESHOLD);
 
@@ -27,23 +28,51 @@ bool TPCCTxn::StockLevel(TPCCTable* tpcc_client, FastRandom& random_generator) {
   int district_id_start = 1;
   int district_id_end_ = tpcc_client->GetNumDistrictPerWareHouse();
 
-  const uint32_t warehouse_id = tpcc_client->PickWarehouseId(
-      random_generator, warehouse_id_start_, warehouse_id_end_);
-  const uint32_t district_id = tpcc_client->RandomNumber(
-      random_generator, district_id_start, district_id_end_);
+  params->warehouse_id =
+      home.warehouse_id != 0
+          ? home.warehouse_id
+          : tpcc_client->PickWarehouseId(random_generator, warehouse_id_start_,
+                                         warehouse_id_end_);
+  // a terminal always reports on its own district
+  params->district_id =
+      home.district_id != 0
+          ? home.district_id
+          : tpcc_client->RandomNumber(random_generator, district_id_start,
+                                      district_id_end_);
+}
+
+bool TPCCTxn::StockLevel(TPCCTable* tpcc_client, FastRandom& random_generator) {
+  StockLevelParams params;
+  GenerateStockLevel(tpcc_client, random_generator, &params);
+  return StockLevel(tpcc_client, params).Run();
+}
+
+TxnTask TPCCTxn::StockLevel(TPCCTable* tpcc_client,
+                            const StockLevelParams& params) {
+  const int32_t threshold = params.threshold;
+  const uint32_t warehouse_id = params.warehouse_id;
+  const uint32_t district_id = params.district_id;
+
+  tpcc_client->BeginTxn();
 
   uint64_t d_key = tpcc_client->MakeDistrictKey(warehouse_id, district_id);
   tpcc_district_key_t dist_key;
   tpcc_district_val_t dist_val;
   dist_key.d_id = d_key;
-  tpcc_client->GetRecord(dist_key.item_key, &dist_val);
+  co_await tpcc_client->ReadRecord(dist_key.item_key, &dist_val);
 
 
 
   int32_t o_id = dist_val.d_next_o_id;
 
-  std::vector<int32_t> s_i_ids;
-  s_i_ids.reserve(300);
+  // STOCK_QUANTITY_COLUMN: collect the items of the order lines and count
+  // the ones low on stock in the column instead of reading the stock rows
+  StockQuantityColumn* quantity_column = tpcc_client->GetStockQuantityColumn();
+
+  // at most 15 lines per order, kept in the coroutine frame
+  int32_t s_i_ids[tpcc_stock_val_t::STOCK_LEVEL_ORDERS *
+                  tpcc_order_line_val_t::MAX_OL_CNT];
+  size_t num_s_i_ids = 0;
 
   // Iterate over [o_id-20, o_id)
   for (int order_id = o_id - tpcc_stock_val_t::STOCK_LEVEL_ORDERS;
@@ -57,7 +86,8 @@ bool TPCCTxn::StockLevel(TPCCTable* tpcc_client, FastRandom& random_generator) {
       tpcc_order_line_val_t order_line_val;
       order_line_key.ol_id = ol_key;
       auto status =
-          tpcc_client->GetRecord(order_line_key.item_key, &order_line_val);
+          co_await tpcc_client->ReadRecord(order_line_key.item_key,
+                                           &order_line_val);
       //   auto ol_obj = std::make_shared<DataItem>(
       //       (table_id_t)TPCCTableType::kOrderLineTable, order_line_key.item_key);
       //   dtx->AddToReadOnlySet(ol_obj);
@@ -65,6 +95,10 @@ bool TPCCTxn::StockLevel(TPCCTable* tpcc_client, FastRandom& random_generator) {
       if (status == -1) {
         break;
       }
+      if (quantity_column != nullptr) {
+        s_i_ids[num_s_i_ids++] = order_line_val.ol_i_id;
+        continue;
+      }
 
       //   tpcc_order_line_val_t* ol_val = (tpcc_order_line_val_t*)ol_obj->value;
       //   if (ol_val->debug_magic != tpcc_add_magic) {
@@ -74,9 +108,17 @@ bool TPCCTxn::StockLevel(TPCCTable* tpcc_client, FastRandom& random_generator) {
 
       int64_t s_key = tpcc_client->MakeStockKey(warehouse_id, order_line_val.ol_i_id);
       tpcc_stock_key_t stock_key;
-      tpcc_stock_val_t stock_val;
       stock_key.s_id = s_key;
-      tpcc_client->GetRecord(stock_key.item_key, &stock_val);
+      int32_t s_quantity;
+      if (tpcc_client->HotColdSplit()) {
+        tpcc_stock_hot_val_t stock_val;
+        co_await tpcc_client->ReadRecord(stock_key.item_key, &stock_val);
+        s_quantity = stock_val.s_quantity;
+      } else {
+        tpcc_stock_val_t stock_val;
+        co_await tpcc_client->ReadRecord(stock_key.item_key, &stock_val);
+        s_quantity = stock_val.s_quantity;
+      }
       //   auto stock_obj = std::make_shared<DataItem>(
       //   (table_id_t)TPCCTableType::kStockTable, stock_key.item_key);
       //   dtx->AddToReadOnlySet(stock_obj);
@@ -90,24 +132,24 @@ bool TPCCTxn::StockLevel(TPCCTable* tpcc_client, FastRandom& random_generator) {
     //                     << dtx->t_id << "-" << dtx->coro_id << "-" << tx_id;
     //   }
 
-      if (stock_val.s_quantity < threshold) {
-        s_i_ids.push_back(order_line_val.ol_i_id);
+      if (s_quantity < threshold) {
+        s_i_ids[num_s_i_ids++] = order_line_val.ol_i_id;
       }
     }
   }
 
-  // Filter out duplicate s_i_id: multiple order lines can have the same item
-  // In O3, this code may be optimized since num_distinct is not outputed.
-  std::sort(s_i_ids.begin(), s_i_ids.end());
-  int num_distinct = 0;  // The output of this transaction
-  int32_t last = -1;     // -1 is an invalid s_i_id
-  for (size_t i = 0; i < s_i_ids.size(); ++i) {
-    if (s_i_ids[i] != last) {
-      last = s_i_ids[i];
-      num_distinct += 1;
-    }
+  // Filter out duplicate s_i_id: multiple order lines can have the same
+  // item. Counted in a bitmap of all items instead of sorting the ids.
+  DistinctItemSet* seen = tpcc_client->ThreadItemSet();
+  uint32_t num_distinct;  // The output of this transaction
+  if (quantity_column != nullptr) {
+    num_distinct = quantity_column->CountDistinctBelow(
+        warehouse_id, s_i_ids, num_s_i_ids, threshold, seen);
+  } else {
+    num_distinct = seen->CountDistinct(s_i_ids, num_s_i_ids);
   }
+  (void)num_distinct;
 
-  return true;
+  co_return tpcc_client->CommitTxn() == 1;
 }
 }  // end of namespace TPCC
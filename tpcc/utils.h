@@ -7,9 +7,98 @@
 #pragma once
 #include <cstdint>
 #include <cassert>
+#include <atomic>
+#include <ctime>
+#include <mutex>
 #include <string>
+#include <vector>
+#if defined(__x86_64__)
+#include <x86intrin.h>
+#endif
 
 namespace Utils {
+// upper bound of threads that may touch per-thread state (txn slots, stats)
+static const uint32_t kMaxThreads = 256;
+
+// Dense index of the calling thread, assigned on first use and given back
+// when the thread exits, so that the workers of successive phases (warmup,
+// every TPS_SWEEP rate) and the loaders take the same indexes again. Only
+// live threads count against kMaxThreads; the next thread that gets an
+// index finds the per-thread state the last one left there.
+class ThreadIndexes {
+ public:
+  static uint32_t Acquire() {
+    ThreadIndexes& indexes = Instance();
+    std::lock_guard<std::mutex> lock(indexes.mutex_);
+    uint32_t index;
+    if (indexes.free_.empty()) {
+      index = indexes.next_++;
+    } else {
+      index = indexes.free_.back();
+      indexes.free_.pop_back();
+    }
+    assert(index < kMaxThreads);
+    return index;
+  }
+  static void Release(uint32_t index) {
+    ThreadIndexes& indexes = Instance();
+    std::lock_guard<std::mutex> lock(indexes.mutex_);
+    indexes.free_.push_back(index);
+  }
+
+ private:
+  static ThreadIndexes& Instance() {
+    static ThreadIndexes* indexes = new ThreadIndexes();  // outlives threads
+    return *indexes;
+  }
+
+  std::mutex mutex_;
+  uint32_t next_ = 0;
+  std::vector<uint32_t> free_;
+};
+
+inline uint32_t ThreadIndex() {
+  struct Holder {
+    uint32_t index = ThreadIndexes::Acquire();
+    ~Holder() { ThreadIndexes::Release(index); }
+  };
+  thread_local Holder holder;
+  return holder.index;
+}
+
+// Monotonic clock in nanoseconds, for intervals within one process.
+inline uint64_t NowNanos() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return uint64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+// Cheap timestamp for timing short operations: the TSC on x86, the
+// monotonic clock elsewhere. A difference times NanosPerTick() is in ns.
+inline uint64_t ReadTicks() {
+#if defined(__x86_64__)
+  return __rdtsc();
+#else
+  return NowNanos();
+#endif
+}
+
+// Calibrated against NowNanos() on first use, takes ~10ms.
+inline double NanosPerTick() {
+  static const double nanos_per_tick = []() {
+#if defined(__x86_64__)
+    uint64_t start_ns = NowNanos(), start_ticks = ReadTicks();
+    struct timespec pause = {0, 10000000};
+    nanosleep(&pause, nullptr);
+    uint64_t ticks = ReadTicks() - start_ticks;
+    return ticks == 0 ? 1.0 : double(NowNanos() - start_ns) / ticks;
+#else
+    return 1.0;
+#endif
+  }();
+  return nanos_per_tick;
+}
+
 // generate random number int32_t and int64_t
 class Random {};
 class Rand {
@@ -44,30 +133,86 @@ inline static  uint32_t FastRand(uint64_t *seed) {
   return (uint32_t)(*seed >> 32);
 }
 
+// Generators behind FastRandom. kJavaLcg is the historical one and keeps
+// runs reproducible; the others are cheaper per draw.
+enum class RandomKind : uint8_t { kJavaLcg = 0, kXoshiro256, kWyrand };
+
+inline bool ParseRandomKind(const std::string& name, RandomKind* kind) {
+  if (name == "java-lcg") {
+    *kind = RandomKind::kJavaLcg;
+  } else if (name == "xoshiro256") {
+    *kind = RandomKind::kXoshiro256;
+  } else if (name == "wyrand") {
+    *kind = RandomKind::kWyrand;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+inline uint64_t SplitMix64(uint64_t& x) {
+  uint64_t z = (x += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
 // not thread-safe
 //
 // taken from java:
 //   http://developer.classpath.org/doc/java/util/Random-source.html
+// The java generator keeps its exact arithmetic (including the double based
+// range reduction); the other kinds use multiply-shift range reduction.
 class FastRandom {
 public:
-  FastRandom(unsigned long sed) : seed(0) { SetSeed0(sed); }
+  FastRandom(unsigned long sed, RandomKind kind = RandomKind::kJavaLcg)
+      : kind_(kind), seed(0) {
+    SetSeed0(sed);
+  }
 
   FastRandom() : seed(0) { SetSeed0(seed); }
 
+  inline RandomKind Kind() const { return kind_; }
+
   inline unsigned long Next() {
-    return ((unsigned long)Next(32) << 32) + Next(32);
+    if (kind_ == RandomKind::kJavaLcg) {
+      return ((unsigned long)Next(32) << 32) + Next(32);
+    }
+    return Next64();
   }
 
-  inline uint32_t NextU32() { return Next(32); }
+  inline uint32_t NextU32() {
+    return kind_ == RandomKind::kJavaLcg ? Next(32) : Next64() >> 32;
+  }
 
-  inline uint16_t NextU16() { return Next(16); }
+  inline uint16_t NextU16() {
+    return kind_ == RandomKind::kJavaLcg ? Next(16) : Next64() >> 48;
+  }
 
   /** [0.0, 1.0) */
   inline double NextUniform() {
-    return (((unsigned long)Next(26) << 27) + Next(27)) / (double)(1L << 53);
+    if (kind_ == RandomKind::kJavaLcg) {
+      return (((unsigned long)Next(26) << 27) + Next(27)) / (double)(1L << 53);
+    }
+    return (Next64() >> 11) * (1.0 / (double)(1ULL << 53));
   }
 
-  inline char NextChar() { return Next(8) % 256; }
+  inline char NextChar() {
+    return kind_ == RandomKind::kJavaLcg ? Next(8) % 256 : Next64() >> 56;
+  }
+
+  // [min, max]
+  inline int64_t NextInt(int64_t min, int64_t max) {
+    if (kind_ == RandomKind::kJavaLcg) {
+      return (int64_t)(NextUniform() * (max - min + 1) + min);
+    }
+    return min + NextBelow(uint32_t(max - min + 1));
+  }
+
+  // [0, n), no division
+  inline uint32_t NextBelow(uint32_t n) {
+    return uint32_t((uint64_t(NextU32()) * n) >> 32);
+  }
 
   inline std::string NextString(size_t len) {
     std::string s(len, 0);
@@ -82,11 +227,14 @@ public:
 
   inline void SetSeed0(unsigned long sed) {
     this->seed = (sed ^ 0x5DEECE66DL) & ((1L << 48) - 1);
+    uint64_t x = sed;
+    for (auto& word : state_) {
+      word = SplitMix64(x);
+    }
   }
 
   inline uint64_t RandNumber(int min, int max) {
-    return CheckBetweenInclusive(
-        (uint64_t)(NextUniform() * (max - min + 1) + min), min, max);
+    return CheckBetweenInclusive(NextInt(min, max), min, max);
   }
 
   inline uint64_t CheckBetweenInclusive(uint64_t v, uint64_t min,
@@ -102,6 +250,45 @@ private:
     return (unsigned long)(seed >> (48 - bits));
   }
 
+  static inline uint64_t Rotl(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+  }
+
+  inline uint64_t Next64() {
+    if (kind_ == RandomKind::kXoshiro256) {
+      // xoshiro256** 1.0
+      const uint64_t result = Rotl(state_[1] * 5, 7) * 9;
+      const uint64_t t = state_[1] << 17;
+      state_[2] ^= state_[0];
+      state_[3] ^= state_[1];
+      state_[1] ^= state_[2];
+      state_[0] ^= state_[3];
+      state_[2] ^= t;
+      state_[3] = Rotl(state_[3], 45);
+      return result;
+    }
+    // wyrand
+    state_[0] += 0xa0761d6478bd642fULL;
+    __uint128_t m = (__uint128_t)state_[0] * (state_[0] ^ 0xe7037ed1a0b428dbULL);
+    return uint64_t(m >> 64) ^ uint64_t(m);
+  }
+
+  RandomKind kind_ = RandomKind::kJavaLcg;
   unsigned long seed;
+  uint64_t state_[4];
+};
+
+// Divisor known at run start: x % d as two multiplications (Lemire's
+// fastmod), valid for 32-bit x and d.
+struct FastMod {
+  uint32_t d = 1;
+  uint64_t m = 0;
+  FastMod() {}
+  explicit FastMod(uint32_t divisor)
+      : d(divisor), m(UINT64_C(0xFFFFFFFFFFFFFFFF) / divisor + 1) {}
+  inline uint32_t Mod(uint32_t x) const {
+    uint64_t lowbits = m * x;
+    return uint32_t(((__uint128_t)lowbits * d) >> 64);
+  }
 };
 } // namespace Utils 
@@ -0,0 +1,227 @@
+//
+// tpcc_replay.cc
+//
+// Created by Zacharyliu-CS on 03/23/2024.
+// Copyright (c) 2024 liuzhenm@mail.ustc.edu.cn.
+//
+// Drive a kv backend with a trace recorded by tpcc --KV_TRACE_FILE, without
+// any of the TPCC logic.
+//
+
+#include <gflags/gflags.h>
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "tpcc/config.h"
+#include "tpcc/kv_factory.h"
+#include "tpcc/kv_trace.h"
+#include "tpcc/results.h"
+#include "tpcc/utils.h"
+
+namespace TPCC {
+
+DEFINE_string(TRACE_FILE, "", "Trace to replay.");
+DEFINE_string(REPLAY_TIMING, "full",
+              "full: issue every call as soon as the previous one returned; "
+              "recorded: wait until the time it was recorded at.");
+DEFINE_bool(REPLAY_CHECKSUM, false,
+            "Sum the hashes of the values read, to compare backends "
+            "replaying the same single threaded trace.");
+
+}  // namespace TPCC
+
+struct ReplayStats {
+  uint64_t ops = 0;
+  uint64_t size_mismatches = 0;  // reads returning another size than traced
+  uint64_t value_mismatches = 0;  // reads returning other bytes than traced
+  uint64_t checksum = 0;
+};
+
+// Replay the records of one traced thread in order, given by their index in
+// trace. Writes store the traced bytes, reads are checked against the traced
+// hash.
+ReplayStats Replay(KVInterface* kv, const TPCC::Trace& trace,
+                   const std::vector<size_t>& stream, bool recorded_timing,
+                   uint64_t start_ns) {
+  ReplayStats stats;
+  std::string value;
+  for (size_t index : stream) {
+    const TPCC::TraceRecord& record = trace.records[index];
+    if (recorded_timing) {
+      uint64_t due_ns = start_ns + record.time_ns;
+      uint64_t now_ns;
+      while ((now_ns = Utils::NowNanos()) < due_ns) {
+        if (due_ns - now_ns > 100000) {
+          std::this_thread::sleep_for(std::chrono::nanoseconds(due_ns - now_ns - 50000));
+        }
+      }
+    }
+    int ret = 1;
+    if (TPCC::TraceOpWrites(record.op)) {
+      value.assign(trace.values, trace.value_offsets[index],
+                   record.value_size);
+    }
+    switch (record.op) {
+      case TPCC::TraceOp::kPut:
+      case TPCC::TraceOp::kLoad:
+        ret = kv->Put(record.key, value);
+        break;
+      case TPCC::TraceOp::kDelete:
+        ret = kv->Delete(record.key);
+        break;
+      case TPCC::TraceOp::kMerge:
+        ret = kv->Merge(record.key, value);
+        break;
+      case TPCC::TraceOp::kGet:
+      case TPCC::TraceOp::kGetForUpdate: {
+        value.clear();
+        ret = record.op == TPCC::TraceOp::kGet ? kv->Get(record.key, value)
+                                               : kv->GetForUpdate(record.key, value);
+        if ((ret == -1 ? 0 : value.size()) != record.value_size) {
+          stats.size_mismatches++;
+        }
+        uint64_t hash = ret == -1 ? 0 : TPCC::TraceValueHash(value);
+        if (hash != record.value_hash) {
+          stats.value_mismatches++;
+        }
+        if (TPCC::FLAGS_REPLAY_CHECKSUM && ret != -1) {
+          stats.checksum += hash ^ record.key;
+        }
+        break;
+      }
+      case TPCC::TraceOp::kBegin:
+        ret = kv->Begin();
+        break;
+      case TPCC::TraceOp::kCommit:
+        ret = kv->Commit();
+        break;
+      case TPCC::TraceOp::kRollback:
+        ret = kv->Rollback();
+        break;
+      default:
+        printf("unexpected trace op %d\n", static_cast<int>(record.op));
+        abort();
+    }
+    stats.ops++;
+  }
+  return stats;
+}
+
+// Replay every stream on its own thread and wait for all of them.
+ReplayStats ReplayAll(KVInterface* kv, const TPCC::Trace& trace,
+                      const std::map<uint16_t, std::vector<size_t>>& streams,
+                      bool recorded_timing, uint64_t time_offset_ns) {
+  std::vector<ReplayStats> thread_stats(streams.size());
+  std::vector<std::thread> workers;
+  uint64_t start_ns = Utils::NowNanos() - time_offset_ns;
+  size_t i = 0;
+  for (auto& stream : streams) {
+    workers.emplace_back([&, i]() {
+      thread_stats[i] =
+          Replay(kv, trace, stream.second, recorded_timing, start_ns);
+    });
+    i++;
+  }
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  ReplayStats total;
+  for (auto& stats : thread_stats) {
+    total.ops += stats.ops;
+    total.size_mismatches += stats.size_mismatches;
+    total.value_mismatches += stats.value_mismatches;
+    total.checksum += stats.checksum;
+  }
+  return total;
+}
+
+int main(int argc, char** argv) {
+  google::SetUsageMessage("Usage: tpcc_replay --TRACE_FILE=<trace> [--DB_TYPE=...]");
+  google::ParseCommandLineFlags(&argc, &argv, true);
+
+  TPCC::DBType db_type;
+  if (!TPCC::ParseDBType(TPCC::FLAGS_DB_TYPE, &db_type)) {
+    printf("unknown DB_TYPE: %s\n", TPCC::FLAGS_DB_TYPE.c_str());
+    return 1;
+  }
+  if (TPCC::FLAGS_REPLAY_TIMING != "full" &&
+      TPCC::FLAGS_REPLAY_TIMING != "recorded") {
+    printf("unknown REPLAY_TIMING: %s\n", TPCC::FLAGS_REPLAY_TIMING.c_str());
+    return 1;
+  }
+  bool recorded_timing = TPCC::FLAGS_REPLAY_TIMING == "recorded";
+
+  TPCC::Trace trace;
+  if (!TPCC::ReadTrace(TPCC::FLAGS_TRACE_FILE, &trace)) {
+    printf("read trace %s failed\n", TPCC::FLAGS_TRACE_FILE.c_str());
+    return 1;
+  }
+  // The load ran before the first transaction began and is replayed first
+  // and completely; then one thread per traced worker. Chunks of different
+  // threads interleave in the file, a stable sort restores the order of
+  // every thread.
+  const std::vector<TPCC::TraceRecord>& records = trace.records;
+  std::vector<size_t> order(records.size());
+  for (size_t i = 0; i < order.size(); i++) {
+    order[i] = i;
+  }
+  std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return records[a].time_ns < records[b].time_ns;
+  });
+  uint64_t run_start_ns = UINT64_MAX;
+  for (size_t i : order) {
+    if (records[i].op == TPCC::TraceOp::kBegin) {
+      run_start_ns = records[i].time_ns;
+      break;
+    }
+  }
+  std::map<uint16_t, std::vector<size_t>> load_streams, run_streams;
+  for (size_t i : order) {
+    const TPCC::TraceRecord& record = records[i];
+    if (record.op == TPCC::TraceOp::kLoad || record.time_ns < run_start_ns) {
+      load_streams[record.thread].push_back(i);
+    } else {
+      run_streams[record.thread].push_back(i);
+    }
+  }
+  order.clear();
+  order.shrink_to_fit();
+
+  std::unique_ptr<KVInterface> kv(TPCC::NewKV(db_type));
+  ReplayStats load_stats = ReplayAll(kv.get(), trace, load_streams, false, 0);
+
+  uint64_t start_ns = Utils::NowNanos();
+  ReplayStats stats =
+      ReplayAll(kv.get(), trace, run_streams, recorded_timing,
+                run_start_ns == UINT64_MAX ? 0 : run_start_ns);
+  double sec = double(Utils::NowNanos() - start_ns) / 1000000000;
+
+  printf("load ops = %lu, run ops = %lu, threads = %zu, sec = %.2lf, "
+         "ops/sec = %.2lf, size mismatches = %lu, value mismatches = %lu, "
+         "checksum = %016lx\n",
+         load_stats.ops, stats.ops, run_streams.size(), sec, stats.ops / sec,
+         stats.size_mismatches, stats.value_mismatches, stats.checksum);
+
+  TPCC::RunResults results;
+  results.Add("trace_file", TPCC::FLAGS_TRACE_FILE);
+  results.Add("db_type", TPCC::FLAGS_DB_TYPE);
+  results.Add("db_path", TPCC::FLAGS_DB_PATH);
+  results.Add("durability", TPCC::FLAGS_DURABILITY);
+  results.Add("kv_options", kv->DumpOptions());
+  results.Add("replay_timing", TPCC::FLAGS_REPLAY_TIMING);
+  results.Add("num_threads", run_streams.size());
+  results.Add("load_ops", load_stats.ops);
+  results.Add("ops", stats.ops);
+  results.Add("sec", sec);
+  results.Add("ops_per_sec", stats.ops / sec);
+  results.Add("size_mismatches", stats.size_mismatches);
+  results.Add("value_mismatches", stats.value_mismatches);
+  results.Add("kv_stats", kv->DumpStats());
+  if (!TPCC::FLAGS_RESULT_FILE.empty() &&
+      !results.AppendToFile(TPCC::FLAGS_RESULT_FILE)) {
+    printf("write results failed: %s\n", TPCC::FLAGS_RESULT_FILE.c_str());
+  }
+}